@@ -201,22 +201,23 @@ static void detectGTK(FFinstance* instance, const char* version, const char* env
 
 #define FF_CALCULATE_GTK_IMPL(version) \
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER; \
-    static FFGTKResult result; \
-    static bool init = false; \
+    static FFGTKResult* result; \
+    static uint32_t generation; \
     pthread_mutex_lock(&mutex); \
-    if(init){ \
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation)){ \
         pthread_mutex_unlock(&mutex);\
-        return &result; \
+        return result; \
     } \
-    init = true; \
-    ffStrbufInit(&result.theme); \
-    ffStrbufInit(&result.icons); \
-    ffStrbufInit(&result.font); \
-    ffStrbufInit(&result.cursor); \
-    ffStrbufInit(&result.cursorSize); \
-    detectGTK(instance, #version, "GTK"#version"_RC_FILES", &result); \
+    ffStrbufInit(&result->theme); \
+    ffStrbufInit(&result->icons); \
+    ffStrbufInit(&result->font); \
+    ffStrbufInit(&result->cursor); \
+    ffStrbufInit(&result->cursorSize); \
+    FF_TRACE_BEGIN(traceBegin); \
+    detectGTK(instance, #version, "GTK"#version"_RC_FILES", result); \
+    FF_TRACE_END(traceBegin, "detect", "GTK"#version); \
     pthread_mutex_unlock(&mutex); \
-    return &result;
+    return result;
 
 const FFGTKResult* ffDetectGTK2(FFinstance* instance)
 {
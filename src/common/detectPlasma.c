@@ -13,7 +13,7 @@ typedef enum PlasmaCategory
 
 static bool detectFromConfigFile(const FFstrbuf* filename, FFPlasmaResult* result)
 {
-    FILE* kdeglobals = fopen(filename->chars, "r");
+    FILE* kdeglobals = ffSysrootOpenFile(filename->chars);
     if(kdeglobals == NULL)
         return false;
 
@@ -63,26 +63,27 @@ static bool detectFromConfigFile(const FFstrbuf* filename, FFPlasmaResult* resul
 const FFPlasmaResult* ffDetectPlasma(FFinstance* instance)
 {
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    static FFPlasmaResult result;
-    static bool init = false;
+    static FFPlasmaResult* result;
+    static uint32_t generation;
     pthread_mutex_lock(&mutex);
-    if(init)
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
-    init = true;
+    FF_TRACE_BEGIN(traceBegin);
 
-    ffStrbufInit(&result.widgetStyle);
-    ffStrbufInit(&result.colorScheme);
-    ffStrbufInit(&result.icons);
-    ffStrbufInit(&result.font);
+    ffStrbufInit(&result->widgetStyle);
+    ffStrbufInit(&result->colorScheme);
+    ffStrbufInit(&result->icons);
+    ffStrbufInit(&result->font);
 
     const FFWMDEResult* wmde = ffDetectWMDE(instance);
     if(ffStrbufIgnCaseCompS(&wmde->deProcessName, "plasmashell") != 0)
     {
+        FF_TRACE_END(traceBegin, "detect", "Plasma");
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
 
     bool foundAFile = false;
@@ -98,14 +99,14 @@ const FFPlasmaResult* ffDetectPlasma(FFinstance* instance)
         ffStrbufSet(&baseDirCopy, baseDir);
         ffStrbufAppendS(&baseDirCopy, "/kdeglobals");
 
-        if(detectFromConfigFile(&baseDirCopy, &result))
+        if(detectFromConfigFile(&baseDirCopy, result))
             foundAFile = true;
 
         if(
-            result.widgetStyle.length > 0 &&
-            result.colorScheme.length > 0 &&
-            result.icons.length > 0 &&
-            result.font.length > 0
+            result->widgetStyle.length > 0 &&
+            result->colorScheme.length > 0 &&
+            result->icons.length > 0 &&
+            result->font.length > 0
         ) break;
     }
 
@@ -113,24 +114,26 @@ const FFPlasmaResult* ffDetectPlasma(FFinstance* instance)
 
     if(!foundAFile)
     {
+        FF_TRACE_END(traceBegin, "detect", "Plasma");
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
 
     //In Plasma the default value is never set in the config file, but the whole key-value is discarded.
     ///We must set these values by our self if the file exists (it always does here)
-    if(result.widgetStyle.length == 0)
-        ffStrbufAppendS(&result.widgetStyle, "Breeze");
+    if(result->widgetStyle.length == 0)
+        ffStrbufAppendS(&result->widgetStyle, "Breeze");
 
-    if(result.colorScheme.length == 0)
-        ffStrbufAppendS(&result.colorScheme, "BreezeLight");
+    if(result->colorScheme.length == 0)
+        ffStrbufAppendS(&result->colorScheme, "BreezeLight");
 
-    if(result.icons.length == 0)
-        ffStrbufAppendS(&result.icons, "Breeze");
+    if(result->icons.length == 0)
+        ffStrbufAppendS(&result->icons, "Breeze");
 
-    if(result.font.length == 0)
-        ffStrbufAppendS(&result.font, "Noto Sans, 10");
+    if(result->font.length == 0)
+        ffStrbufAppendS(&result->font, "Noto Sans, 10");
 
+    FF_TRACE_END(traceBegin, "detect", "Plasma");
     pthread_mutex_unlock(&mutex);
-    return &result;
+    return result;
 }
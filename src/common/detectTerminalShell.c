@@ -12,15 +12,12 @@ static void setExeName(FFstrbuf* exe, const char** exeName)
         *exeName = exe->chars + lastSlashIndex + 1;
 }
 
-static void getProcessInformation(const char* pid, FFstrbuf* processName, FFstrbuf* exe, const char** exeName)
+static void getProcessInformation(pid_t pid, FFstrbuf* processName, FFstrbuf* exe, const char** exeName)
 {
-    FFstrbuf cmdlineFilePath;
-    ffStrbufInit(&cmdlineFilePath);
-    ffStrbufAppendS(&cmdlineFilePath, "/proc/");
-    ffStrbufAppendS(&cmdlineFilePath, pid);
-    ffStrbufAppendS(&cmdlineFilePath, "/cmdline");
+    char cmdlineFilePath[32];
+    snprintf(cmdlineFilePath, sizeof(cmdlineFilePath), "/proc/%d/cmdline", (int) pid);
 
-    ffGetFileContent(cmdlineFilePath.chars, exe);
+    ffGetFileContent(cmdlineFilePath, exe);
     ffStrbufSubstrBeforeFirstC(exe, '\0'); //Trim the arguments
     ffStrbufTrimLeft(exe, '-'); //Happens in TTY
 
@@ -28,43 +25,19 @@ static void getProcessInformation(const char* pid, FFstrbuf* processName, FFstrb
         ffStrbufSet(exe, processName);
 
     setExeName(exe, exeName);
-
-    ffStrbufDestroy(&cmdlineFilePath);
 }
 
-static void getTerminalShell(FFTerminalShellResult* result, const char* pid)
+static void getTerminalShell(FFinstance* instance, FFTerminalShellResult* result, pid_t pid)
 {
-    FFstrbuf statFilePath;
-    ffStrbufInit(&statFilePath);
-    ffStrbufAppendS(&statFilePath, "/proc/");
-    ffStrbufAppendS(&statFilePath, pid);
-    ffStrbufAppendS(&statFilePath, "/stat");
-
-    FILE* stat = fopen(statFilePath.chars, "r");
-
-    ffStrbufDestroy(&statFilePath);
-
-    if(stat == NULL)
-        return;
-
-    char name[256];
-    name[0] = '\0';
-
-    char ppid[256];
-    ppid[0] = '\0';
-
+    FFprocessentry process;
     if(
-        fscanf(stat, "%*s (%255[^)]) %*c %255s", name, ppid) != 2 || //stat (comm) state ppid
-        *name == '\0' ||
-        *ppid == '\0' ||
-        *ppid == '-' ||
-        strcasecmp(ppid, "0") == 0
-    ) {
-        fclose(stat);
-        return;
-    }
+        !ffProcessTableFind(instance, pid, &process) ||
+        *process.comm == '\0' ||
+        process.ppid <= 0
+    ) return;
 
-    fclose(stat);
+    const char* name = process.comm;
+    pid_t ppid = process.ppid;
 
     //Common programs that are between terminal and own process, but are not the shell
     if(
@@ -74,7 +47,7 @@ static void getTerminalShell(FFTerminalShellResult* result, const char* pid)
         strcasecmp(name, "strace") == 0 ||
         strcasecmp(name, "gdb")    == 0
     ) {
-        getTerminalShell(result, ppid);
+        getTerminalShell(instance, result, ppid);
         return;
     }
 
@@ -91,7 +64,7 @@ static void getTerminalShell(FFTerminalShellResult* result, const char* pid)
         ffStrbufAppendS(&result->shellProcessName, name);
         getProcessInformation(pid, &result->shellProcessName, &result->shellExe, &result->shellExeName);
 
-        getTerminalShell(result, ppid);
+        getTerminalShell(instance, result, ppid);
         return;
     }
 
@@ -138,45 +111,7 @@ static void getUserShellFromEnv(FFTerminalShellResult* result)
     }
 }
 
-static void getShellVersionBash(FFstrbuf* exe, FFstrbuf* version)
-{
-    ffProcessAppendStdOut(version, (char* const[]) {
-        "env",
-        "-i",
-        exe->chars,
-        "--norc",
-        "--noprofile",
-        "-c",
-        "printf \"%s\" \"$BASH_VERSION\"",
-        NULL
-    });
-    ffStrbufSubstrBeforeFirstC(version, '(');
-}
-
-static void getShellVersionZsh(FFstrbuf* exe, FFstrbuf* version)
-{
-    ffProcessAppendStdOut(version, (char* const[]) {
-        exe->chars,
-        "--version",
-        NULL
-    });
-    ffStrbufTrimRight(version, '\n');
-    ffStrbufSubstrBeforeLastC(version, ' ');
-    ffStrbufSubstrAfterFirstC(version, ' ');
-}
-
-static void getShellVersionFish(FFstrbuf* exe, FFstrbuf* version)
-{
-    ffProcessAppendStdOut(version, (char* const[]) {
-        exe->chars,
-        "--version",
-        NULL
-    });
-    ffStrbufTrimRight(version, '\n');
-    ffStrbufSubstrAfterLastC(version, ' ');
-}
-
-static void getShellVersionGeneric(FFstrbuf* exe, const char* exeName, FFstrbuf* version)
+static void spawnShellVersionGeneric(FFprocessgroup* group, const char* exe, const char* exeName, FFstrbuf* version)
 {
     FFstrbuf command;
     ffStrbufInit(&command);
@@ -184,73 +119,127 @@ static void getShellVersionGeneric(FFstrbuf* exe, const char* exeName, FFstrbuf*
     ffStrbufAppendTransformS(&command, exeName, toupper);
     ffStrbufAppendS(&command, "_VERSION\"");
 
-    ffProcessAppendStdOut(version, (char* const[]) {
+    //The arguments are copied once the process is spawned
+    ffProcessGroupSpawn(group, version, (char* const[]) {
         "env",
         "-i",
-        exe->chars,
+        (char*) exe,
         "-c",
         command.chars,
         NULL
-    });
-    ffStrbufSubstrBeforeFirstC(version, '(');
-    ffStrbufRemoveStrings(version, 2, "-release", "release");
+    }, exe, FF_PROCESS_DEFAULT_TIMEOUT_MS);
 
     ffStrbufDestroy(&command);
 }
 
-static void getShellVersion(FFstrbuf* exe, const char* exeName, FFstrbuf* version)
+static void spawnShellVersion(FFprocessgroup* group, FFstrbuf* exe, const char* exeName, FFstrbuf* version)
+{
+    //Login shells and shells started by name have no path. It is resolved here, as env -i would search its default PATH instead of ours,
+    //and the cached version must be checked against the shell that runs, not env
+    FFstrbuf path;
+    ffStrbufInit(&path);
+    ffProcessResolveExecutable(exe->chars, &path);
+    if(path.length == 0)
+        ffStrbufSet(&path, exe);
+
+    if(strcasecmp(exeName, "bash") == 0)
+    {
+        ffProcessGroupSpawn(group, version, (char* const[]) {
+            "env",
+            "-i",
+            path.chars,
+            "--norc",
+            "--noprofile",
+            "-c",
+            "printf \"%s\" \"$BASH_VERSION\"",
+            NULL
+        }, path.chars, FF_PROCESS_DEFAULT_TIMEOUT_MS);
+    }
+    else if(strcasecmp(exeName, "zsh") == 0 || strcasecmp(exeName, "fish") == 0)
+    {
+        ffProcessGroupSpawn(group, version, (char* const[]) {
+            path.chars,
+            "--version",
+            NULL
+        }, NULL, FF_PROCESS_DEFAULT_TIMEOUT_MS);
+    }
+    else
+        spawnShellVersionGeneric(group, path.chars, exeName, version);
+
+    ffStrbufDestroy(&path);
+}
+
+static void parseShellVersion(const char* exeName, FFstrbuf* version)
 {
     if(strcasecmp(exeName, "bash") == 0)
-        getShellVersionBash(exe, version);
+        ffStrbufSubstrBeforeFirstC(version, '(');
     else if(strcasecmp(exeName, "zsh") == 0)
-        getShellVersionZsh(exe, version);
+    {
+        ffStrbufTrimRight(version, '\n');
+        ffStrbufSubstrBeforeLastC(version, ' ');
+        ffStrbufSubstrAfterFirstC(version, ' ');
+    }
     else if(strcasecmp(exeName, "fish") == 0)
-        getShellVersionFish(exe, version);
+    {
+        ffStrbufTrimRight(version, '\n');
+        ffStrbufSubstrAfterLastC(version, ' ');
+    }
     else
-        getShellVersionGeneric(exe, exeName, version);
+    {
+        ffStrbufSubstrBeforeFirstC(version, '(');
+        ffStrbufRemoveStrings(version, 2, "-release", "release");
+    }
 }
 
 const FFTerminalShellResult* ffDetectTerminalShell(FFinstance* instance)
 {
-    UNUSED(instance);
-
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    static FFTerminalShellResult result;
-    static bool init = false;
+    static FFTerminalShellResult* result;
+    static uint32_t generation;
     pthread_mutex_lock(&mutex);
-    if(init)
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
-    init = true;
+    FF_TRACE_BEGIN(traceBegin);
+
+    ffStrbufInit(&result->shellProcessName);
+    ffStrbufInit(&result->shellExe);
+    result->shellExeName = result->shellExe.chars;
+    ffStrbufInit(&result->shellVersion);
+
+    ffStrbufInit(&result->terminalProcessName);
+    ffStrbufInit(&result->terminalExe);
+    result->terminalExeName = result->terminalExe.chars;
+
+    ffStrbufInit(&result->userShellExe);
+    result->userShellExeName = result->userShellExe.chars;
+    ffStrbufInit(&result->userShellVersion);
 
-    ffStrbufInit(&result.shellProcessName);
-    ffStrbufInit(&result.shellExe);
-    result.shellExeName = result.shellExe.chars;
-    ffStrbufInit(&result.shellVersion);
+    getTerminalShell(instance, result, instance->state.ppid);
 
-    ffStrbufInit(&result.terminalProcessName);
-    ffStrbufInit(&result.terminalExe);
-    result.terminalExeName = result.terminalExe.chars;
+    getTerminalFromEnv(result);
+    getUserShellFromEnv(result);
 
-    ffStrbufInit(&result.userShellExe);
-    result.userShellExeName = result.userShellExe.chars;
-    ffStrbufInit(&result.userShellVersion);
+    //Both shells are asked for their version at the same time
+    bool sameShell = strcasecmp(result->shellExeName, result->userShellExeName) == 0;
+    FFprocessgroup versions;
+    ffProcessGroupInit(&versions, instance);
 
-    char ppid[256];
-    snprintf(ppid, 255, "%i", getppid());
-    getTerminalShell(&result, ppid);
+    spawnShellVersion(&versions, &result->shellExe, result->shellExeName, &result->shellVersion);
+    if(!sameShell)
+        spawnShellVersion(&versions, &result->userShellExe, result->userShellExeName, &result->userShellVersion);
 
-    getTerminalFromEnv(&result);
-    getUserShellFromEnv(&result);
-    getShellVersion(&result.shellExe, result.shellExeName, &result.shellVersion);
+    ffProcessGroupWait(&versions);
 
-    if(strcasecmp(result.shellExeName, result.userShellExeName) != 0)
-        getShellVersion(&result.userShellExe, result.userShellExeName, &result.userShellVersion);
+    parseShellVersion(result->shellExeName, &result->shellVersion);
+    if(!sameShell)
+        parseShellVersion(result->userShellExeName, &result->userShellVersion);
     else
-        ffStrbufSet(&result.userShellVersion, &result.shellVersion);
+        ffStrbufSet(&result->userShellVersion, &result->shellVersion);
 
+    FF_TRACE_END(traceBegin, "detect", "TerminalShell");
     pthread_mutex_unlock(&mutex);
-    return &result;
+    return result;
 }
@@ -2,7 +2,6 @@
 
 #include <string.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <pthread.h>
 
 typedef enum ProtocolHint
@@ -169,9 +168,9 @@ static void getMate(FFinstance* instance, FFWMDEResult* result)
     ffStrbufDestroy(&minor);
     ffStrbufDestroy(&micro);
 
-    if(result->deVersion.length == 0 && instance->config.allowSlowOperations)
+    if(result->deVersion.length == 0)
     {
-        ffProcessAppendStdOut(&result->deVersion, (char* const[]){
+        ffProcessAppendStdOutCached(instance, &result->deVersion, (char* const[]){
             "mate-session",
             "--version",
             NULL
@@ -188,10 +187,10 @@ static void getXFCE4(FFinstance* instance, FFWMDEResult* result)
     ffStrbufSetS(&result->dePrettyName, "Xfce4");
     ffParsePropFile("/usr/share/gtk-doc/html/libxfce4ui/index.html", "<div><p class=\"releaseinfo\">Version", &result->deVersion);
 
-    if(result->deVersion.length == 0 && instance->config.allowSlowOperations)
+    if(result->deVersion.length == 0)
     {
-        //This is somewhat slow
-        ffProcessAppendStdOut(&result->deVersion, (char* const[]){
+        //This is somewhat slow, but only runs again when xfce4-session changes
+        ffProcessAppendStdOutCached(instance, &result->deVersion, (char* const[]){
             "xfce4-session",
             "--version",
             NULL
@@ -214,10 +213,10 @@ static void getLXQt(FFinstance* instance, FFWMDEResult* result, ProtocolHint* pr
     if(result->deVersion.length == 0)
         ffParsePropFile("/usr/share/cmake/lxqt/lxqt-config-version.cmake", "set ( PACKAGE_VERSION", &result->deVersion);
 
-    if(result->deVersion.length == 0 && instance->config.allowSlowOperations)
+    if(result->deVersion.length == 0)
     {
-        //This is really, really, really slow. Thank you, LXQt developers
-        ffProcessAppendStdOut(&result->deVersion, (char* const[]){
+        //This is really, really, really slow. Thank you, LXQt developers. Cached, so only paid once per lxqt-session binary
+        ffProcessAppendStdOutCached(instance, &result->deVersion, (char* const[]){
             "lxqt-session",
             "-v",
             NULL
@@ -307,31 +306,19 @@ static void getSessionTypeFromEnv(FFWMDEResult* result)
 
 static void getFromProcDir(FFinstance* instance, FFWMDEResult* result, ProtocolHint* protocolHint)
 {
-    DIR* proc = opendir("/proc");
-    if(proc == NULL)
-        return;
-
-    FFstrbuf procPath;
-    ffStrbufInitA(&procPath, 64);
-    ffStrbufAppendS(&procPath, "/proc/");
-
-    uint32_t procPathLength = procPath.length;
+    const FFlist* processes = ffProcessTableGet(instance);
 
     FFstrbuf processName;
-    ffStrbufInitA(&processName, 256); //Some processes have large command lines (looking at you chrome)
+    ffStrbufInitA(&processName, 64);
 
-    struct dirent* dirent;
-    while((dirent = readdir(proc)) != NULL)
+    for(uint32_t i = 0; i < processes->length; i++)
     {
-        if(dirent->d_type != DT_DIR || dirent->d_name[0] == '.')
-            continue;
+        const FFprocessentry* process = ffListGet(processes, i);
 
-        ffStrbufAppendS(&procPath, dirent->d_name);
-        ffStrbufAppendS(&procPath, "/cmdline");
-        ffGetFileContent(procPath.chars, &processName);
-        ffStrbufSubstrBeforeFirstC(&processName, '\0'); //Trim the arguments
-        ffStrbufSubstrAfterLastC(&processName, '/');
-        ffStrbufSubstrBefore(&procPath, procPathLength);
+        //Names like gnome-session-binary don't fit into comm
+        ffStrbufSetS(&processName, process->comm);
+        if(processName.length == FF_PROCESS_COMM_LENGTH - 1)
+            ffProcessGetCmdlineName(process->pid, &processName);
 
         if(result->dePrettyName.length == 0)
             applyPrettyNameIfDE(instance, result, processName.chars, protocolHint);
@@ -343,10 +330,7 @@ static void getFromProcDir(FFinstance* instance, FFWMDEResult* result, ProtocolH
             break;
     }
 
-    closedir(proc);
-
     ffStrbufDestroy(&processName);
-    ffStrbufDestroy(&procPath);
 }
 
 void getWMDE(FFinstance* instance, FFWMDEResult* result)
@@ -380,30 +364,31 @@ void getWMDE(FFinstance* instance, FFWMDEResult* result)
 const FFWMDEResult* ffDetectWMDE(FFinstance* instance)
 {
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    static FFWMDEResult result;
-    static bool init = false;
+    static FFWMDEResult* result;
+    static uint32_t generation;
     pthread_mutex_lock(&mutex);
-    if(init)
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
-    init = true;
+    FF_TRACE_BEGIN(traceBegin);
 
-    ffStrbufInit(&result.wmProcessName);
-    ffStrbufInit(&result.wmPrettyName);
-    ffStrbufInit(&result.wmProtocolName);
-    ffStrbufInit(&result.deProcessName);
-    ffStrbufInit(&result.dePrettyName);
-    ffStrbufInit(&result.deVersion);
+    ffStrbufInit(&result->wmProcessName);
+    ffStrbufInit(&result->wmPrettyName);
+    ffStrbufInit(&result->wmProtocolName);
+    ffStrbufInit(&result->deProcessName);
+    ffStrbufInit(&result->dePrettyName);
+    ffStrbufInit(&result->deVersion);
 
-    getSessionDesktop(&result);
-    getSessionTypeFromEnv(&result);
+    getSessionDesktop(result);
+    getSessionTypeFromEnv(result);
 
-    //Don't run anyting when on TTY. This prevents us to catch process from other users in at least that case.
-    if(ffStrbufIgnCaseCompS(&result.wmProtocolName, "TTY") != 0)
-        getWMDE(instance, &result);
+    //Don't run anyting when on TTY. There is no WM or DE to find there.
+    if(ffStrbufIgnCaseCompS(&result->wmProtocolName, "TTY") != 0)
+        getWMDE(instance, result);
 
+    FF_TRACE_END(traceBegin, "detect", "WMDE");
     pthread_mutex_unlock(&mutex);
-    return &result;
+    return result;
 }
@@ -1,19 +1,21 @@
 #include "fastfetch.h"
 
+#include <string.h>
+
 void ffFormatAppendFormatArg(FFstrbuf* buffer, const FFformatarg* formatarg)
 {
     if(formatarg->type == FF_FORMAT_ARG_TYPE_INT)
-        ffStrbufAppendF(buffer, "%i", *(int*)formatarg->value);
+        ffStrbufAppendInt(buffer, *(int*)formatarg->value);
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_UINT)
-        ffStrbufAppendF(buffer, "%u", *(uint32_t*)formatarg->value);
+        ffStrbufAppendUInt(buffer, *(uint32_t*)formatarg->value);
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_UINT8)
-        ffStrbufAppendF(buffer, "%hhu", *(uint8_t*)formatarg->value);
+        ffStrbufAppendUInt(buffer, *(uint8_t*)formatarg->value);
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_STRING)
         ffStrbufAppendS(buffer, (const char*)formatarg->value);
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_STRBUF)
         ffStrbufAppend(buffer, (FFstrbuf*)formatarg->value);
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_DOUBLE)
-        ffStrbufAppendF(buffer, "%g", *(double*)formatarg->value);
+        ffStrbufAppendDouble(buffer, *(double*)formatarg->value, 6); //Like %g
     else if(formatarg->type == FF_FORMAT_ARG_TYPE_LIST)
     {
         const FFlist* list = formatarg->value;
@@ -30,6 +32,32 @@ void ffFormatAppendFormatArg(FFstrbuf* buffer, const FFformatarg* formatarg)
     }
 }
 
+typedef enum FFformatoptype
+{
+    FF_FORMAT_OP_LITERAL, // text
+    FF_FORMAT_OP_NEXT_ARG, // {}, the literal if there are no more arguments
+    FF_FORMAT_OP_ARG, // {1}, the literal if the index is invalid
+    FF_FORMAT_OP_ERROR, // {e}
+    FF_FORMAT_OP_IF, // {?1}, jumps if the argument is not set
+    FF_FORMAT_OP_IF_NOT, // {/1}, jumps if the argument is set
+    FF_FORMAT_OP_END_IF, // {?}, the literal if there is no open if
+    FF_FORMAT_OP_END_IF_NOT, // {/}
+    FF_FORMAT_OP_COLOR, // {#1}, the literal is the escape code
+    FF_FORMAT_OP_END_COLOR, // {#}
+    FF_FORMAT_OP_END // {-} or the end of the format string
+} FFformatoptype;
+
+typedef struct FFformatop
+{
+    FFformatoptype type;
+    bool testsError; // for if and if not
+    uint32_t index; // of the argument, starting at 1. 0 if invalid
+    uint32_t literalStart; // into literals
+    uint32_t literalLength;
+    uint32_t jump; // source index while compiling, op index afterwards
+    uint32_t sourceStart; // where the placeholder starts in the format string
+} FFformatop;
+
 static inline bool placeholderValueIsForError(const FFstrbuf* placeholderValue)
 {
     return
@@ -46,24 +74,8 @@ static inline uint32_t getArgumentIndex(const FFstrbuf* placeholderValue)
     if(placeholderValue->chars[0] != '-')
         sscanf(placeholderValue->chars, "%u", &result);
 
-    return result;
-}
-
-static inline void appendInvalidPlaceholder(FFstrbuf* buffer, const char* start, const FFstrbuf* placeholderValue, uint32_t index, uint32_t formatStringLength)
-{
-    ffStrbufAppendS(buffer, start);
-    ffStrbufAppend(buffer, placeholderValue);
-
-    if(index < formatStringLength)
-        ffStrbufAppendC(buffer, '}');
-}
-
-static inline void appendEmptyPlaceholder(FFstrbuf* buffer, const char* placeholder, uint32_t* argCounter, uint32_t numArgs, const FFformatarg* arguments)
-{
-    if(*argCounter > numArgs)
-        ffStrbufAppendS(buffer, placeholder);
-    else
-        ffFormatAppendFormatArg(buffer, &arguments[(*argCounter)++]);
+    // arguments start at 1, 0 is the error
+    return result == UINT32_MAX ? 0 : result;
 }
 
 static inline bool formatArgSet(const FFformatarg* arg)
@@ -78,27 +90,89 @@ static inline bool formatArgSet(const FFformatarg* arg)
     );
 }
 
-void ffParseFormatString(FFstrbuf* buffer, const FFstrbuf* formatstr, const FFstrbuf* error, uint32_t numArgs, const FFformatarg* arguments)
+static FFformatop* addOp(FFformat* format, FFformatoptype type, uint32_t sourceStart)
 {
-    uint32_t argCounter = 0;
+    FFformatop* op = ffListAdd(&format->ops);
+    op->type = type;
+    op->testsError = false;
+    op->index = 0;
+    op->literalStart = format->literals.length;
+    op->literalLength = 0;
+    op->jump = 0;
+    op->sourceStart = sourceStart;
+    return op;
+}
 
-    uint32_t numOpenIfs = 0;
-    uint32_t numOpenNotIfs = 0;
-    uint32_t numOpenColors = 0;
+static void appendLiteral(FFformat* format, FFformatop* op, uint32_t length, const char* value)
+{
+    ffStrbufAppendNS(&format->literals, length, value);
+    op->literalLength += length;
+}
+
+static void appendLiteralChar(FFformat* format, uint32_t sourceStart, char c)
+{
+    FFformatop* op = format->ops.length == 0 ? NULL : ffListGet(&format->ops, format->ops.length - 1);
+    if(op == NULL || op->type != FF_FORMAT_OP_LITERAL)
+        op = addOp(format, FF_FORMAT_OP_LITERAL, sourceStart);
+
+    appendLiteral(format, op, 1, &c);
+}
+
+// the placeholder as it was written, printed if it can't be evaluated
+static void appendPlaceholderLiteral(FFformat* format, FFformatop* op, const char* start, const FFstrbuf* placeholderValue, bool closed)
+{
+    appendLiteral(format, op, (uint32_t) strlen(start), start);
+    appendLiteral(format, op, placeholderValue->length, placeholderValue->chars);
+
+    if(closed)
+        appendLiteral(format, op, 1, "}");
+}
 
-    for(uint32_t i = 0; i < formatstr->length; ++i)
+static void compileCondition(FFformat* format, FFformatoptype type, const FFstrbuf* placeholderValue, uint32_t sourceStart, uint32_t i)
+{
+    const FFstrbuf* formatstr = &format->sourceCopy;
+    FFformatop* op = addOp(format, type, sourceStart);
+
+    FFstrbuf condition;
+    ffStrbufInitCopy(&condition, placeholderValue);
+    ffStrbufSubstrAfter(&condition, 0);
+
+    op->testsError = placeholderValueIsForError(&condition);
+    op->index = getArgumentIndex(&condition);
+    appendPlaceholderLiteral(format, op, type == FF_FORMAT_OP_IF ? "{?" : "{/", &condition, i < formatstr->length);
+
+    // if the condition is false, everything until the next end is skipped, without respecting nesting
+    uint32_t end = ffStrbufNextIndexS(formatstr, i, type == FF_FORMAT_OP_IF ? "{?}" : "{/}") + 3;
+    op->jump = end > formatstr->length ? formatstr->length : end;
+
+    ffStrbufDestroy(&condition);
+}
+
+// Compiles the format string from start until its end and returns the index of the first op
+static uint32_t compileSegment(FFformat* format, uint32_t start)
+{
+    const FFstrbuf* formatstr = &format->sourceCopy;
+    uint32_t firstOp = format->ops.length;
+
+    FFstrbuf placeholderValue;
+    ffStrbufInit(&placeholderValue);
+
+    uint32_t i = start;
+    for(; i < formatstr->length; ++i)
     {
+        uint32_t sourceStart = i;
+
         // if we don't have a placeholder start just copy the chars over to output buffer
         if(formatstr->chars[i] != '{')
         {
-            ffStrbufAppendC(buffer, formatstr->chars[i]);
+            appendLiteralChar(format, sourceStart, formatstr->chars[i]);
             continue;
         }
 
         // if we have an { at the end handle it as {}
         if(i == formatstr->length - 1)
         {
-            appendEmptyPlaceholder(buffer, "{", &argCounter, numArgs, arguments);
+            appendLiteral(format, addOp(format, FF_FORMAT_OP_NEXT_ARG, sourceStart), 1, "{");
             continue;
         }
 
@@ -108,175 +182,208 @@ void ffParseFormatString(FFstrbuf* buffer, const FFstrbuf* formatstr, const FFst
         // double {{ elvaluates to a single { and doesn't count as start
         if(formatstr->chars[i] == '{')
         {
-            ffStrbufAppendC(buffer, '{');
+            appendLiteralChar(format, sourceStart, '{');
             continue;
         }
 
         // placeholder is {}
         if(formatstr->chars[i] == '}')
         {
-            appendEmptyPlaceholder(buffer, "{}", &argCounter, numArgs, arguments);
+            appendLiteral(format, addOp(format, FF_FORMAT_OP_NEXT_ARG, sourceStart), 2, "{}");
             continue;
         }
 
-        FFstrbuf placeholderValue;
-        ffStrbufInit(&placeholderValue);
+        ffStrbufClear(&placeholderValue);
+        uint32_t valueEnd = ffStrbufNextIndexC(formatstr, i, '}');
+        ffStrbufAppendNS(&placeholderValue, valueEnd - i, formatstr->chars + i);
+        i = valueEnd;
 
-        while(i < formatstr->length && formatstr->chars[i] != '}')
-            ffStrbufAppendC(&placeholderValue, formatstr->chars[i++]);
+        bool closed = i < formatstr->length;
 
         // test for error, if so print it
-        if(placeholderValueIsForError(&placeholderValue)) {
-            ffStrbufAppend(buffer, error);
-            ffStrbufDestroy(&placeholderValue);
+        if(placeholderValueIsForError(&placeholderValue))
+        {
+            addOp(format, FF_FORMAT_OP_ERROR, sourceStart);
             continue;
         }
 
-         // test if for stop, if so break the loop
+        // test if for stop, if so end the format string here
         if(placeholderValue.length == 1 && placeholderValue.chars[0] == '-')
         {
+            addOp(format, FF_FORMAT_OP_END, sourceStart);
             ffStrbufDestroy(&placeholderValue);
-            break;
+            return firstOp;
         }
 
-        // test for end of an if, if so do nothing
-        if(placeholderValue.length == 1 && placeholderValue.chars[0] == '?')
+        // test for the end of an if, not if or color
+        if(placeholderValue.length == 1 && (placeholderValue.chars[0] == '?' || placeholderValue.chars[0] == '/' || placeholderValue.chars[0] == '#'))
         {
-            if(numOpenIfs == 0)
-                appendInvalidPlaceholder(buffer, "{", &placeholderValue, i, formatstr->length);
-            else
-                --numOpenIfs;
+            FFformatoptype type =
+                placeholderValue.chars[0] == '?' ? FF_FORMAT_OP_END_IF :
+                placeholderValue.chars[0] == '/' ? FF_FORMAT_OP_END_IF_NOT :
+                FF_FORMAT_OP_END_COLOR;
 
-            ffStrbufDestroy(&placeholderValue);
+            appendPlaceholderLiteral(format, addOp(format, type, sourceStart), "{", &placeholderValue, closed);
             continue;
         }
 
-        // test for end of a not if, if so do nothing
-        if(placeholderValue.length == 1 && placeholderValue.chars[0] == '/')
+        // test for if and not if
+        if(placeholderValue.chars[0] == '?' || placeholderValue.chars[0] == '/')
         {
-            if(numOpenNotIfs == 0)
-                appendInvalidPlaceholder(buffer, "{", &placeholderValue, i, formatstr->length);
-            else
-                --numOpenNotIfs;
-
-            ffStrbufDestroy(&placeholderValue);
+            compileCondition(format, placeholderValue.chars[0] == '?' ? FF_FORMAT_OP_IF : FF_FORMAT_OP_IF_NOT, &placeholderValue, sourceStart, i);
             continue;
         }
 
-        // test for end of a color, if so do nothing
-        if(placeholderValue.length == 1 && placeholderValue.chars[0] == '#')
+        //test for color, the escape code is built here already
+        if(placeholderValue.chars[0] == '#')
         {
-            if(numOpenColors == 0)
-                appendInvalidPlaceholder(buffer, "{", &placeholderValue, i, formatstr->length);
-            else
-            {
-                ffStrbufAppendS(buffer, "\033[0m");
-                --numOpenColors;
-            }
-
-            ffStrbufDestroy(&placeholderValue);
+            FFformatop* op = addOp(format, FF_FORMAT_OP_COLOR, sourceStart);
+            appendLiteral(format, op, 2, "\033[");
+            appendLiteral(format, op, placeholderValue.length - 1, placeholderValue.chars + 1);
+            appendLiteral(format, op, 1, "m");
             continue;
         }
 
-        // test for if, if so evaluate it
-        if(placeholderValue.chars[0] == '?')
-        {
-            ffStrbufSubstrAfter(&placeholderValue, 0);
-
-            // continue if an error is set
-            if(placeholderValueIsForError(&placeholderValue) && error != NULL && error->length > 0)
-            {
-                ++numOpenIfs;
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+        FFformatop* op = addOp(format, FF_FORMAT_OP_ARG, sourceStart);
+        op->index = getArgumentIndex(&placeholderValue);
+        appendPlaceholderLiteral(format, op, "{", &placeholderValue, closed);
+    }
 
-            uint32_t index = getArgumentIndex(&placeholderValue);
+    addOp(format, FF_FORMAT_OP_END, formatstr->length);
+    ffStrbufDestroy(&placeholderValue);
+    return firstOp;
+}
 
-            // testing for an invalid index
-            if(index > numArgs)
-            {
-                appendInvalidPlaceholder(buffer, "{?", &placeholderValue, i, formatstr->length);
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+static void compileFormat(FFformat* format, const FFstrbuf* formatstr)
+{
+    format->source = formatstr;
+    ffStrbufInitCopy(&format->sourceCopy, formatstr);
+    ffStrbufInit(&format->literals);
+    ffListInitA(&format->ops, sizeof(FFformatop), 16);
 
-            // continue normally if an format arg is set and the value is > 0
-            if(formatArgSet(&arguments[index - 1]))
-            {
-                ++numOpenIfs;
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+    compileSegment(format, 0);
 
-            // fastforward to the end of the if without printing the in between
-            i = ffStrbufNextIndexS(formatstr, i, "{?}") + 2; // 2 is the length of "{?}" - 1 because the loop will increament it again directly after continue
-            ffStrbufDestroy(&placeholderValue);
+    // Conditions jump to where their end is found in the format string. Mostly that is the start of an op already.
+    // If not, for example because the end is inside of a placeholder, the format string is compiled again from there.
+    for(uint32_t i = 0; i < format->ops.length; ++i)
+    {
+        FFformatop* op = ffListGet(&format->ops, i);
+        if(op->type != FF_FORMAT_OP_IF && op->type != FF_FORMAT_OP_IF_NOT)
             continue;
-        }
 
-        // test for not if, if so evaluate it
-        if(placeholderValue.chars[0] == '/')
-        {
-            ffStrbufSubstrAfter(&placeholderValue, 0);
+        uint32_t target = 0;
+        while(target < format->ops.length && ((FFformatop*) ffListGet(&format->ops, target))->sourceStart != op->jump)
+            ++target;
 
-            //continue if an error os not set
-            if(placeholderValueIsForError(&placeholderValue) && (error == NULL || error->length == 0))
-            {
-                ++numOpenNotIfs;
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+        if(target == format->ops.length)
+            target = compileSegment(format, op->jump);
 
-            uint32_t index = getArgumentIndex(&placeholderValue);
+        // the list may have grown
+        ((FFformatop*) ffListGet(&format->ops, i))->jump = target;
+    }
+}
 
-            // testing for an invalid index
-            if(index > numArgs)
-            {
-                appendInvalidPlaceholder(buffer, "{/", &placeholderValue, i, formatstr->length);
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+static void destroyFormat(FFformat* format)
+{
+    ffStrbufDestroy(&format->sourceCopy);
+    ffStrbufDestroy(&format->literals);
+    ffListDestroy(&format->ops);
+}
 
-            //continue normally if an format arg is not set or the value is 0
-            if(!formatArgSet(&arguments[index - 1]))
-            {
-                ++numOpenNotIfs;
-                ffStrbufDestroy(&placeholderValue);
-                continue;
-            }
+static const FFformat* findFormat(FFinstance* instance, const FFstrbuf* formatstr)
+{
+    for(uint32_t i = 0; i < instance->config.formats.length; ++i)
+    {
+        const FFformat* format = ffListGet(&instance->config.formats, i);
+        if(format->source == formatstr && ffStrbufComp(&format->sourceCopy, formatstr) == 0)
+            return format;
+    }
 
-            // fastforward to the end of the if without printing the in between
-            i = ffStrbufNextIndexS(formatstr, i, "{/}") + 2; // 2 is the length of "{/}" - 1 because the loop will increament it again directly after continue
-            ffStrbufDestroy(&placeholderValue);
-            continue;
+    return NULL;
+}
+
+// Must be called before any printing starts, afterwards the compiled formats are only read, from multiple threads
+void ffFormatCompile(FFinstance* instance, const FFstrbuf* formatstr)
+{
+    if(formatstr->length == 0 || findFormat(instance, formatstr) != NULL)
+        return;
+
+    compileFormat(ffListAdd(&instance->config.formats), formatstr);
+}
+
+static void executeFormat(const FFformat* format, FFstrbuf* buffer, const FFstrbuf* error, uint32_t numArgs, const FFformatarg* arguments)
+{
+    uint32_t argCounter = 0;
+
+    uint32_t numOpenIfs = 0;
+    uint32_t numOpenNotIfs = 0;
+    uint32_t numOpenColors = 0;
+
+    bool errorSet = error != NULL && error->length > 0;
+
+    const FFformatop* ops = (const FFformatop*) format->ops.data;
+    for(uint32_t i = 0; ops[i].type != FF_FORMAT_OP_END; ++i)
+    {
+        const FFformatop* op = &ops[i];
+        const char* literal = format->literals.chars + op->literalStart;
+
+        if(op->type == FF_FORMAT_OP_LITERAL)
+            ffStrbufAppendNS(buffer, op->literalLength, literal);
+        else if(op->type == FF_FORMAT_OP_NEXT_ARG)
+        {
+            if(argCounter >= numArgs)
+                ffStrbufAppendNS(buffer, op->literalLength, literal);
+            else
+                ffFormatAppendFormatArg(buffer, &arguments[argCounter++]);
+        }
+        else if(op->type == FF_FORMAT_OP_ARG)
+        {
+            if(op->index == 0 || op->index > numArgs)
+                ffStrbufAppendNS(buffer, op->literalLength, literal);
+            else
+                ffFormatAppendFormatArg(buffer, &arguments[op->index - 1]);
+        }
+        else if(op->type == FF_FORMAT_OP_ERROR)
+            ffStrbufAppend(buffer, error);
+        else if(op->type == FF_FORMAT_OP_IF || op->type == FF_FORMAT_OP_IF_NOT)
+        {
+            bool isIf = op->type == FF_FORMAT_OP_IF;
+            uint32_t* numOpen = isIf ? &numOpenIfs : &numOpenNotIfs;
+
+            // an if continues if an error is set, a not if if it is not
+            if(op->testsError && errorSet == isIf)
+                ++*numOpen;
+            else if(op->index == 0 || op->index > numArgs)
+                ffStrbufAppendNS(buffer, op->literalLength, literal);
+            else if(formatArgSet(&arguments[op->index - 1]) == isIf)
+                ++*numOpen;
+            else
+                i = op->jump - 1; // the loop increments it again
         }
+        else if(op->type == FF_FORMAT_OP_END_IF || op->type == FF_FORMAT_OP_END_IF_NOT)
+        {
+            uint32_t* numOpen = op->type == FF_FORMAT_OP_END_IF ? &numOpenIfs : &numOpenNotIfs;
 
-        //test for color, if so evaluate it
-        if(placeholderValue.chars[0] == '#')
+            if(*numOpen == 0)
+                ffStrbufAppendNS(buffer, op->literalLength, literal);
+            else
+                --*numOpen;
+        }
+        else if(op->type == FF_FORMAT_OP_COLOR)
         {
             ++numOpenColors;
-            ffStrbufSubstrAfter(&placeholderValue, 0);
-            ffStrbufAppendS(buffer, "\033[");
-            ffStrbufAppend(buffer, &placeholderValue);
-            ffStrbufAppendC(buffer, 'm');
-            ffStrbufDestroy(&placeholderValue);
-            continue;
+            ffStrbufAppendNS(buffer, op->literalLength, literal);
         }
-
-        uint32_t index = getArgumentIndex(&placeholderValue);
-
-        // test for invalid index
-        if(index > numArgs)
+        else if(op->type == FF_FORMAT_OP_END_COLOR)
         {
-            appendInvalidPlaceholder(buffer, "{", &placeholderValue, i, formatstr->length);
-            ffStrbufDestroy(&placeholderValue);
-            continue;
+            if(numOpenColors == 0)
+                ffStrbufAppendNS(buffer, op->literalLength, literal);
+            else
+            {
+                ffStrbufAppendS(buffer, "\033[0m");
+                --numOpenColors;
+            }
         }
-
-        ffFormatAppendFormatArg(buffer, &arguments[index - 1]);
-
-        ffStrbufDestroy(&placeholderValue);
     }
 
     ffStrbufTrimRight(buffer, ' ');
@@ -284,3 +391,19 @@ void ffParseFormatString(FFstrbuf* buffer, const FFstrbuf* formatstr, const FFst
     if(numOpenColors > 0)
         ffStrbufAppendS(buffer, "\033[0m");
 }
+
+void ffParseFormatString(FFinstance* instance, FFstrbuf* buffer, const FFstrbuf* formatstr, const FFstrbuf* error, uint32_t numArgs, const FFformatarg* arguments)
+{
+    const FFformat* format = findFormat(instance, formatstr);
+    if(format != NULL)
+    {
+        executeFormat(format, buffer, error, numArgs, arguments);
+        return;
+    }
+
+    // not compiled by ffFormatCompile, or changed since
+    FFformat temporary;
+    compileFormat(&temporary, formatstr);
+    executeFormat(&temporary, buffer, error, numArgs, arguments);
+    destroyFormat(&temporary);
+}
@@ -1,5 +1,6 @@
 #include "fastfetch.h"
 
+#include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -93,6 +94,7 @@ static void initState(FFstate* state)
     state->passwd = getpwuid(getuid());
     uname(&state->utsname);
     sysinfo(&state->sysinfo);
+    state->ppid = getppid();
 
     initConfigDirs(state);
     initCacheDir(state);
@@ -112,76 +114,90 @@ static void defaultConfig(FFinstance* instance)
     instance->config.allowSlowOperations = false;
     instance->config.disableLinewrap = true;
     instance->config.hideCursor = true;
+    instance->config.stat = false;
+    ffStrbufInit(&instance->config.traceFile);
+    ffStrbufInitS(&instance->config.timeoutPlaceholder, "Timed out");
+    instance->config.outputFormat = FF_OUTPUT_FORMAT_TEXT;
 
     //This is basically the none logo
     for(uint8_t i = 0; i < sizeof(instance->config.logo.colors) / sizeof(instance->config.logo.colors[0]); ++i)
         instance->config.logo.colors[i] = "";
-    instance->config.logo.allLinesSameLength = true;
     instance->config.logo.freeable = false;
     instance->config.logo.lines = "";
+    instance->config.logo.compiled = false;
+    ffStrbufInitA(&instance->config.logo.compiledChars, 2048);
+    ffListInitA(&instance->config.logo.compiledLines, sizeof(FFlogoline), 32);
+    instance->config.logo.currentLine = 0;
 
     //Since most of these properties are unlikely to be used at once, give them minimal heap space (the \0 character)
-    ffStrbufInitA(&instance->config.osFormat, 1);
-    ffStrbufInitA(&instance->config.osKey, 1);
-    ffStrbufInitA(&instance->config.hostFormat, 1);
-    ffStrbufInitA(&instance->config.hostKey, 1);
-    ffStrbufInitA(&instance->config.kernelFormat, 1);
-    ffStrbufInitA(&instance->config.kernelKey, 1);
-    ffStrbufInitA(&instance->config.uptimeFormat, 1);
-    ffStrbufInitA(&instance->config.uptimeKey, 1);
-    ffStrbufInitA(&instance->config.packagesFormat, 1);
-    ffStrbufInitA(&instance->config.packagesKey, 1);
-    ffStrbufInitA(&instance->config.shellFormat, 1);
-    ffStrbufInitA(&instance->config.shellKey, 1);
-    ffStrbufInitA(&instance->config.resolutionFormat, 1);
-    ffStrbufInitA(&instance->config.resolutionKey, 1);
-    ffStrbufInitA(&instance->config.deFormat, 1);
-    ffStrbufInitA(&instance->config.deKey, 1);
-    ffStrbufInitA(&instance->config.wmFormat, 1);
-    ffStrbufInitA(&instance->config.wmKey, 1);
-    ffStrbufInitA(&instance->config.wmThemeFormat, 1);
-    ffStrbufInitA(&instance->config.wmThemeKey, 1);
-    ffStrbufInitA(&instance->config.themeFormat, 1);
-    ffStrbufInitA(&instance->config.themeKey, 1);
-    ffStrbufInitA(&instance->config.iconsFormat, 1);
-    ffStrbufInitA(&instance->config.iconsKey, 1);
-    ffStrbufInitA(&instance->config.fontFormat, 1);
-    ffStrbufInitA(&instance->config.fontKey, 1);
-    ffStrbufInitA(&instance->config.cursorKey, 1);
-    ffStrbufInitA(&instance->config.cursorFormat, 1);
-    ffStrbufInitA(&instance->config.terminalFormat, 1);
-    ffStrbufInitA(&instance->config.terminalKey, 1);
-    ffStrbufInitA(&instance->config.termFontFormat, 1);
-    ffStrbufInitA(&instance->config.termFontKey, 1);
-    ffStrbufInitA(&instance->config.cpuFormat, 1);
-    ffStrbufInitA(&instance->config.cpuKey, 1);
-    ffStrbufInitA(&instance->config.gpuFormat, 1);
-    ffStrbufInitA(&instance->config.gpuKey, 1);
-    ffStrbufInitA(&instance->config.memoryFormat, 1);
-    ffStrbufInitA(&instance->config.memoryKey, 1);
-    ffStrbufInitA(&instance->config.diskFormat, 1);
-    ffStrbufInitA(&instance->config.diskKey, 1);
-    ffStrbufInitA(&instance->config.batteryFormat, 1);
-    ffStrbufInitA(&instance->config.batteryKey, 1);
-    ffStrbufInitA(&instance->config.localeFormat, 1);
-    ffStrbufInitA(&instance->config.localeKey, 1);
-
-    ffStrbufInitA(&instance->config.libPCI, 1);
-    ffStrbufInitA(&instance->config.libX11, 1);
-    ffStrbufInitA(&instance->config.libXrandr, 1);
-    ffStrbufInitA(&instance->config.libGIO, 1);
-    ffStrbufInitA(&instance->config.libDConf, 1);
-    ffStrbufInitA(&instance->config.libWayland, 1);
-    ffStrbufInitA(&instance->config.libXFConf, 1);
-    ffStrbufInitA(&instance->config.libSQLite, 1);
-
-    ffStrbufInitA(&instance->config.diskFolders, 1);
-
-    ffStrbufInitA(&instance->config.batteryDir, 1);
+    ffStrbufInit(&instance->config.osFormat);
+    ffStrbufInit(&instance->config.osKey);
+    ffStrbufInit(&instance->config.hostFormat);
+    ffStrbufInit(&instance->config.hostKey);
+    ffStrbufInit(&instance->config.kernelFormat);
+    ffStrbufInit(&instance->config.kernelKey);
+    ffStrbufInit(&instance->config.uptimeFormat);
+    ffStrbufInit(&instance->config.uptimeKey);
+    ffStrbufInit(&instance->config.packagesFormat);
+    ffStrbufInit(&instance->config.packagesKey);
+    ffStrbufInit(&instance->config.shellFormat);
+    ffStrbufInit(&instance->config.shellKey);
+    ffStrbufInit(&instance->config.resolutionFormat);
+    ffStrbufInit(&instance->config.resolutionKey);
+    ffStrbufInit(&instance->config.deFormat);
+    ffStrbufInit(&instance->config.deKey);
+    ffStrbufInit(&instance->config.wmFormat);
+    ffStrbufInit(&instance->config.wmKey);
+    ffStrbufInit(&instance->config.wmThemeFormat);
+    ffStrbufInit(&instance->config.wmThemeKey);
+    ffStrbufInit(&instance->config.themeFormat);
+    ffStrbufInit(&instance->config.themeKey);
+    ffStrbufInit(&instance->config.iconsFormat);
+    ffStrbufInit(&instance->config.iconsKey);
+    ffStrbufInit(&instance->config.fontFormat);
+    ffStrbufInit(&instance->config.fontKey);
+    ffStrbufInit(&instance->config.cursorKey);
+    ffStrbufInit(&instance->config.cursorFormat);
+    ffStrbufInit(&instance->config.terminalFormat);
+    ffStrbufInit(&instance->config.terminalKey);
+    ffStrbufInit(&instance->config.termFontFormat);
+    ffStrbufInit(&instance->config.termFontKey);
+    ffStrbufInit(&instance->config.cpuFormat);
+    ffStrbufInit(&instance->config.cpuKey);
+    ffStrbufInit(&instance->config.gpuFormat);
+    ffStrbufInit(&instance->config.gpuKey);
+    ffStrbufInit(&instance->config.memoryFormat);
+    ffStrbufInit(&instance->config.memoryKey);
+    ffStrbufInit(&instance->config.diskFormat);
+    ffStrbufInit(&instance->config.diskKey);
+    ffStrbufInit(&instance->config.batteryFormat);
+    ffStrbufInit(&instance->config.batteryKey);
+    ffStrbufInit(&instance->config.localeFormat);
+    ffStrbufInit(&instance->config.localeKey);
+
+    ffListInit(&instance->config.formats, sizeof(FFformat));
+
+    ffStrbufInit(&instance->config.libX11);
+    ffStrbufInit(&instance->config.libXrandr);
+    ffStrbufInit(&instance->config.libGIO);
+    ffStrbufInit(&instance->config.libDConf);
+    ffStrbufInit(&instance->config.libWayland);
+    ffStrbufInit(&instance->config.libXFConf);
+    ffStrbufInit(&instance->config.libSQLite);
+
+    ffStrbufInit(&instance->config.diskFolders);
+
+    ffStrbufInit(&instance->config.batteryDir);
+
+    ffStrbufInit(&instance->config.pciIds);
 }
 
 void ffInitInstance(FFinstance* instance)
 {
+    //Config and state strings are allocated from the arena too, so it must be in use first
+    ffArenaInit(&instance->arena);
+    ffArenaUse(&instance->arena);
+
     initState(&instance->state);
     defaultConfig(instance);
     ffCacheValidate(instance);
@@ -189,31 +205,63 @@ void ffInitInstance(FFinstance* instance)
 
 void ffStart(FFinstance* instance)
 {
+    //Escape codes would end up in the JSON
+    if(instance->config.outputFormat != FF_OUTPUT_FORMAT_TEXT)
+        return;
+
     if(instance->config.hideCursor)
-        fputs("\033[?25l", stdout);
+        ffOutputAppendS("\033[?25l");
 
     if(instance->config.disableLinewrap)
-        fputs("\033[?7l", stdout);
+        ffOutputAppendS("\033[?7l");
+}
+
+//Detection results live in the arena of the instance and are detected again once it was reset.
+//Must be called with the mutex of the detector locked. Returns false if the result of the current run already exists.
+bool ffDetectionInit(FFinstance* instance, void** result, size_t size, uint32_t* generation)
+{
+    if(*result != NULL && *generation == instance->arena.generation)
+        return false;
+
+    *result = ffArenaAlloc(&instance->arena, size);
+    memset(*result, 0, size);
+    *generation = instance->arena.generation;
+    return true;
 }
 
-static void ffCleanup(FFinstance* instance)
+static void ffCleanup(FFinstance* instance, bool workersJoined)
 {
-    UNUSED(instance);
-    // Place for cleaning up
-    // I dont destroy the global strbufs, because the OS is typically faster doing it after the program terminates
-    // This eliminates one function call per strbuf + setting things like length to 0
+    //A worker that is still running after a print timed out may use anything of the arena, so it is left to the exit of the process
+    if(!workersJoined)
+        return;
+
+    //Everything of the run, including config and state, is freed with a few calls. The instance must be initialized again before reuse
+    ffCacheRelease();
+    ffArenaReset(&instance->arena);
+    ffArenaUse(NULL);
 }
 
 void ffFinish(FFinstance* instance)
 {
-    if(instance->config.printRemainingLogo)
-        ffPrintRemainingLogo(instance);
+    if(instance->config.outputFormat == FF_OUTPUT_FORMAT_TEXT)
+    {
+        ffOutputAddSlot();
 
-    if(instance->config.disableLinewrap)
-        fputs("\033[?7h", stdout);
+        if(instance->config.printRemainingLogo)
+            ffPrintRemainingLogo(instance);
 
-    if(instance->config.hideCursor)
-        fputs("\033[?25h", stdout);
+        if(instance->config.disableLinewrap)
+            ffOutputAppendS("\033[?7h");
+
+        if(instance->config.hideCursor)
+            ffOutputAppendS("\033[?25h");
+    }
+
+    //Output is complete at this point, so waiting for the workers doesn't delay anything visible
+    ffOutputFlush();
+    bool workersJoined = ffFinishDetectionThreads(instance);
+    ffCacheFlush(instance);
+    ffTraceFlush(instance);
 
-    ffCleanup(instance);
+    ffCleanup(instance, workersJoined);
 }
@@ -1,40 +1,42 @@
 #include "fastfetch.h"
 
 #include <malloc.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define FF_IO_CACHE_VALUE_EXTENSION "ffcv"
-#define FF_IO_CACHE_SPLIT_EXTENSION "ffcs"
 
 void ffPrintLogoAndKey(FFinstance* instance, const char* moduleName, uint8_t moduleIndex, const FFstrbuf* customKeyFormat)
 {
     ffPrintLogoLine(instance);
 
-    fputs(FASTFETCH_TEXT_MODIFIER_BOLT, stdout);
-    ffStrbufWriteTo(&instance->config.color, stdout);
-
-    FF_STRBUF_CREATE(key);
+    ffOutputAppendS(FASTFETCH_TEXT_MODIFIER_BOLT);
+    ffOutputAppend(&instance->config.color);
 
+    //The default key goes to the output directly, only a custom one needs a buffer to be formatted in
     if(customKeyFormat == NULL || customKeyFormat->length == 0)
     {
-        ffStrbufAppendS(&key, moduleName);
+        ffOutputAppendS(moduleName);
 
         if(moduleIndex > 0)
-            ffStrbufAppendF(&key, " %hhu", moduleIndex);
+            ffOutputAppendF(" %hhu", moduleIndex);
     }
     else
     {
-        ffParseFormatString(&key, customKeyFormat, NULL, 1, (FFformatarg[]){
+        FF_STRBUF_CREATE(key);
+        ffParseFormatString(instance, &key, customKeyFormat, NULL, 1, (FFformatarg[]){
             {FF_FORMAT_ARG_TYPE_UINT8, &moduleIndex}
         });
+        ffOutputAppend(&key);
+        ffStrbufDestroy(&key);
     }
 
-    ffStrbufWriteTo(&key, stdout);
-    fputs(FASTFETCH_TEXT_MODIFIER_RESET, stdout);
-    ffStrbufWriteTo(&instance->config.separator, stdout);
-    ffStrbufDestroy(&key);
+    ffOutputAppendS(FASTFETCH_TEXT_MODIFIER_RESET);
+    ffOutputAppend(&instance->config.separator);
 }
 
 void ffPrintError(FFinstance* instance, const char* moduleName, uint8_t moduleIndex, const FFstrbuf* customKeyFormat, const FFstrbuf* formatString, uint32_t numFormatArgs, const char* message, ...)
@@ -48,9 +50,12 @@ void ffPrintError(FFinstance* instance, const char* moduleName, uint8_t moduleIn
     if(formatString == NULL || formatString->length == 0)
     {
         ffPrintLogoAndKey(instance, moduleName, moduleIndex, customKeyFormat);
-        fputs(FASTFETCH_TEXT_MODIFIER_ERROR, stdout);
-        vprintf(message, arguments);
-        puts(FASTFETCH_TEXT_MODIFIER_RESET);
+        FF_STRBUF_CREATE(error);
+        ffStrbufAppendVF(&error, message, arguments);
+        ffOutputAppendS(FASTFETCH_TEXT_MODIFIER_ERROR);
+        ffOutputAppend(&error);
+        ffOutputPutS(FASTFETCH_TEXT_MODIFIER_RESET);
+        ffStrbufDestroy(&error);
     }
     else
     {
@@ -74,12 +79,12 @@ void ffPrintFormatString(FFinstance* instance, const char* moduleName, uint8_t m
     FFstrbuf buffer;
     ffStrbufInitA(&buffer, 256);
 
-    ffParseFormatString(&buffer, formatString, error, numArgs, arguments);
+    ffParseFormatString(instance, &buffer, formatString, error, numArgs, arguments);
 
     if(buffer.length > 0)
     {
         ffPrintLogoAndKey(instance, moduleName, moduleIndex, customKeyFormat);
-        ffStrbufPutTo(&buffer, stdout);
+        ffOutputPut(&buffer);
     }
 
     ffStrbufDestroy(&buffer);
@@ -102,7 +107,15 @@ void ffReadCacheFile(FFinstance* instance, const char* moduleName, const char* e
     FFstrbuf path;
     ffStrbufInitA(&path, 64);
     ffGetCacheFilePath(instance, moduleName, extension, &path);
-    ffAppendFileContent(path.chars, buffer);
+
+    //The cache is always the one of the host, not of the sysroot
+    int fd = open(path.chars, O_RDONLY | O_CLOEXEC);
+    if(fd != -1)
+    {
+        ffAppendFDContent(fd, buffer);
+        close(fd);
+    }
+
     ffStrbufDestroy(&path);
 }
 
@@ -115,45 +128,351 @@ void ffWriteCacheFile(FFinstance* instance, const char* moduleName, const char*
     ffStrbufDestroy(&path);
 }
 
-static bool printCachedValue(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat)
+//The cache is one file: a header, an index with one entry per module and the data the entries point into.
+//It is only read through a read-only mapping and only replaced as a whole via rename, so concurrent runs never see a half written file.
+
+#define FF_IO_CACHE_FILE_NAME "cache.ffc"
+#define FF_IO_CACHE_MAGIC "FFCACHE"
+#define FF_IO_CACHE_FORMAT_VERSION 2
+#define FF_IO_CACHE_NAME_LENGTH 32
+
+typedef struct FFcacheheader
 {
-    FFstrbuf content;
-    ffStrbufInitA(&content, 512);
-    ffReadCacheFile(instance, moduleName, FF_IO_CACHE_VALUE_EXTENSION, &content);
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t numEntries;
+    char projectVersion[32];
+} FFcacheheader;
 
-    ffStrbufTrimRight(&content, '\0'); //Strbuf always appends a '\0' at the end. We want the last null byte to be at the position of the length
+typedef struct FFcacheentry
+{
+    char moduleName[FF_IO_CACHE_NAME_LENGTH];
+    uint32_t valueOffset; //Offsets are relative to the start of the file
+    uint32_t valueLength;
+    uint32_t splitOffset;
+    uint32_t splitLength;
+    uint64_t fingerprint; //Of the inputs the cached values were detected from, see cacheInputs
+} FFcacheentry;
+
+typedef struct FFcachefingerprint
+{
+    char moduleName[FF_IO_CACHE_NAME_LENGTH];
+    uint64_t fingerprint;
+} FFcachefingerprint;
 
-    if(content.length == 0)
-        return false;
+#define FF_IO_CACHE_MAX_FINGERPRINTS 32
+
+typedef struct FFcachepending
+{
+    char moduleName[FF_IO_CACHE_NAME_LENGTH];
+    uint64_t fingerprint;
+    FFstrbuf value;
+    FFstrbuf split;
+} FFcachepending;
+
+static struct
+{
+    const char* data; //NULL if there is no valid cache file
+    size_t size;
+    const FFcacheentry* entries;
+    uint32_t numEntries;
+    FFlist pending; //FFcachepending, written by ffCacheFlush
+    bool pendingInit;
+    FFcachefingerprint fingerprints[FF_IO_CACHE_MAX_FINGERPRINTS]; //Of the first lookup of each module in this run
+    uint32_t numFingerprints;
+    pthread_mutex_t pendingMutex; //Detection threads close caches too. Also guards fingerprints
+} cacheFile = {
+    .pendingMutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+typedef enum FFcacheinputtype
+{
+    FF_CACHE_INPUT_NONE = 0,
+    FF_CACHE_INPUT_FILE_STAT, //dev, inode, size and mtime of a file or directory
+    FF_CACHE_INPUT_FILE_CONTENT, //For files whose stat doesn't change, e.g. in /proc
+    FF_CACHE_INPUT_ENV,
+    FF_CACHE_INPUT_PCIIDS //The pci.ids GPU names are looked up in, which --pci-ids can change
+} FFcacheinputtype;
+
+typedef struct FFcacheinput
+{
+    FFcacheinputtype type;
+    const char* name;
+} FFcacheinput;
+
+#define FF_IO_CACHE_MAX_INPUTS 4
+#define FF_IO_CACHE_BOOT_ID {FF_CACHE_INPUT_FILE_CONTENT, "/proc/sys/kernel/random/boot_id"}
+
+//A cached module is only used while the fingerprint of its inputs is unchanged.
+//Things that can only change with a reboot (kernel, DMI, CPU) are tied to the boot id.
+static const struct
+{
+    const char* moduleName;
+    FFcacheinput inputs[FF_IO_CACHE_MAX_INPUTS];
+} cacheInputs[] = {
+    {"OS", {
+        {FF_CACHE_INPUT_FILE_STAT, "/etc/os-release"},
+        {FF_CACHE_INPUT_FILE_STAT, "/usr/lib/os-release"}
+    }},
+    {"Host", {
+        FF_IO_CACHE_BOOT_ID
+    }},
+    {"CPU", {
+        FF_IO_CACHE_BOOT_ID
+    }},
+    {"GPU", {
+        FF_IO_CACHE_BOOT_ID,
+        {FF_CACHE_INPUT_FILE_STAT, "/sys/bus/pci/devices"},
+        {FF_CACHE_INPUT_PCIIDS, NULL}
+    }},
+    {"Locale", {
+        {FF_CACHE_INPUT_FILE_STAT, "/etc/locale.conf"},
+        {FF_CACHE_INPUT_ENV, "LANG"},
+        {FF_CACHE_INPUT_ENV, "LC_ALL"},
+        {FF_CACHE_INPUT_ENV, "LC_CTYPE"}
+    }},
+    //Package counts are cached per manager, so only the ones whose database changed are counted again.
+    //Adding or removing an entry changes the mtime of a directory.
+    {"PackagesPacman", {
+        {FF_CACHE_INPUT_FILE_STAT, "/var/lib/pacman/local"}
+    }},
+    {"PackagesDpkg", {
+        {FF_CACHE_INPUT_FILE_STAT, "/var/lib/dpkg/status"}
+    }},
+    {"PackagesRpm", {
+        {FF_CACHE_INPUT_FILE_STAT, "/var/lib/rpm/rpmdb.sqlite"},
+        {FF_CACHE_INPUT_FILE_STAT, "/var/lib/rpm/rpmdb.sqlite-wal"}
+    }},
+    {"PackagesXbps", {
+        {FF_CACHE_INPUT_FILE_STAT, "/var/db/xbps"}
+    }},
+    {"PackagesFlatpak", {
+        {FF_CACHE_INPUT_FILE_STAT, "/var/lib/flatpak/app"}
+    }},
+    {"PackagesSnap", {
+        {FF_CACHE_INPUT_FILE_STAT, "/snap"}
+    }}
+};
+
+#undef FF_IO_CACHE_BOOT_ID
+
+//FNV-1a
+uint64_t ffCacheFingerprintAppend(uint64_t hash, const void* data, size_t length)
+{
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= ((const uint8_t*) data)[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//A missing file hashes as all zeros, so it appearing changes the fingerprint too
+uint64_t ffCacheFingerprintAppendStat(uint64_t hash, const char* path)
+{
+    struct stat st;
+    uint64_t values[5] = {0};
+    if(stat(path, &st) == 0)
+    {
+        values[0] = (uint64_t) st.st_dev;
+        values[1] = (uint64_t) st.st_ino;
+        values[2] = (uint64_t) st.st_size;
+        values[3] = (uint64_t) st.st_mtim.tv_sec;
+        values[4] = (uint64_t) st.st_mtim.tv_nsec;
+    }
+    return ffCacheFingerprintAppend(hash, values, sizeof(values));
+}
+
+static uint64_t cacheFingerprint(FFinstance* instance, const char* moduleName)
+{
+    uint64_t hash = FF_CACHE_FINGERPRINT_INIT;
+
+    for(uint32_t i = 0; i < sizeof(cacheInputs) / sizeof(cacheInputs[0]); i++)
+    {
+        if(strcmp(cacheInputs[i].moduleName, moduleName) != 0)
+            continue;
+
+        for(uint32_t j = 0; j < FF_IO_CACHE_MAX_INPUTS; j++)
+        {
+            const FFcacheinput* input = &cacheInputs[i].inputs[j];
+
+            if(input->type == FF_CACHE_INPUT_FILE_STAT)
+                hash = ffCacheFingerprintAppendStat(hash, input->name);
+            else if(input->type == FF_CACHE_INPUT_FILE_CONTENT)
+            {
+                FFstrbuf content;
+                ffStrbufInit(&content);
+                ffAppendFileContent(input->name, &content);
+                hash = ffCacheFingerprintAppend(hash, content.chars, content.length + 1);
+                ffStrbufDestroy(&content);
+            }
+            else if(input->type == FF_CACHE_INPUT_ENV)
+            {
+                const char* value = getenv(input->name);
+                if(value == NULL)
+                    value = "";
+                hash = ffCacheFingerprintAppend(hash, value, strlen(value) + 1);
+            }
+            else if(input->type == FF_CACHE_INPUT_PCIIDS)
+            {
+                uint64_t fingerprint = ffPciidsFingerprint(instance);
+                hash = ffCacheFingerprintAppend(hash, &fingerprint, sizeof(fingerprint));
+            }
+        }
+
+        break;
+    }
+
+    return hash;
+}
+
+static bool cacheBlobValid(uint32_t offset, uint32_t length)
+{
+    if(length == 0)
+        return true;
+
+    //Every value is terminated by a '\0', so the last byte of a blob must be one
+    return (size_t) offset + length <= cacheFile.size && cacheFile.data[offset + length - 1] == '\0';
+}
+
+static void cacheMap(FFinstance* instance)
+{
+    FFstrbuf path;
+    ffStrbufInitA(&path, 64);
+    ffGetCacheFilePath(instance, FF_IO_CACHE_FILE_NAME, NULL, &path);
+    int fd = open(path.chars, O_RDONLY | O_CLOEXEC);
+    ffStrbufDestroy(&path);
+
+    if(fd == -1)
+        return;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FFcacheheader))
+    {
+        close(fd);
+        return;
+    }
+
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //The mapping stays valid
+    if(data == MAP_FAILED)
+        return;
+
+    const FFcacheheader* header = data;
+    size_t indexEnd = sizeof(FFcacheheader) + (size_t) header->numEntries * sizeof(FFcacheentry);
+
+    if(
+        memcmp(header->magic, FF_IO_CACHE_MAGIC, sizeof(FF_IO_CACHE_MAGIC)) != 0 ||
+        header->formatVersion != FF_IO_CACHE_FORMAT_VERSION ||
+        strncmp(header->projectVersion, FASTFETCH_PROJECT_VERSION, sizeof(header->projectVersion)) != 0 ||
+        indexEnd > (size_t) st.st_size
+    ) {
+        munmap(data, (size_t) st.st_size);
+        return;
+    }
+
+    cacheFile.data = data;
+    cacheFile.size = (size_t) st.st_size;
+    cacheFile.entries = (const FFcacheentry*) (cacheFile.data + sizeof(FFcacheheader));
+    cacheFile.numEntries = header->numEntries;
+
+    for(uint32_t i = 0; i < cacheFile.numEntries; i++)
+    {
+        const FFcacheentry* entry = &cacheFile.entries[i];
+        if(
+            memchr(entry->moduleName, '\0', sizeof(entry->moduleName)) == NULL ||
+            !cacheBlobValid(entry->valueOffset, entry->valueLength) ||
+            !cacheBlobValid(entry->splitOffset, entry->splitLength)
+        ) {
+            munmap(data, cacheFile.size);
+            cacheFile.data = NULL;
+            cacheFile.numEntries = 0;
+            return;
+        }
+    }
+}
+
+static const FFcacheentry* cacheGetEntryFingerprinted(FFinstance* instance, const char* moduleName, uint64_t fingerprint)
+{
+    if(instance->config.recache)
+        return NULL;
+
+    for(uint32_t i = 0; i < cacheFile.numEntries; i++)
+    {
+        if(strcmp(cacheFile.entries[i].moduleName, moduleName) != 0)
+            continue;
+
+        //Only this module is detected again if its inputs changed, all others are still served from cache
+        if(cacheFile.entries[i].fingerprint != fingerprint)
+            return NULL;
+
+        return &cacheFile.entries[i];
+    }
+
+    return NULL;
+}
+
+//The inputs are fingerprinted once per run, before the module is detected. If one changes during the detection,
+//the values are saved with the old fingerprint and detected again by the next run
+static uint64_t moduleFingerprint(FFinstance* instance, const char* moduleName)
+{
+    pthread_mutex_lock(&cacheFile.pendingMutex);
+
+    for(uint32_t i = 0; i < cacheFile.numFingerprints; i++)
+    {
+        if(strcmp(cacheFile.fingerprints[i].moduleName, moduleName) == 0)
+        {
+            uint64_t fingerprint = cacheFile.fingerprints[i].fingerprint;
+            pthread_mutex_unlock(&cacheFile.pendingMutex);
+            return fingerprint;
+        }
+    }
+
+    uint64_t fingerprint = cacheFingerprint(instance, moduleName);
+
+    if(cacheFile.numFingerprints < FF_IO_CACHE_MAX_FINGERPRINTS && strlen(moduleName) < FF_IO_CACHE_NAME_LENGTH)
+    {
+        FFcachefingerprint* stored = &cacheFile.fingerprints[cacheFile.numFingerprints++];
+        strcpy(stored->moduleName, moduleName);
+        stored->fingerprint = fingerprint;
+    }
+
+    pthread_mutex_unlock(&cacheFile.pendingMutex);
+    return fingerprint;
+}
+
+static const FFcacheentry* cacheGetEntry(FFinstance* instance, const char* moduleName)
+{
+    return cacheGetEntryFingerprinted(instance, moduleName, moduleFingerprint(instance, moduleName));
+}
+
+static bool printCachedValue(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFcacheentry* entry)
+{
+    const char* content = cacheFile.data + entry->valueOffset;
+    uint32_t length = entry->valueLength;
 
     uint8_t moduleCounter = 1;
 
     uint32_t startIndex = 0;
-    while(startIndex < content.length)
+    while(startIndex < length)
     {
-        uint32_t nullByteIndex = ffStrbufNextIndexC(&content, startIndex, '\0');
-        uint8_t moduleIndex = (moduleCounter == 1 && nullByteIndex == content.length) ? 0 : moduleCounter;
+        uint32_t valueLength = (uint32_t) strlen(content + startIndex);
+        uint32_t nullByteIndex = startIndex + valueLength;
+        uint8_t moduleIndex = (moduleCounter == 1 && nullByteIndex == length - 1) ? 0 : moduleCounter;
         ffPrintLogoAndKey(instance, moduleName, moduleIndex, customKeyFormat);
-        puts(content.chars + startIndex);
+        ffOutputAppendNS(valueLength, content + startIndex);
+        ffOutputAppendC('\n');
         startIndex = nullByteIndex + 1;
         ++moduleCounter;
     }
 
-    ffStrbufDestroy(&content);
-
     return moduleCounter > 1;
 }
 
-static bool printCachedFormat(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFstrbuf* formatString, uint32_t numArgs)
+static bool printCachedFormat(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFstrbuf* formatString, uint32_t numArgs, const FFcacheentry* entry)
 {
-    FFstrbuf content;
-    ffStrbufInitA(&content, 512);
-    ffReadCacheFile(instance, moduleName, FF_IO_CACHE_SPLIT_EXTENSION, &content);
-
-    ffStrbufTrimRight(&content, '\0'); //Strbuf always appends a '\0' at the end. We want the last null byte to be at the position of the length
-
-    if(content.length == 0)
-        return false;
+    const char* content = cacheFile.data + entry->splitOffset;
+    uint32_t length = entry->splitLength;
 
     uint8_t moduleCounter = 1;
 
@@ -161,17 +480,18 @@ static bool printCachedFormat(FFinstance* instance, const char* moduleName, cons
     uint32_t argumentCounter = 0;
 
     uint32_t startIndex = 0;
-    while(startIndex < content.length)
+    while(startIndex < length)
     {
+        //The strings point directly into the mapped file
         arguments[argumentCounter].type = FF_FORMAT_ARG_TYPE_STRING;
-        arguments[argumentCounter].value = &content.chars[startIndex];
+        arguments[argumentCounter].value = content + startIndex;
         ++argumentCounter;
 
-        uint32_t nullByteIndex = ffStrbufNextIndexC(&content, startIndex, '\0');
+        uint32_t nullByteIndex = startIndex + (uint32_t) strlen(content + startIndex);
 
         if(argumentCounter == numArgs)
         {
-            uint8_t moduleIndex = (moduleCounter == 1 && nullByteIndex == content.length) ? 0 : moduleCounter;
+            uint8_t moduleIndex = (moduleCounter == 1 && nullByteIndex == length - 1) ? 0 : moduleCounter;
             ffPrintFormatString(instance, moduleName, moduleIndex, customKeyFormat, formatString, NULL, numArgs, arguments);
             ++moduleCounter;
             argumentCounter = 0;
@@ -181,20 +501,26 @@ static bool printCachedFormat(FFinstance* instance, const char* moduleName, cons
     }
 
     free(arguments);
-    ffStrbufDestroy(&content);
 
     return moduleCounter > 1;
 }
 
 bool ffPrintFromCache(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFstrbuf* formatString, uint32_t numArgs)
 {
-    if(instance->config.recache)
-        return false;
+    FF_TRACE_BEGIN(traceBegin);
 
-    if(formatString == NULL || formatString->length == 0)
-        return printCachedValue(instance, moduleName, customKeyFormat);
+    const FFcacheentry* entry = cacheGetEntry(instance, moduleName);
+
+    bool printed;
+    if(entry == NULL)
+        printed = false;
+    else if(formatString == NULL || formatString->length == 0)
+        printed = printCachedValue(instance, moduleName, customKeyFormat, entry);
     else
-        return printCachedFormat(instance, moduleName, customKeyFormat, formatString, numArgs);
+        printed = printCachedFormat(instance, moduleName, customKeyFormat, formatString, numArgs, entry);
+
+    FF_TRACE_END(traceBegin, "cache", moduleName);
+    return printed;
 }
 
 void ffPrintAndAppendToCache(FFinstance* instance, const char* moduleName, uint8_t moduleIndex, const FFstrbuf* customKeyFormat, FFcache* cache, const FFstrbuf* value, const FFstrbuf* formatString, uint32_t numArgs, const FFformatarg* arguments)
@@ -202,30 +528,20 @@ void ffPrintAndAppendToCache(FFinstance* instance, const char* moduleName, uint8
     if(formatString == NULL || formatString->length == 0)
     {
         ffPrintLogoAndKey(instance, moduleName, moduleIndex, customKeyFormat);
-        ffStrbufPutTo(value, stdout);
+        ffOutputPut(value);
     }
     else
     {
         ffPrintFormatString(instance, moduleName, moduleIndex, customKeyFormat, formatString, NULL, numArgs, arguments);
     }
 
-    if(cache->value != NULL)
-    {
-        ffStrbufWriteTo(value, cache->value);
-        fputc('\0', cache->value);
-    }
-
-    if(cache->split == NULL)
-        return;
+    ffStrbufAppend(&cache->value, value);
+    ffStrbufAppendC(&cache->value, '\0');
 
     for(uint32_t i = 0; i < numArgs; i++)
     {
-        FFstrbuf buffer;
-        ffStrbufInit(&buffer);
-        ffFormatAppendFormatArg(&buffer, &arguments[i]);
-        ffStrbufWriteTo(&buffer, cache->split);
-        ffStrbufDestroy(&buffer);
-        fputc('\0', cache->split);
+        ffFormatAppendFormatArg(&cache->split, &arguments[i]);
+        ffStrbufAppendC(&cache->split, '\0');
     }
 }
 
@@ -239,102 +555,330 @@ void ffPrintAndSaveToCache(FFinstance* instance, const char* moduleName, const F
 
 void ffCacheValidate(FFinstance* instance)
 {
-    FFstrbuf path;
-    ffStrbufInitA(&path, 64);
-    ffGetCacheFilePath(instance, "cacheversion", "ffv", &path);
+    //A cache file of another version or format is ignored and replaced on the next ffCacheFlush
+    cacheMap(instance);
+}
 
-    FFstrbuf content;
-    ffStrbufInit(&content);
-    ffAppendFileContent(path.chars, &content);
+//Ignores whether the inputs changed since, for when a stale value is still better than none
+bool ffPrintLastCached(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat)
+{
+    for(uint32_t i = 0; i < cacheFile.numEntries; i++)
+    {
+        if(strcmp(cacheFile.entries[i].moduleName, moduleName) == 0)
+            return printCachedValue(instance, moduleName, customKeyFormat, &cacheFile.entries[i]);
+    }
+
+    return false;
+}
+
+bool ffCacheExists(FFinstance* instance, const char* moduleName)
+{
+    return cacheGetEntry(instance, moduleName) != NULL;
+}
+
+bool ffCacheGetValue(FFinstance* instance, const char* moduleName, FFstrbuf* value)
+{
+    FF_TRACE_BEGIN(traceBegin);
 
-    if(ffStrbufCompS(&content, FASTFETCH_PROJECT_VERSION) == 0)
+    const FFcacheentry* entry = cacheGetEntry(instance, moduleName);
+    if(entry != NULL && entry->valueLength > 0)
+        ffStrbufAppendS(value, cacheFile.data + entry->valueOffset);
+
+    FF_TRACE_END(traceBegin, "cache", moduleName);
+    return entry != NULL && entry->valueLength > 0;
+}
+
+void ffCacheOpenWrite(FFinstance* instance, const char* moduleName, FFcache* cache)
+{
+    cache->moduleName = moduleName;
+    cache->fingerprint = moduleFingerprint(instance, moduleName);
+    cache->save = instance->config.cacheSave;
+    ffStrbufInitA(&cache->value, 64);
+    ffStrbufInitA(&cache->split, 128);
+}
+
+void ffCacheClose(FFcache* cache)
+{
+    //Nothing would write it
+    if(!cache->save)
     {
-        ffStrbufDestroy(&content);
-        ffStrbufDestroy(&path);
+        ffStrbufDestroy(&cache->value);
+        ffStrbufDestroy(&cache->split);
         return;
     }
 
-    instance->config.recache = true;
+    pthread_mutex_lock(&cacheFile.pendingMutex);
 
-    FFstrbuf version;
-    ffStrbufInit(&version);
-    ffStrbufAppendS(&version, FASTFETCH_PROJECT_VERSION);
-    ffWriteFileContent(path.chars, &version);
-    ffStrbufDestroy(&version);
+    if(!cacheFile.pendingInit)
+    {
+        ffListInitA(&cacheFile.pending, sizeof(FFcachepending), 8);
+        cacheFile.pendingInit = true;
+    }
 
-    ffStrbufDestroy(&content);
-    ffStrbufDestroy(&path);
+    FFcachepending* pending = NULL;
+    for(uint32_t i = 0; i < cacheFile.pending.length; i++)
+    {
+        FFcachepending* current = ffListGet(&cacheFile.pending, i);
+        if(strcmp(current->moduleName, cache->moduleName) == 0)
+        {
+            ffStrbufDestroy(&current->value);
+            ffStrbufDestroy(&current->split);
+            pending = current;
+            break;
+        }
+    }
+
+    if(pending == NULL)
+    {
+        pending = ffListAdd(&cacheFile.pending);
+        memset(pending->moduleName, 0, sizeof(pending->moduleName));
+        memcpy(pending->moduleName, cache->moduleName, strnlen(cache->moduleName, sizeof(pending->moduleName) - 1));
+    }
+
+    pending->fingerprint = cache->fingerprint;
+
+    //Move the buffers, the FFcache must not be used anymore after closing
+    pending->value = cache->value;
+    pending->split = cache->split;
+
+    pthread_mutex_unlock(&cacheFile.pendingMutex);
 }
 
-void ffCacheOpenWrite(FFinstance* instance, const char* moduleName, FFcache* cache)
+//For values whose inputs are only known at runtime, e.g. the executable of a command. The caller computes the fingerprint
+bool ffCacheGetValueFingerprinted(FFinstance* instance, const char* name, uint64_t fingerprint, FFstrbuf* value)
 {
-    FFstrbuf cacheFileValue;
-    ffStrbufInitA(&cacheFileValue, 64);
-    ffGetCacheFilePath(instance, moduleName, FF_IO_CACHE_VALUE_EXTENSION, &cacheFileValue);
-    cache->value = fopen(cacheFileValue.chars, "w");
-    ffStrbufDestroy(&cacheFileValue);
+    const FFcacheentry* entry = cacheGetEntryFingerprinted(instance, name, fingerprint);
+    if(entry == NULL || entry->valueLength == 0)
+        return false;
 
-    FFstrbuf cacheFileSplit;
-    ffStrbufInitA(&cacheFileSplit, 64);
-    ffGetCacheFilePath(instance, moduleName, FF_IO_CACHE_SPLIT_EXTENSION, &cacheFileSplit);
-    cache->split = fopen(cacheFileSplit.chars, "w");
-    ffStrbufDestroy(&cacheFileSplit);
+    ffStrbufAppendS(value, cacheFile.data + entry->valueOffset);
+    return true;
 }
 
-void ffCacheClose(FFcache* cache)
+void ffCacheSetValueFingerprinted(FFinstance* instance, const char* name, uint64_t fingerprint, const FFstrbuf* value)
 {
-    if(cache->value != NULL)
-        fclose(cache->value);
+    FFcache cache;
+    ffCacheOpenWrite(instance, name, &cache);
+    cache.fingerprint = fingerprint;
+    ffStrbufAppend(&cache.value, value);
+    ffStrbufAppendC(&cache.value, '\0');
+    ffCacheClose(&cache);
+}
 
-    if(cache->split != NULL)
-        fclose(cache->split);
+//FFstrbuf functions stop at '\0', but the cache file is binary
+static void appendBytes(FFstrbuf* buffer, const void* bytes, uint32_t length)
+{
+    ffStrbufEnsureFree(buffer, length);
+    memcpy(buffer->chars + buffer->length, bytes, length);
+    buffer->length += length;
+    buffer->chars[buffer->length] = '\0';
 }
 
-bool ffParsePropFileValues(const char* filename, uint32_t numQueries, FFpropquery* queries)
+static bool pendingHasName(const void* pending, const void* moduleName)
+{
+    return strcmp(((const FFcachepending*) pending)->moduleName, (const char*) moduleName) == 0;
+}
+
+static void cacheAppendEntry(FFstrbuf* index, FFstrbuf* data, uint32_t dataOffset, const char* moduleName, uint64_t fingerprint, const char* value, uint32_t valueLength, const char* split, uint32_t splitLength)
 {
-    bool* searchedValues = malloc(sizeof(bool) * numQueries);
-    bool allSet = true;
-    for(uint32_t i = 0; i < numQueries; i++)
+    FFcacheentry entry;
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.moduleName, moduleName, strnlen(moduleName, sizeof(entry.moduleName) - 1));
+    entry.fingerprint = fingerprint;
+
+    entry.valueOffset = dataOffset + data->length;
+    entry.valueLength = valueLength;
+    appendBytes(data, value, valueLength);
+
+    entry.splitOffset = dataOffset + data->length;
+    entry.splitLength = splitLength;
+    appendBytes(data, split, splitLength);
+
+    appendBytes(index, &entry, sizeof(entry));
+}
+
+void ffCacheFlush(FFinstance* instance)
+{
+    //A print that overran its timeout may still close a cache
+    pthread_mutex_lock(&cacheFile.pendingMutex);
+
+    if(!cacheFile.pendingInit || cacheFile.pending.length == 0 || !instance->config.cacheSave)
     {
-        if((searchedValues[i] = queries[i].buffer->length == 0))
-            allSet = false;
+        pthread_mutex_unlock(&cacheFile.pendingMutex);
+        return;
+    }
+
+    //Entries of the current file that weren't recomputed in this run are carried over
+    uint32_t numEntries = cacheFile.pending.length;
+    for(uint32_t i = 0; i < cacheFile.numEntries; i++)
+    {
+        if(ffListFirstIndexComp(&cacheFile.pending, (void*) cacheFile.entries[i].moduleName, pendingHasName) == cacheFile.pending.length)
+            ++numEntries;
+    }
+
+    uint32_t dataOffset = (uint32_t) (sizeof(FFcacheheader) + numEntries * sizeof(FFcacheentry));
+
+    FFstrbuf index;
+    ffStrbufInitA(&index, dataOffset);
+
+    FFstrbuf data;
+    ffStrbufInitA(&data, 1024);
+
+    FFcacheheader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FF_IO_CACHE_MAGIC, sizeof(FF_IO_CACHE_MAGIC));
+    header.formatVersion = FF_IO_CACHE_FORMAT_VERSION;
+    header.numEntries = numEntries;
+    memcpy(header.projectVersion, FASTFETCH_PROJECT_VERSION, strnlen(FASTFETCH_PROJECT_VERSION, sizeof(header.projectVersion) - 1));
+    appendBytes(&index, &header, sizeof(header));
+
+    for(uint32_t i = 0; i < cacheFile.pending.length; i++)
+    {
+        FFcachepending* pending = ffListGet(&cacheFile.pending, i);
+        cacheAppendEntry(&index, &data, dataOffset, pending->moduleName, pending->fingerprint, pending->value.chars, pending->value.length, pending->split.chars, pending->split.length);
+    }
+
+    for(uint32_t i = 0; i < cacheFile.numEntries; i++)
+    {
+        const FFcacheentry* entry = &cacheFile.entries[i];
+        if(ffListFirstIndexComp(&cacheFile.pending, (void*) entry->moduleName, pendingHasName) != cacheFile.pending.length)
+            continue;
+
+        cacheAppendEntry(&index, &data, dataOffset, entry->moduleName, entry->fingerprint, cacheFile.data + entry->valueOffset, entry->valueLength, cacheFile.data + entry->splitOffset, entry->splitLength);
     }
 
-    if(allSet)
+    FFstrbuf path;
+    ffStrbufInitA(&path, 64);
+    ffGetCacheFilePath(instance, FF_IO_CACHE_FILE_NAME, NULL, &path);
+
+    FFstrbuf tempPath;
+    ffStrbufInitCopy(&tempPath, &path);
+    ffStrbufAppendS(&tempPath, ".XXXXXX");
+
+    int fd = mkstemp(tempPath.chars);
+    if(fd != -1)
+    {
+        bool written = ffWriteFDContent(fd, &index) && ffWriteFDContent(fd, &data);
+        close(fd);
+
+        if(!written || rename(tempPath.chars, path.chars) != 0)
+            unlink(tempPath.chars);
+    }
+
+    ffStrbufDestroy(&tempPath);
+    ffStrbufDestroy(&path);
+    ffStrbufDestroy(&data);
+    ffStrbufDestroy(&index);
+
+    pthread_mutex_unlock(&cacheFile.pendingMutex);
+}
+
+//The pending values are allocated from the arena of the instance, so this must be called before it is reset
+void ffCacheRelease()
+{
+    pthread_mutex_lock(&cacheFile.pendingMutex);
+
+    if(cacheFile.data != NULL)
+        munmap((void*) cacheFile.data, cacheFile.size);
+
+    cacheFile.data = NULL;
+    cacheFile.size = 0;
+    cacheFile.entries = NULL;
+    cacheFile.numEntries = 0;
+    cacheFile.pendingInit = false;
+    cacheFile.numFingerprints = 0;
+
+    pthread_mutex_unlock(&cacheFile.pendingMutex);
+}
+
+#define FF_IO_PROP_BUFFER_SIZE 8192
+
+//Reads the file in chunks into a stack buffer and matches each complete line against all queries in a single pass
+static bool parsePropFileValues(const char* filename, uint32_t numQueries, FFpropquery* queries, bool firstOccurrence)
+{
+    uint64_t searched = 0;
+    for(uint32_t i = 0; i < numQueries && i < 64; i++)
     {
-        free(searchedValues);
-        return access(filename, R_OK) == 0;
+        if(queries[i].buffer->length == 0)
+            searched |= (uint64_t) 1 << i;
     }
 
-    FILE* file = fopen(filename, "r");
-    if(file == NULL)
+    if(searched == 0)
+        return ffSysrootAccess(filename, R_OK);
+
+    int fd = ffSysrootOpen(filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
         return false;
 
-    char* line = NULL;
-    size_t len = 0;
+    char buffer[FF_IO_PROP_BUFFER_SIZE];
+    uint32_t length = 0;
+    bool skipLineRest = false; //Set if a line didn't fit into the buffer. Its remainder must not be parsed as a new line
+    bool eof = false;
 
-    while (getline(&line, &len, file) != -1)
+    while(!eof && searched != 0)
     {
-        for(uint32_t i = 0; i < numQueries; i++)
+        ssize_t readed = read(fd, buffer + length, sizeof(buffer) - 1 - length);
+        if(readed < 0 && errno == EINTR)
+            continue;
+
+        if(readed > 0)
+            length += (uint32_t) readed;
+        else
+            eof = true;
+
+        buffer[length] = '\0';
+
+        char* lines = buffer;
+        if(skipLineRest)
         {
-            if(!searchedValues[i])
+            char* newline = memchr(buffer, '\n', length);
+            if(newline == NULL)
+            {
+                length = 0;
                 continue;
+            }
+            lines = newline + 1;
+            skipLineRest = false;
+        }
 
-            uint32_t currentLength = queries[i].buffer->length;
-            queries[i].buffer->length = 0;
-            if(!ffGetPropValue(line, queries[i].start, queries[i].buffer))
-                queries[i].buffer->length = currentLength;
+        //Only complete lines are parsed, unless the file ended or a single line fills the whole buffer.
+        //A partial line after the skipped rest of a long one is kept for the next read like any other
+        char* end = buffer + length;
+        if(!eof)
+        {
+            while(end > lines && *(end - 1) != '\n')
+                --end;
+
+            if(end == lines && lines == buffer && length == sizeof(buffer) - 1)
+            {
+                end = buffer + length;
+                skipLineRest = true;
+            }
         }
+
+        char endChar = *end;
+        *end = '\0';
+        searched = ffGetPropValuesFromLines(lines, numQueries, queries, searched, firstOccurrence);
+        *end = endChar;
+
+        length = (uint32_t) (buffer + length - end);
+        memmove(buffer, end, length);
     }
 
-    free(searchedValues);
+    close(fd);
+    return true;
+}
 
-    if(line != NULL)
-        free(line);
+#undef FF_IO_PROP_BUFFER_SIZE
 
-    fclose(file);
+bool ffParsePropFileValues(const char* filename, uint32_t numQueries, FFpropquery* queries)
+{
+    return parsePropFileValues(filename, numQueries, queries, false);
+}
 
-    return true;
+bool ffParsePropFileValuesFirst(const char* filename, uint32_t numQueries, FFpropquery* queries)
+{
+    return parsePropFileValues(filename, numQueries, queries, true);
 }
 
 bool ffParsePropFile(const char* filename, const char* start, FFstrbuf* buffer)
@@ -421,6 +965,8 @@ void ffWriteFileContent(const char* fileName, const FFstrbuf* content)
 
 void ffAppendFDContent(int fd, FFstrbuf* buffer)
 {
+    ffStrbufEnsureFree(buffer, FASTFETCH_STRBUF_DEFAULT_ALLOC);
+
     ssize_t readed;
     while((readed = read(fd, buffer->chars + buffer->length, buffer->allocated - buffer->length)) == (buffer->allocated - buffer->length))
     {
@@ -439,7 +985,7 @@ void ffAppendFDContent(int fd, FFstrbuf* buffer)
 
 bool ffAppendFileContent(const char* fileName, FFstrbuf* buffer)
 {
-    int fd = open(fileName, O_RDONLY);
+    int fd = ffSysrootOpen(fileName, O_RDONLY | O_CLOEXEC);
     if(fd == -1)
         return false;
 
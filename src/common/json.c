@@ -0,0 +1,125 @@
+#include "fastfetch.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FF_JSON_DOUBLE_PRECISION 15 //Enough to print every double parsed from a decimal of up to 15 digits as it was
+
+void ffJsonAppendString(FFstrbuf* buffer, const char* value)
+{
+    ffStrbufAppendC(buffer, '"');
+
+    //Runs of characters that need no escaping are appended at once
+    const char* start = value;
+    for(; *value != '\0'; ++value)
+    {
+        unsigned char c = (unsigned char) *value;
+        if(c >= ' ' && c != '"' && c != '\\')
+            continue;
+
+        ffStrbufAppendNS(buffer, (uint32_t) (value - start), start);
+        start = value + 1;
+
+        if(c == '"' || c == '\\')
+        {
+            ffStrbufAppendC(buffer, '\\');
+            ffStrbufAppendC(buffer, (char) c);
+        }
+        else
+            ffStrbufAppendF(buffer, "\\u%04x", (unsigned) c);
+    }
+    ffStrbufAppendNS(buffer, (uint32_t) (value - start), start);
+
+    ffStrbufAppendC(buffer, '"');
+}
+
+void ffJsonWriterInit(FFjsonwriter* writer, FFstrbuf* buffer)
+{
+    writer->buffer = buffer;
+    writer->needsComma = false;
+}
+
+static void appendKey(FFjsonwriter* writer, const char* key)
+{
+    if(writer->needsComma)
+        ffStrbufAppendC(writer->buffer, ',');
+    writer->needsComma = true;
+
+    if(key == NULL)
+        return;
+
+    ffJsonAppendString(writer->buffer, key);
+    ffStrbufAppendC(writer->buffer, ':');
+}
+
+void ffJsonBeginObject(FFjsonwriter* writer, const char* key)
+{
+    appendKey(writer, key);
+    ffStrbufAppendC(writer->buffer, '{');
+    writer->needsComma = false;
+}
+
+void ffJsonEndObject(FFjsonwriter* writer)
+{
+    ffStrbufAppendC(writer->buffer, '}');
+    writer->needsComma = true;
+}
+
+void ffJsonBeginArray(FFjsonwriter* writer, const char* key)
+{
+    appendKey(writer, key);
+    ffStrbufAppendC(writer->buffer, '[');
+    writer->needsComma = false;
+}
+
+void ffJsonEndArray(FFjsonwriter* writer)
+{
+    ffStrbufAppendC(writer->buffer, ']');
+    writer->needsComma = true;
+}
+
+void ffJsonString(FFjsonwriter* writer, const char* key, const char* value)
+{
+    appendKey(writer, key);
+    if(value == NULL)
+        ffStrbufAppendS(writer->buffer, "null");
+    else
+        ffJsonAppendString(writer->buffer, value);
+}
+
+void ffJsonStrbuf(FFjsonwriter* writer, const char* key, const FFstrbuf* value)
+{
+    appendKey(writer, key);
+    ffJsonAppendString(writer->buffer, value->chars);
+}
+
+void ffJsonUInt(FFjsonwriter* writer, const char* key, uint64_t value)
+{
+    appendKey(writer, key);
+    ffStrbufAppendUInt(writer->buffer, value);
+}
+
+void ffJsonInt(FFjsonwriter* writer, const char* key, int64_t value)
+{
+    appendKey(writer, key);
+    ffStrbufAppendInt(writer->buffer, value);
+}
+
+void ffJsonDouble(FFjsonwriter* writer, const char* key, double value)
+{
+    appendKey(writer, key);
+
+    //JSON has no inf or nan
+    if(isfinite(value))
+        ffStrbufAppendDouble(writer->buffer, value, FF_JSON_DOUBLE_PRECISION);
+    else
+        ffStrbufAppendS(writer->buffer, "null");
+}
+
+void ffJsonBool(FFjsonwriter* writer, const char* key, bool value)
+{
+    appendKey(writer, key);
+    ffStrbufAppendS(writer->buffer, value ? "true" : "false");
+}
+
+#undef FF_JSON_DOUBLE_PRECISION
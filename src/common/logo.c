@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 static void initLogoUnknown(FFinstance* instance)
 {
@@ -327,7 +328,7 @@ static bool loadLogoSet(FFinstance* instance, const char* logo)
         free(instance->config.logo.lines);
 
     instance->config.logo.freeable = false;
-    instance->config.logo.allLinesSameLength = true;
+    instance->config.logo.compiled = false;
 
     if(logo == NULL || *logo == '\0')
         return false;
@@ -376,7 +377,9 @@ void ffLoadLogoSet(FFinstance* instance, const char* logo)
     FFstrbuf logoChars;
     ffStrbufInitA(&logoChars, 1024);
 
-    if(!ffGetFileContent(logo, &logoChars))
+    //A logo file is given by the user, so it is never looked up in the sysroot
+    int fd = open(logo, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
     {
         ffStrbufDestroy(&logoChars);
         if(instance->config.showErrors)
@@ -385,7 +388,9 @@ void ffLoadLogoSet(FFinstance* instance, const char* logo)
         return;
     }
 
-    instance->config.logo.allLinesSameLength = false;
+    ffAppendFDContent(fd, &logoChars);
+    close(fd);
+
     instance->config.logo.freeable = true;
     instance->config.logo.lines = logoChars.chars;
 }
@@ -402,132 +407,146 @@ void ffLoadLogo(FFinstance* instance)
     ) initLogoUnknown(instance);
 }
 
-static uint32_t strLengthUTF8(const char* str, uint32_t bytesLength)
+//Appends a visible char of the logo, unless it is cut away by a negative offsetx
+static inline void appendLogoChar(FFstrbuf* chars, char c, uint32_t* cut, uint32_t* width)
 {
-    uint32_t length = 0;
-
-    for (uint32_t i = 0; i < bytesLength; ++i)
+    if(*cut > 0)
     {
-        int c = (unsigned char) str[i];
-
-        if((c>=0 && c<=127))        i += 0;
-        else if((c & 0xE0) == 0xC0) i += 1;
-        else if((c & 0xF0) == 0xE0) i += 2;
-        else if((c & 0xF8) == 0xF0) i += 3;
-        else return 0; //invalid utf8
-
-        ++length;
+        --*cut;
+        return;
     }
 
-    return length;
+    ffStrbufAppendC(chars, c);
+
+    //UTF-8 continuation bytes don't take up space
+    if(((unsigned char) c & 0xC0) != 0x80)
+        ++*width;
 }
 
-void ffPrintLogoLine(FFinstance* instance)
+//Returns a pointer to the start of the next line
+static const char* compileLogoLine(FFinstance* instance, const char* line)
 {
-    for(int16_t i = 0; i < instance->config.offsetx; i++)
-        putchar(' ');
+    FFlogoline* compiled = ffListAdd(&instance->config.logo.compiledLines);
+    compiled->offset = instance->config.logo.compiledChars.length;
 
-    if(*instance->config.logo.lines == '\0')
+    //Empty lines get neither colors nor spacing
+    if(*line == '\n')
     {
-        for(uint32_t i = 0; i < instance->state.logoWidth; ++i)
-            putchar(' ');
-        return;
+        compiled->length = 0;
+        return line + 1;
     }
 
-    if(*instance->config.logo.lines == '\n')
-    {
-        ++instance->config.logo.lines;
-        return;
-    }
-
-    const char* start = instance->config.logo.lines;
-    uint32_t colorPlaceholdersLength = 0;
+    FFstrbuf* chars = &instance->config.logo.compiledChars;
 
-    uint32_t cutValue = instance->config.offsetx < 0 ? (uint32_t) (instance->config.offsetx * -1) : 0;
-    uint32_t cut = cutValue;
+    uint32_t cut = instance->config.offsetx < 0 ? (uint32_t) (instance->config.offsetx * -1) : 0;
+    uint32_t width = 0;
 
-    fputs(FASTFETCH_TEXT_MODIFIER_BOLT, stdout);
+    ffStrbufAppendS(chars, FASTFETCH_TEXT_MODIFIER_BOLT);
 
-    while(*instance->config.logo.lines != '\n' && *instance->config.logo.lines != '\0')
+    while(*line != '\n' && *line != '\0')
     {
-        char current = *instance->config.logo.lines;
-        ++instance->config.logo.lines;
+        char current = *line++;
 
         if(current != '$')
         {
-            if(cut > 0) --cut;
-            else putchar(current);
+            appendLogoChar(chars, current, &cut, &width);
             continue;
         }
 
-        current = *instance->config.logo.lines;
-        ++instance->config.logo.lines;
+        current = *line;
 
         if(current == '\n' || current == '\0')
         {
-            if(cut == 0)
-                putchar('$');
+            appendLogoChar(chars, '$', &cut, &width);
             break;
         }
 
+        ++line;
+
         if(current == '$')
         {
-            ++colorPlaceholdersLength;
-            if(cut > 0) --cut;
-            else putchar('$');
+            appendLogoChar(chars, '$', &cut, &width);
             continue;
         }
 
         int index = ((int) current) - 49;
 
-        if(index < 0 || index > 9)
+        if(index < 0 || index >= (int) (sizeof(instance->config.logo.colors) / sizeof(instance->config.logo.colors[0])))
         {
-            if(cut > 0) --cut;
-            else putchar('$');
-
-            if(cut > 0) --cut;
-            else putchar(current);
-
+            appendLogoChar(chars, '$', &cut, &width);
+            appendLogoChar(chars, current, &cut, &width);
             continue;
         }
 
-        colorPlaceholdersLength += 2;
-
-        if(!instance->config.colorLogo)
-            continue;
-
-        fputs(instance->config.logo.colors[index], stdout);
+        if(instance->config.colorLogo)
+            ffStrbufAppendS(chars, instance->config.logo.colors[index]);
     }
 
-    fputs(FASTFETCH_TEXT_MODIFIER_RESET, stdout);
+    ffStrbufAppendS(chars, FASTFETCH_TEXT_MODIFIER_RESET);
 
     const uint32_t logoKeySpacing = cut > instance->config.logoKeySpacing ? 0 : instance->config.logoKeySpacing - cut;
     for(uint32_t i = 0; i < logoKeySpacing; ++i)
-        putchar(' ');
+        ffStrbufAppendC(chars, ' ');
 
-    if(instance->state.logoWidth == 0 || !instance->config.logo.allLinesSameLength)
-    {
-        uint32_t lineLength = strLengthUTF8(start, (uint32_t) (instance->config.logo.lines - start)) - colorPlaceholdersLength + instance->config.logoKeySpacing;
+    compiled->length = chars->length - compiled->offset;
 
-        if(cutValue > lineLength)
-            lineLength = 0;
-        else
-            lineLength -= cutValue;
+    //Whatever is left of the cut, because the line was shorter, eats into the spacing
+    width += instance->config.logoKeySpacing;
+    width = cut > width ? 0 : width - cut;
+    if(instance->state.logoWidth < width)
+        instance->state.logoWidth = width;
 
-        if(instance->state.logoWidth < lineLength)
-            instance->state.logoWidth = lineLength;
+    if(*line == '\n')
+        ++line;
+
+    return line;
+}
+
+//The logo is compiled on first print, when all options that affect it are known.
+//Printing a line is then a single append of the precomputed bytes.
+static void compileLogo(FFinstance* instance)
+{
+    ffStrbufClear(&instance->config.logo.compiledChars);
+    instance->config.logo.compiledLines.length = 0;
+    instance->config.logo.currentLine = 0;
+
+    const char* line = instance->config.logo.lines;
+    while(*line != '\0')
+        line = compileLogoLine(instance, line);
+
+    instance->config.logo.compiled = true;
+}
+
+void ffPrintLogoLine(FFinstance* instance)
+{
+    if(ffOutputCaptureLogoLine())
+        return;
+
+    if(!instance->config.logo.compiled)
+        compileLogo(instance);
+
+    if(instance->config.offsetx > 0)
+        ffOutputAppendNC((uint32_t) instance->config.offsetx, ' ');
+
+    if(instance->config.logo.currentLine == instance->config.logo.compiledLines.length)
+    {
+        ffOutputAppendNC(instance->state.logoWidth, ' ');
+        return;
     }
 
-    if(*instance->config.logo.lines == '\n')
-        ++instance->config.logo.lines;
+    const FFlogoline* line = ffListGet(&instance->config.logo.compiledLines, instance->config.logo.currentLine++);
+    ffOutputAppendNS(line->length, instance->config.logo.compiledChars.chars + line->offset);
 }
 
 void ffPrintRemainingLogo(FFinstance* instance)
 {
-    while(*instance->config.logo.lines != '\0')
+    if(!instance->config.logo.compiled)
+        compileLogo(instance);
+
+    while(instance->config.logo.currentLine < instance->config.logo.compiledLines.length)
     {
         ffPrintLogoLine(instance);
-        putchar('\n');
+        ffOutputAppendC('\n');
     }
 }
 
@@ -557,9 +576,10 @@ void ffPrintLogos(FFinstance* instance)
 {
     #define FF_LOGO_PRINT(name, loadFunction) \
         loadFunction(instance); \
-        printf(FASTFETCH_TEXT_MODIFIER_BOLT"%s" #name FASTFETCH_TEXT_MODIFIER_RESET":\n", instance->config.colorLogo ? instance->config.logo.colors[0] : ""); \
+        instance->config.logo.compiled = false; \
+        ffOutputAppendF(FASTFETCH_TEXT_MODIFIER_BOLT"%s" #name FASTFETCH_TEXT_MODIFIER_RESET":\n", instance->config.colorLogo ? instance->config.logo.colors[0] : ""); \
         ffPrintRemainingLogo(instance); \
-        putchar('\n');
+        ffOutputAppendC('\n');
 
     FF_LOGO_PRINT(unknown, initLogoUnknown)
     FF_LOGO_PRINT(arch, initLogoArch)
@@ -576,6 +596,8 @@ void ffPrintLogos(FFinstance* instance)
     FF_LOGO_PRINT(void, initLogoVoid)
 
     #undef FF_LOGO_PRINT
+
+    ffOutputFlush();
 }
 
 #endif
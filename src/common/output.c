@@ -0,0 +1,229 @@
+#include "fastfetch.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#define FF_OUTPUT_SLOT_DEFAULT_ALLOC 128
+#define FF_OUTPUT_MAX_IOVECS 1024 //IOV_MAX on linux
+
+//Everything printed between ffStart and ffFinish is collected here and written with a single writev.
+//The frame is split into slots, one per module and one for the rest of the logo, which are written in the order they were added.
+static struct
+{
+    FFlist slots; //List of FFstrbuf
+    uint32_t current;
+    bool init;
+} frame;
+
+static void initFrame()
+{
+    ffListInitA(&frame.slots, sizeof(FFstrbuf), 64);
+    ffStrbufInitA(ffListAdd(&frame.slots), FF_OUTPUT_SLOT_DEFAULT_ALLOC);
+    frame.current = 0;
+    frame.init = true;
+}
+
+//A thread that prints into a capture instead of the frame, see ffPrintWithTimeout
+static __thread FFoutputcapture* capture;
+
+static inline FFstrbuf* currentSlot()
+{
+    if(capture != NULL)
+        return &capture->buffer;
+
+    if(!frame.init)
+        initFrame();
+
+    return ffListGet(&frame.slots, frame.current);
+}
+
+void ffOutputAddSlot()
+{
+    if(!frame.init)
+        initFrame();
+
+    ffStrbufInitA(ffListAdd(&frame.slots), FF_OUTPUT_SLOT_DEFAULT_ALLOC);
+    frame.current = frame.slots.length - 1;
+}
+
+void ffOutputAppend(const FFstrbuf* value)
+{
+    ffStrbufAppend(currentSlot(), value);
+}
+
+void ffOutputAppendS(const char* value)
+{
+    ffStrbufAppendS(currentSlot(), value);
+}
+
+void ffOutputAppendNS(uint32_t length, const char* value)
+{
+    FFstrbuf* slot = currentSlot();
+    ffStrbufEnsureFree(slot, length);
+    memcpy(slot->chars + slot->length, value, length);
+    slot->length += length;
+    slot->chars[slot->length] = '\0';
+}
+
+void ffOutputAppendC(char c)
+{
+    ffStrbufAppendC(currentSlot(), c);
+}
+
+void ffOutputAppendNC(uint32_t num, char c)
+{
+    FFstrbuf* slot = currentSlot();
+    ffStrbufEnsureFree(slot, num);
+    memset(slot->chars + slot->length, c, num);
+    slot->length += num;
+    slot->chars[slot->length] = '\0';
+}
+
+void ffOutputAppendUInt(uint64_t value)
+{
+    ffStrbufAppendUInt(currentSlot(), value);
+}
+
+void ffOutputAppendInt(int64_t value)
+{
+    ffStrbufAppendInt(currentSlot(), value);
+}
+
+void ffOutputAppendF(const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    ffStrbufAppendVF(currentSlot(), format, arguments);
+    va_end(arguments);
+}
+
+void ffOutputPut(const FFstrbuf* value)
+{
+    FFstrbuf* slot = currentSlot();
+    ffStrbufAppend(slot, value);
+    ffStrbufAppendC(slot, '\n');
+}
+
+void ffOutputPutS(const char* value)
+{
+    FFstrbuf* slot = currentSlot();
+    ffStrbufAppendS(slot, value);
+    ffStrbufAppendC(slot, '\n');
+}
+
+void ffOutputCaptureBegin(FFoutputcapture* target)
+{
+    ffStrbufInitA(&target->buffer, FF_OUTPUT_SLOT_DEFAULT_ALLOC);
+    ffListInitA(&target->logoLines, sizeof(uint32_t), 2);
+    capture = target;
+}
+
+void ffOutputCaptureEnd()
+{
+    capture = NULL;
+}
+
+//Logo lines must be printed in output order, so a capture only remembers where they go
+bool ffOutputCaptureLogoLine()
+{
+    if(capture == NULL)
+        return false;
+
+    *(uint32_t*) ffListAdd(&capture->logoLines) = capture->buffer.length;
+    return true;
+}
+
+void ffOutputAppendCapture(FFinstance* instance, const FFoutputcapture* source)
+{
+    uint32_t start = 0;
+    for(uint32_t i = 0; i < source->logoLines.length; ++i)
+    {
+        uint32_t offset = *(uint32_t*) ffListGet(&source->logoLines, i);
+        ffOutputAppendNS(offset - start, source->buffer.chars + start);
+        ffPrintLogoLine(instance);
+        start = offset;
+    }
+    ffOutputAppendNS(source->buffer.length - start, source->buffer.chars + start);
+}
+
+void ffOutputCaptureDestroy(FFoutputcapture* target)
+{
+    ffStrbufDestroy(&target->buffer);
+    ffListDestroy(&target->logoLines);
+}
+
+static bool writevAll(struct iovec* iov, int iovcnt)
+{
+    while(iovcnt > 0)
+    {
+        ssize_t written = writev(STDOUT_FILENO, iov, iovcnt < FF_OUTPUT_MAX_IOVECS ? iovcnt : FF_OUTPUT_MAX_IOVECS);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written < 0)
+            return false;
+
+        //Skip what was written, a partial write can end in the middle of a buffer
+        while(iovcnt > 0 && (size_t) written >= iov->iov_len)
+        {
+            written -= (ssize_t) iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + written;
+            iov->iov_len -= (size_t) written;
+        }
+    }
+
+    return true;
+}
+
+void ffOutputFlush()
+{
+    if(!frame.init)
+        return;
+
+    //Whatever went through stdio directly, must come before the frame
+    fflush(stdout);
+
+    struct iovec* iov = malloc(sizeof(struct iovec) * frame.slots.length);
+    int iovcnt = 0;
+
+    for(uint32_t i = 0; i < frame.slots.length; ++i)
+    {
+        FFstrbuf* slot = ffListGet(&frame.slots, i);
+        if(slot->length == 0)
+            continue;
+
+        iov[iovcnt].iov_base = slot->chars;
+        iov[iovcnt].iov_len = slot->length;
+        ++iovcnt;
+    }
+
+    writevAll(iov, iovcnt);
+    free(iov);
+
+    for(uint32_t i = 0; i < frame.slots.length; ++i)
+        ffStrbufDestroy(ffListGet(&frame.slots, i));
+    ffListDestroy(&frame.slots);
+    frame.init = false;
+}
+
+//Writes the buffer right away, without going through the frame
+void ffOutputWrite(const FFstrbuf* buffer)
+{
+    fflush(stdout);
+
+    struct iovec iov = {
+        .iov_base = buffer->chars,
+        .iov_len = buffer->length
+    };
+    writevAll(&iov, 1);
+}
+
+#undef FF_OUTPUT_SLOT_DEFAULT_ALLOC
+#undef FF_OUTPUT_MAX_IOVECS
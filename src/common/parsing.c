@@ -369,6 +369,50 @@ bool ffGetPropValueFromLines(const char* lines, const char* start, FFstrbuf* buf
     return true;
 }
 
+uint64_t ffGetPropValuesFromLines(const char* lines, uint32_t numQueries, FFpropquery* queries, uint64_t searched, bool firstOccurrence)
+{
+    if(numQueries > 64)
+        numQueries = 64;
+
+    while(*lines != '\0' && searched != 0)
+    {
+        const char* first = lines;
+        while(*first == ' ' || *first == '\t')
+            ++first;
+
+        for(uint32_t i = 0; i < numQueries; ++i)
+        {
+            if(!(searched & ((uint64_t) 1 << i)))
+                continue;
+
+            //Cheap reject on the first char, before doing the whitespace aware comparison
+            const char* start = queries[i].start;
+            while(*start == ' ' || *start == '\t')
+                ++start;
+            if(*start != *first)
+                continue;
+
+            FFstrbuf* buffer = queries[i].buffer;
+            uint32_t currentLength = buffer->length;
+            buffer->length = 0;
+
+            const char* line = lines;
+            if(!getPropValueLine(&line, queries[i].start, buffer))
+                buffer->length = currentLength;
+            else if(firstOccurrence)
+                searched &= ~((uint64_t) 1 << i);
+        }
+
+        while(*lines != '\0' && *lines != '\n')
+            ++lines;
+
+        if(*lines == '\n')
+            ++lines;
+    }
+
+    return searched;
+}
+
 void ffParseSemver(FFstrbuf* buffer, const FFstrbuf* major, const FFstrbuf* minor, const FFstrbuf* patch)
 {
     if(major->length > 0)
@@ -0,0 +1,362 @@
+#include "fastfetch.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//pci.ids is a text file of more than 1MB, which would have to be parsed for every lookup.
+//It is converted once into an index in the cache dir: a header, the vendors and the devices sorted by id, and their names.
+//The index is only read through a read-only mapping, so a lookup only touches the pages it needs.
+
+#define FF_PCIIDS_INDEX_NAME "pciids.ffc"
+#define FF_PCIIDS_MAGIC "FFPCIID"
+#define FF_PCIIDS_FORMAT_VERSION 1
+
+typedef struct FFpciidsheader
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t numVendors;
+    uint32_t numDevices;
+    uint32_t namesSize;
+    uint64_t fingerprint; //Of the pci.ids the index was built from
+} FFpciidsheader;
+
+typedef struct FFpciidsentry
+{
+    uint32_t id; //The vendor id, shifted left by 16 and ORed with the device id for devices
+    uint32_t name; //Offset into the names
+} FFpciidsentry;
+
+static const char* pciidsPaths[] = {
+    "/usr/share/hwdata/pci.ids",
+    "/usr/share/misc/pci.ids",
+    "/usr/share/pci.ids",
+    "/var/lib/pciutils/pci.ids"
+};
+
+static int openSource(FFinstance* instance, const char** path)
+{
+    if(instance->config.pciIds.length > 0)
+    {
+        *path = instance->config.pciIds.chars;
+        return ffSysrootOpen(*path, O_RDONLY | O_CLOEXEC);
+    }
+
+    for(uint32_t i = 0; i < sizeof(pciidsPaths) / sizeof(pciidsPaths[0]); i++)
+    {
+        int fd = ffSysrootOpen(pciidsPaths[i], O_RDONLY | O_CLOEXEC);
+        if(fd != -1)
+        {
+            *path = pciidsPaths[i];
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+static uint64_t sourceFingerprint(const char* path, const struct stat* st)
+{
+    uint64_t values[5] = {
+        (uint64_t) st->st_dev,
+        (uint64_t) st->st_ino,
+        (uint64_t) st->st_size,
+        (uint64_t) st->st_mtim.tv_sec,
+        (uint64_t) st->st_mtim.tv_nsec
+    };
+
+    uint64_t hash = ffCacheFingerprintAppend(FF_CACHE_FINGERPRINT_INIT, path, strlen(path) + 1);
+    return ffCacheFingerprintAppend(hash, values, sizeof(values));
+}
+
+static bool indexValid(const char* data, size_t size, uint64_t fingerprint)
+{
+    if(size < sizeof(FFpciidsheader))
+        return false;
+
+    const FFpciidsheader* header = (const FFpciidsheader*) data;
+    return
+        memcmp(header->magic, FF_PCIIDS_MAGIC, sizeof(FF_PCIIDS_MAGIC)) == 0 &&
+        header->formatVersion == FF_PCIIDS_FORMAT_VERSION &&
+        header->fingerprint == fingerprint &&
+        sizeof(FFpciidsheader) + ((size_t) header->numVendors + header->numDevices) * sizeof(FFpciidsentry) + header->namesSize == size &&
+        (header->namesSize == 0 || data[size - 1] == '\0');
+}
+
+static bool mapIndex(FFinstance* instance, FFpciids* ids, uint64_t fingerprint)
+{
+    FFstrbuf path;
+    ffStrbufInitA(&path, 64);
+    ffGetCacheFilePath(instance, FF_PCIIDS_INDEX_NAME, NULL, &path);
+    int fd = open(path.chars, O_RDONLY | O_CLOEXEC);
+    ffStrbufDestroy(&path);
+
+    if(fd == -1)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FFpciidsheader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //The mapping stays valid
+    if(data == MAP_FAILED)
+        return false;
+
+    if(!indexValid(data, (size_t) st.st_size, fingerprint))
+    {
+        munmap(data, (size_t) st.st_size);
+        return false;
+    }
+
+    ids->data = data;
+    ids->size = (size_t) st.st_size;
+    ids->mapped = true;
+    return true;
+}
+
+static inline bool isHex4(const char* line, const char* end)
+{
+    if(end - line < 4)
+        return false;
+
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        char c = line[i];
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            return false;
+    }
+    return true;
+}
+
+static void addEntry(FFlist* entries, FFstrbuf* names, uint32_t id, const char* name, const char* end)
+{
+    while(name < end && (*name == ' ' || *name == '\t'))
+        ++name;
+    while(end > name && (end[-1] == '\r' || end[-1] == ' '))
+        --end;
+
+    FFpciidsentry* entry = ffListAdd(entries);
+    entry->id = id;
+    entry->name = names->length;
+    ffStrbufAppendNS(names, (uint32_t) (end - name), name);
+    ffStrbufAppendC(names, '\0');
+}
+
+//Vendors start at the beginning of a line, their devices are indented by one tab and subsystems by two.
+//The device classes at the end of the file are not needed
+static void parseSource(const char* data, size_t size, FFlist* vendors, FFlist* devices, FFstrbuf* names)
+{
+    const char* line = data;
+    const char* dataEnd = data + size;
+    uint32_t vendor = 0;
+    bool hasVendor = false;
+
+    while(line < dataEnd)
+    {
+        const char* end = memchr(line, '\n', (size_t) (dataEnd - line));
+        if(end == NULL)
+            end = dataEnd;
+
+        if(line[0] == 'C' && end - line > 1 && line[1] == ' ')
+            break;
+
+        if(isHex4(line, end))
+        {
+            vendor = (uint32_t) strtoul(line, NULL, 16);
+            hasVendor = true;
+            addEntry(vendors, names, vendor, line + 4, end);
+        }
+        else if(hasVendor && line[0] == '\t' && isHex4(line + 1, end))
+            addEntry(devices, names, (vendor << 16) | (uint32_t) strtoul(line + 1, NULL, 16), line + 5, end);
+
+        line = end + 1;
+    }
+}
+
+static int compareEntries(const void* a, const void* b)
+{
+    uint32_t left = ((const FFpciidsentry*) a)->id;
+    uint32_t right = ((const FFpciidsentry*) b)->id;
+    return left < right ? -1 : left > right;
+}
+
+static void buildIndex(FFpciids* ids, int sourceFD, size_t sourceSize, uint64_t fingerprint)
+{
+    FFlist vendors;
+    ffListInitA(&vendors, sizeof(FFpciidsentry), 4096);
+    FFlist devices;
+    ffListInitA(&devices, sizeof(FFpciidsentry), 65536);
+    FFstrbuf names;
+    ffStrbufInitA(&names, (uint32_t) sourceSize);
+
+    void* source = sourceSize == 0 ? MAP_FAILED : mmap(NULL, sourceSize, PROT_READ, MAP_PRIVATE, sourceFD, 0);
+    if(source != MAP_FAILED)
+    {
+        parseSource(source, sourceSize, &vendors, &devices, &names);
+        munmap(source, sourceSize);
+    }
+
+    //pci.ids is sorted, but that is only a convention
+    qsort(vendors.data, vendors.length, sizeof(FFpciidsentry), compareEntries);
+    qsort(devices.data, devices.length, sizeof(FFpciidsentry), compareEntries);
+
+    FFpciidsheader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FF_PCIIDS_MAGIC, sizeof(FF_PCIIDS_MAGIC));
+    header.formatVersion = FF_PCIIDS_FORMAT_VERSION;
+    header.numVendors = vendors.length;
+    header.numDevices = devices.length;
+    header.namesSize = names.length;
+    header.fingerprint = fingerprint;
+
+    uint32_t vendorsSize = vendors.length * (uint32_t) sizeof(FFpciidsentry);
+    uint32_t devicesSize = devices.length * (uint32_t) sizeof(FFpciidsentry);
+
+    //FFstrbuf functions stop at '\0', so the parts are copied directly
+    ffStrbufInitA(&ids->built, (uint32_t) sizeof(header) + vendorsSize + devicesSize + names.length + 1);
+    char* data = ids->built.chars;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), vendors.data, vendorsSize);
+    memcpy(data + sizeof(header) + vendorsSize, devices.data, devicesSize);
+    memcpy(data + sizeof(header) + vendorsSize + devicesSize, names.chars, names.length);
+    ids->built.length = (uint32_t) sizeof(header) + vendorsSize + devicesSize + names.length;
+    ids->built.chars[ids->built.length] = '\0';
+
+    ids->data = ids->built.chars;
+    ids->size = ids->built.length;
+
+    ffStrbufDestroy(&names);
+    ffListDestroy(&devices);
+    ffListDestroy(&vendors);
+}
+
+//Replaced as a whole via rename, like the cache, so concurrent runs never map a half written index
+static void writeIndex(FFinstance* instance, const FFstrbuf* index)
+{
+    FFstrbuf path;
+    ffStrbufInitA(&path, 64);
+    ffGetCacheFilePath(instance, FF_PCIIDS_INDEX_NAME, NULL, &path);
+
+    FFstrbuf tempPath;
+    ffStrbufInitCopy(&tempPath, &path);
+    ffStrbufAppendS(&tempPath, ".XXXXXX");
+
+    int fd = mkstemp(tempPath.chars);
+    if(fd != -1)
+    {
+        bool written = ffWriteFDContent(fd, index);
+        close(fd);
+
+        if(!written || rename(tempPath.chars, path.chars) != 0)
+            unlink(tempPath.chars);
+    }
+
+    ffStrbufDestroy(&tempPath);
+    ffStrbufDestroy(&path);
+}
+
+//Of the pci.ids ffPciidsOpen would use, for the cache of the GPU module. FF_CACHE_FINGERPRINT_INIT if there is none
+uint64_t ffPciidsFingerprint(FFinstance* instance)
+{
+    const char* path;
+    int fd = openSource(instance, &path);
+    if(fd == -1)
+        return FF_CACHE_FINGERPRINT_INIT;
+
+    struct stat st;
+    uint64_t fingerprint = fstat(fd, &st) == 0 ? sourceFingerprint(path, &st) : FF_CACHE_FINGERPRINT_INIT;
+
+    close(fd);
+    return fingerprint;
+}
+
+//ids->data is NULL afterwards if there is no pci.ids
+void ffPciidsOpen(FFinstance* instance, FFpciids* ids)
+{
+    ids->data = NULL;
+    ids->size = 0;
+    ids->mapped = false;
+    ffStrbufInit(&ids->built);
+
+    const char* path;
+    int fd = openSource(instance, &path);
+    if(fd == -1)
+        return;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    FF_TRACE_BEGIN(traceBegin);
+
+    uint64_t fingerprint = sourceFingerprint(path, &st);
+
+    if(instance->config.recache || !mapIndex(instance, ids, fingerprint))
+    {
+        buildIndex(ids, fd, (size_t) st.st_size, fingerprint);
+
+        if(instance->config.cacheSave)
+            writeIndex(instance, &ids->built);
+    }
+
+    close(fd);
+
+    FF_TRACE_END(traceBegin, "cache", "pci.ids");
+}
+
+static const char* findName(const FFpciids* ids, const FFpciidsentry* entries, uint32_t numEntries, uint32_t id)
+{
+    const FFpciidsheader* header = (const FFpciidsheader*) ids->data;
+
+    const FFpciidsentry* entry = bsearch(&(FFpciidsentry) {.id = id}, entries, numEntries, sizeof(FFpciidsentry), compareEntries);
+    if(entry == NULL || entry->name >= header->namesSize)
+        return NULL;
+
+    const char* names = ids->data + ids->size - header->namesSize;
+    return names + entry->name;
+}
+
+//NULL if it isn't known
+const char* ffPciidsGetVendor(const FFpciids* ids, uint16_t vendor)
+{
+    if(ids->data == NULL)
+        return NULL;
+
+    const FFpciidsheader* header = (const FFpciidsheader*) ids->data;
+    const FFpciidsentry* vendors = (const FFpciidsentry*) (ids->data + sizeof(FFpciidsheader));
+    return findName(ids, vendors, header->numVendors, vendor);
+}
+
+//NULL if it isn't known
+const char* ffPciidsGetDevice(const FFpciids* ids, uint16_t vendor, uint16_t device)
+{
+    if(ids->data == NULL)
+        return NULL;
+
+    const FFpciidsheader* header = (const FFpciidsheader*) ids->data;
+    const FFpciidsentry* devices = (const FFpciidsentry*) (ids->data + sizeof(FFpciidsheader)) + header->numVendors;
+    return findName(ids, devices, header->numDevices, ((uint32_t) vendor << 16) | device);
+}
+
+void ffPciidsClose(FFpciids* ids)
+{
+    if(ids->mapped)
+        munmap((void*) ids->data, ids->size);
+    ffStrbufDestroy(&ids->built);
+    ids->data = NULL;
+}
+
+#undef FF_PCIIDS_FORMAT_VERSION
+#undef FF_PCIIDS_MAGIC
+#undef FF_PCIIDS_INDEX_NAME
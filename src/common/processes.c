@@ -0,0 +1,202 @@
+#define _GNU_SOURCE //O_DIRECTORY
+
+#include "fastfetch.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define FF_PROCESSES_DENTS_SIZE (64 * 1024)
+
+//The layout the getdents64 syscall writes, glibc only declares it since 2.30
+typedef struct FFlinuxdirent
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} FFlinuxdirent;
+
+static FFlist* readyTable; //Set once the snapshot is complete
+static uint32_t readyGeneration; //Of the arena readyTable lives in, an older one was released
+
+//stat: pid (comm) state ppid ...
+static bool parseStat(const char* stat, FFprocessentry* entry)
+{
+    const char* commStart = strchr(stat, '(');
+    const char* commEnd = strrchr(stat, ')'); //comm itself can contain ')'
+    if(commStart == NULL || commEnd == NULL || commEnd < commStart)
+        return false;
+
+    uint32_t commLength = (uint32_t) (commEnd - commStart - 1);
+    if(commLength >= sizeof(entry->comm))
+        commLength = sizeof(entry->comm) - 1;
+    memcpy(entry->comm, commStart + 1, commLength);
+    entry->comm[commLength] = '\0';
+
+    int ppid;
+    if(sscanf(commEnd + 1, " %*c %d", &ppid) != 1)
+        return false;
+
+    entry->ppid = (pid_t) ppid;
+    return true;
+}
+
+//dirfd is either /proc, or AT_FDCWD with an absolute path
+static bool readStat(int dirfd, const char* path, pid_t pid, FFprocessentry* entry)
+{
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+
+    //comm is at most 15 chars, so ppid is always in the first few bytes
+    char stat[128];
+    ssize_t length = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+
+    if(length <= 0)
+        return false;
+    stat[length] = '\0';
+
+    entry->pid = pid;
+    return parseStat(stat, entry);
+}
+
+static bool parsePid(const char* name, pid_t* pid)
+{
+    if(*name < '0' || *name > '9')
+        return false;
+
+    *pid = 0;
+    for(; *name != '\0'; ++name)
+    {
+        if(*name < '0' || *name > '9')
+            return false;
+        *pid = *pid * 10 + (*name - '0');
+    }
+
+    return true;
+}
+
+//With 20k+ processes on shared hosts, most of them belong to other users.
+//Those are skipped by the owner of their /proc directory, before anything is read from them.
+static void scanProcDir(FFlist* entries)
+{
+    int procfd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(procfd == -1)
+        return;
+
+    uid_t uid = geteuid();
+    char* dents = malloc(FF_PROCESSES_DENTS_SIZE);
+    char path[32];
+
+    long length;
+    while((length = syscall(SYS_getdents64, procfd, dents, FF_PROCESSES_DENTS_SIZE)) > 0)
+    {
+        for(long offset = 0; offset < length;)
+        {
+            const FFlinuxdirent* dirent = (const FFlinuxdirent*) (dents + offset);
+            offset += dirent->d_reclen;
+
+            pid_t pid;
+            if(dirent->d_type != DT_DIR || !parsePid(dirent->d_name, &pid))
+                continue;
+
+            struct stat fileStat;
+            if(fstatat(procfd, dirent->d_name, &fileStat, 0) != 0 || fileStat.st_uid != uid)
+                continue;
+
+            snprintf(path, sizeof(path), "%s/stat", dirent->d_name);
+            FFprocessentry* entry = ffListAdd(entries);
+            if(!readStat(procfd, path, pid, entry))
+                --entries->length; //The process exited in between
+        }
+    }
+
+    free(dents);
+    close(procfd);
+}
+
+static int compareEntries(const void* a, const void* b)
+{
+    pid_t left = ((const FFprocessentry*) a)->pid;
+    pid_t right = ((const FFprocessentry*) b)->pid;
+    return left < right ? -1 : left > right;
+}
+
+const FFlist* ffProcessTableGet(FFinstance* instance)
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFlist* table;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &table, sizeof(*table), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return table;
+    }
+    FF_TRACE_BEGIN(traceBegin);
+
+    ffListInitA(table, sizeof(FFprocessentry), 256);
+    scanProcDir(table);
+    qsort(table->data, table->length, table->elementSize, compareEntries);
+    __atomic_store_n(&readyGeneration, generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&readyTable, table, __ATOMIC_RELEASE);
+
+    FF_TRACE_END(traceBegin, "detect", "ProcessTable");
+    pthread_mutex_unlock(&mutex);
+    return table;
+}
+
+//Walking the parent chain only visits a few processes, so this doesn't force the scan, but uses it if it's already there.
+//Parents of other users (sudo, login) are never in the snapshot and are read directly.
+bool ffProcessTableFind(FFinstance* instance, pid_t pid, FFprocessentry* entry)
+{
+    const FFlist* snapshot = __atomic_load_n(&readyTable, __ATOMIC_ACQUIRE);
+    if(snapshot != NULL && __atomic_load_n(&readyGeneration, __ATOMIC_RELAXED) == instance->arena.generation)
+    {
+        FFprocessentry key = { .pid = pid };
+        const FFprocessentry* found = bsearch(&key, snapshot->data, snapshot->length, snapshot->elementSize, compareEntries);
+        if(found != NULL)
+        {
+            *entry = *found;
+            return true;
+        }
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    return readStat(AT_FDCWD, path, pid, entry);
+}
+
+//The name of the executable, for processes whose comm is truncated. Keeps name if there is no command line (kernel threads)
+void ffProcessGetCmdlineName(pid_t pid, FFstrbuf* name)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int) pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return;
+
+    //Only argv[0] is needed, so huge command lines (looking at you chrome) aren't read completely
+    char cmdline[512];
+    ssize_t length = read(fd, cmdline, sizeof(cmdline) - 1);
+    close(fd);
+
+    if(length <= 0)
+        return;
+    cmdline[length] = '\0'; //Arguments are separated by '\0', so this is argv[0]
+
+    const char* exeName = strrchr(cmdline, '/');
+    exeName = exeName == NULL ? cmdline : exeName + 1;
+    if(*exeName != '\0')
+        ffStrbufSetS(name, exeName);
+}
+
+#undef FF_PROCESSES_DENTS_SIZE
@@ -1,34 +1,312 @@
+#define _GNU_SOURCE //pipe2
+
 #include "fastfetch.h"
 
-#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
 #include <sys/wait.h>
 
-void ffProcessAppendStdOut(FFstrbuf* buffer, char* const argv[])
+#define FF_PROCESS_READ_SIZE 4096
+
+extern char** environ;
+
+typedef struct FFprocess
 {
-    int pipes[2];
+    pid_t pid;
+    int fd; //Read end of the stdout pipe, -1 once it reached EOF
+    FFstrbuf* buffer;
+    uint64_t deadline; //CLOCK_MONOTONIC in ms
+    uint64_t traceBegin;
+    char name[32]; //For tracing, argv doesn't need to outlive the spawn
+    uint32_t outputStart; //The buffer may already contain something, which must not be cached
+    bool killed;
+    char cacheName[32]; //Empty if the output is not cached
+    uint64_t cacheFingerprint;
+} FFprocess;
 
-    if(pipe(pipes) == -1)
-        return;
+static uint64_t getTimeMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+void ffProcessGroupInit(FFprocessgroup* group, FFinstance* cacheInstance)
+{
+    ffListInitA(&group->processes, sizeof(FFprocess), 2);
+    group->cacheInstance = cacheInstance;
+}
 
-    pid_t childPid = fork();
-    if(childPid == -1)
+//Searches PATH like posix_spawnp does. path is empty if nothing was found
+void ffProcessResolveExecutable(const char* name, FFstrbuf* path)
+{
+    if(strchr(name, '/') != NULL)
+    {
+        ffStrbufSetS(path, name);
         return;
+    }
+
+    const char* paths = getenv("PATH");
+    if(paths == NULL)
+        paths = "/usr/local/bin:/usr/bin:/bin";
 
-    if(childPid == 0)
+    while(*paths != '\0')
     {
-        dup2(pipes[1], STDOUT_FILENO);
-        close(pipes[0]);
-        close(pipes[1]);
-        close(STDERR_FILENO);
-        execvp(argv[0], argv);
-        exit(901);
+        const char* end = strchr(paths, ':');
+        uint32_t length = end == NULL ? (uint32_t) strlen(paths) : (uint32_t) (end - paths);
+
+        ffStrbufClear(path);
+        ffStrbufAppendNS(path, length, paths);
+        ffStrbufAppendC(path, '/');
+        ffStrbufAppendS(path, name);
+
+        if(access(path->chars, X_OK) == 0)
+            return;
+
+        paths += length;
+        if(*paths == ':')
+            ++paths;
     }
-    else
+
+    ffStrbufClear(path);
+}
+
+//The output of a command only changes with its arguments and the executable whose output it is.
+//That is argv[0], unless a wrapper like env runs it, in which case the caller names it.
+static void getCacheKey(char* const argv[], const char* executable, char name[32], uint64_t* fingerprint)
+{
+    uint64_t argvHash = FF_CACHE_FINGERPRINT_INIT;
+    for(char* const* arg = argv; *arg != NULL; ++arg)
+        argvHash = ffCacheFingerprintAppend(argvHash, *arg, strlen(*arg) + 1);
+    snprintf(name, 32, "Process%016llx", (unsigned long long) argvHash);
+
+    FFstrbuf path;
+    ffStrbufInit(&path);
+    ffProcessResolveExecutable(executable == NULL ? argv[0] : executable, &path);
+    *fingerprint = ffCacheFingerprintAppendStat(FF_CACHE_FINGERPRINT_INIT, path.chars);
+    ffStrbufDestroy(&path);
+}
+
+//posix_spawn uses vfork semantics, so unlike fork this doesn't copy the page tables of the whole process and is safe with other threads running.
+//The pipe is created with O_CLOEXEC, so processes spawned at the same time by other threads don't inherit it and keep it open.
+bool ffProcessGroupSpawn(FFprocessgroup* group, FFstrbuf* buffer, char* const argv[], const char* executable, uint32_t timeoutMs)
+{
+    FF_TRACE_BEGIN(traceBegin);
+
+    char cacheName[32] = "";
+    uint64_t cacheFingerprint = 0;
+    if(group->cacheInstance != NULL)
+    {
+        getCacheKey(argv, executable, cacheName, &cacheFingerprint);
+        if(ffCacheGetValueFingerprinted(group->cacheInstance, cacheName, cacheFingerprint, buffer))
+        {
+            FF_TRACE_END(traceBegin, "cache", argv[0]);
+            return true;
+        }
+    }
+
+    int pipes[2];
+    if(pipe2(pipes, O_CLOEXEC) == -1)
+        return false;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipes[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipes[1]);
+
+    if(error != 0)
     {
-        close(pipes[1]);
-        waitpid(childPid, NULL, 0);
-        ffAppendFDContent(pipes[0], buffer);
         close(pipes[0]);
+        return false;
+    }
+
+    FFprocess* process = ffListAdd(&group->processes);
+    process->pid = pid;
+    process->fd = pipes[0];
+    process->buffer = buffer;
+    process->deadline = getTimeMs() + timeoutMs;
+    process->traceBegin = traceBegin;
+    strncpy(process->name, argv[0], sizeof(process->name) - 1);
+    process->name[sizeof(process->name) - 1] = '\0';
+    process->outputStart = buffer->length;
+    process->killed = false;
+    memcpy(process->cacheName, cacheName, sizeof(process->cacheName));
+    process->cacheFingerprint = cacheFingerprint;
+    return true;
+}
+
+//Returns false on EOF or error
+static bool readProcessOutput(FFprocess* process)
+{
+    ffStrbufEnsureFree(process->buffer, FF_PROCESS_READ_SIZE);
+
+    ssize_t readed = read(process->fd, process->buffer->chars + process->buffer->length, FF_PROCESS_READ_SIZE);
+    if(readed < 0 && errno == EINTR)
+        return true;
+    if(readed <= 0)
+        return false;
+
+    process->buffer->length += (uint32_t) readed;
+    process->buffer->chars[process->buffer->length] = '\0';
+    return true;
+}
+
+//Returns false if the process is still running at its deadline
+static bool waitProcessExit(FFprocess* process)
+{
+    if(waitpid(process->pid, NULL, WNOHANG) != 0)
+        return true;
+
+    //Readable once the process exited
+    int pidfd = (int) syscall(SYS_pidfd_open, process->pid, 0);
+    if(pidfd != -1)
+    {
+        while(true)
+        {
+            uint64_t now = getTimeMs();
+            if(now >= process->deadline)
+                break;
+
+            int ready = poll(&(struct pollfd) {pidfd, POLLIN, 0}, 1, (int) (process->deadline - now));
+            if(ready > 0 || (ready < 0 && errno != EINTR))
+                break;
+        }
+
+        close(pidfd);
+        return waitpid(process->pid, NULL, WNOHANG) != 0;
+    }
+
+    //Kernels before 5.3 have no pidfd
+    while(waitpid(process->pid, NULL, WNOHANG) == 0)
+    {
+        if(getTimeMs() >= process->deadline)
+            return false;
+
+        nanosleep(&(struct timespec){0, 100000}, NULL);
     }
+
+    return true;
 }
+
+//Drains the pipes of all processes at once, so none can block on a full pipe, while waiting for the others.
+//Processes that are still running at their deadline are killed, with whatever they wrote until then kept.
+void ffProcessGroupWait(FFprocessgroup* group)
+{
+    struct pollfd* pollfds = malloc(sizeof(struct pollfd) * (group->processes.length + 1));
+    FFprocess** polled = malloc(sizeof(FFprocess*) * (group->processes.length + 1));
+
+    while(true)
+    {
+        uint64_t now = getTimeMs();
+        uint64_t nextDeadline = UINT64_MAX;
+        nfds_t numPolled = 0;
+
+        for(uint32_t i = 0; i < group->processes.length; i++)
+        {
+            FFprocess* process = ffListGet(&group->processes, i);
+            if(process->fd == -1)
+                continue;
+
+            if(process->deadline <= now)
+            {
+                kill(process->pid, SIGKILL);
+                close(process->fd);
+                process->fd = -1;
+                process->killed = true;
+                continue;
+            }
+
+            if(process->deadline < nextDeadline)
+                nextDeadline = process->deadline;
+
+            pollfds[numPolled].fd = process->fd;
+            pollfds[numPolled].events = POLLIN;
+            polled[numPolled] = process;
+            ++numPolled;
+        }
+
+        if(numPolled == 0)
+            break;
+
+        int ready = poll(pollfds, numPolled, (int) (nextDeadline - now));
+        if(ready < 0 && errno != EINTR)
+            break;
+
+        for(nfds_t i = 0; ready > 0 && i < numPolled; i++)
+        {
+            if(pollfds[i].revents == 0 || readProcessOutput(polled[i]))
+                continue;
+
+            close(polled[i]->fd);
+            polled[i]->fd = -1;
+        }
+    }
+
+    for(uint32_t i = 0; i < group->processes.length; i++)
+    {
+        FFprocess* process = ffListGet(&group->processes, i);
+
+        //Only if polling failed
+        if(process->fd != -1)
+        {
+            kill(process->pid, SIGKILL);
+            close(process->fd);
+            process->killed = true;
+        }
+
+        //A child can close its stdout and keep running, so its deadline still applies
+        if(!waitProcessExit(process))
+        {
+            kill(process->pid, SIGKILL);
+            waitpid(process->pid, NULL, 0);
+            process->killed = true;
+        }
+
+        //Output of a command that was killed may be incomplete
+        if(process->cacheName[0] != '\0' && !process->killed)
+        {
+            FFstrbuf output;
+            ffStrbufInitA(&output, process->buffer->length - process->outputStart + 1);
+            ffStrbufAppendNS(&output, process->buffer->length - process->outputStart, process->buffer->chars + process->outputStart);
+            ffCacheSetValueFingerprinted(group->cacheInstance, process->cacheName, process->cacheFingerprint, &output);
+            ffStrbufDestroy(&output);
+        }
+
+        FF_TRACE_END(process->traceBegin, "process", process->name);
+    }
+
+    free(polled);
+    free(pollfds);
+    ffListDestroy(&group->processes);
+}
+
+void ffProcessAppendStdOut(FFstrbuf* buffer, char* const argv[])
+{
+    FFprocessgroup group;
+    ffProcessGroupInit(&group, NULL);
+    ffProcessGroupSpawn(&group, buffer, argv, NULL, FF_PROCESS_DEFAULT_TIMEOUT_MS);
+    ffProcessGroupWait(&group);
+}
+
+void ffProcessAppendStdOutCached(FFinstance* instance, FFstrbuf* buffer, char* const argv[])
+{
+    FFprocessgroup group;
+    ffProcessGroupInit(&group, instance);
+    ffProcessGroupSpawn(&group, buffer, argv, NULL, FF_PROCESS_DEFAULT_TIMEOUT_MS);
+    ffProcessGroupWait(&group);
+}
+
+#undef FF_PROCESS_READ_SIZE
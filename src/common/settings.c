@@ -9,7 +9,7 @@ typedef void* DynamicLibrary;
 
 #define FF_VARIANT_NULL ((FFvariant){.strValue = NULL})
 
-#define FF_LIBRARY_LOAD(libraryNameUser, libraryNameDefault, mutex, returnValue) dlopen(libraryNameUser.length == 0 ? libraryNameDefault : libraryNameUser.chars, RTLD_LAZY); \
+#define FF_LIBRARY_LOAD(libraryNameUser, libraryNameDefault, mutex, returnValue) ffTraceDlopen(libraryNameUser.length == 0 ? libraryNameDefault : libraryNameUser.chars, RTLD_LAZY); \
     if(dlerror() != NULL) { \
         pthread_mutex_unlock(&mutex); \
         return returnValue; \
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE //O_PATH
+
+#include "fastfetch.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+
+//Absolute paths of detectors are opened relative to this directory, so a container image or chroot can be inspected without entering it.
+//There is one per process, batch mode forks a process per root.
+static int rootfd = -1;
+static char* rootPath;
+static bool noOpenat2; //The kernel is older than 5.6 or a seccomp filter doesn't know the syscall, which container runtimes answer with ENOSYS or EPERM
+
+bool ffSysrootSet(const char* path)
+{
+    int fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+
+    if(rootfd != -1)
+        close(rootfd);
+    rootfd = fd;
+
+    free(rootPath);
+    rootPath = strdup(path);
+
+    //"/" is appended by ffSysrootAppendPath. The root of the host keeps its one
+    size_t length = strlen(rootPath);
+    while(length > 1 && rootPath[length - 1] == '/')
+        rootPath[--length] = '\0';
+
+    return true;
+}
+
+//NULL if there is none
+const char* ffSysrootGet()
+{
+    return rootPath;
+}
+
+//Relative paths are always opened relative to the working directory.
+//Files in /proc describe the running kernel and its processes, not a tree, so they are always the ones of the host
+int ffSysrootOpen(const char* path, int flags)
+{
+    if(rootfd == -1 || *path != '/' || strncmp(path, "/proc/", 6) == 0)
+        return open(path, flags);
+
+    //Absolute symlinks of the tree, like /etc/os-release on most distros, must be resolved inside of it and not on the host
+    if(!noOpenat2)
+    {
+        struct open_how how = {
+            .flags = (__u64) flags,
+            .resolve = RESOLVE_IN_ROOT
+        };
+
+        int fd = (int) syscall(SYS_openat2, rootfd, path, &how, sizeof(how));
+        if(fd != -1 || (errno != ENOSYS && errno != EPERM))
+            return fd;
+
+        noOpenat2 = true;
+    }
+
+    //Absolute symlinks point to the host here, which is the best that can be done without openat2
+    while(*path == '/')
+        ++path;
+    return openat(rootfd, *path == '\0' ? "." : path, flags);
+}
+
+DIR* ffSysrootOpenDir(const char* path)
+{
+    int fd = ffSysrootOpen(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1)
+        return NULL;
+
+    DIR* dir = fdopendir(fd);
+    if(dir == NULL)
+        close(fd);
+    return dir;
+}
+
+FILE* ffSysrootOpenFile(const char* path)
+{
+    int fd = ffSysrootOpen(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return NULL;
+
+    FILE* file = fdopen(fd, "r");
+    if(file == NULL)
+        close(fd);
+    return file;
+}
+
+//Supports F_OK and R_OK
+bool ffSysrootAccess(const char* path, int mode)
+{
+    if(rootfd == -1)
+        return access(path, mode) == 0;
+
+    int fd = ffSysrootOpen(path, (mode == F_OK ? O_PATH : O_RDONLY) | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+
+    close(fd);
+    return true;
+}
+
+int ffSysrootStatvfs(const char* path, struct statvfs* fs)
+{
+    if(rootfd == -1)
+        return statvfs(path, fs);
+
+    int fd = ffSysrootOpen(path, O_PATH | O_CLOEXEC);
+    if(fd == -1)
+        return -1;
+
+    int ret = fstatvfs(fd, fs);
+    close(fd);
+    return ret;
+}
+
+//For libraries that only take a path. Unlike ffSysrootOpen, absolute symlinks of the tree point to the host
+void ffSysrootAppendPath(FFstrbuf* buffer, const char* path)
+{
+    if(rootPath != NULL && *path == '/' && strcmp(rootPath, "/") != 0)
+        ffStrbufAppendS(buffer, rootPath);
+    ffStrbufAppendS(buffer, path);
+}
@@ -1,75 +1,491 @@
 #include "fastfetch.h"
 
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <pthread.h>
 
-static inline void* detectPlasmaThreadMain(void* instance)
+#define FF_THREADING_MAX_WORKERS 4
+
+typedef enum FFtaskstate
 {
-    ffDetectPlasma((FFinstance*)instance);
-    return NULL;
+    FF_TASK_STATE_PENDING,
+    FF_TASK_STATE_RUNNING,
+    FF_TASK_STATE_DONE
+} FFtaskstate;
+
+typedef struct FFtask
+{
+    FFtaskfunc func;
+    uint64_t dependencies; //Bitmask of task ids that must be done before this one can start
+    FFtaskstate state;
+} FFtask;
+
+//There is only one scheduler per process, like all the other detection state
+static struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond; //Signaled whenever a task is added or finished
+    FFinstance* instance;
+    FFtask tasks[FF_TASK_MAX];
+    uint32_t numTasks;
+    uint64_t doneMask;
+    pthread_t workers[FF_THREADING_MAX_WORKERS];
+    uint32_t numWorkers;
+    bool shutdown;
+    bool printTimedOut; //A worker may be stuck in the same call the print waited for
+} scheduler = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+static inline bool isTaskReady(const FFtask* task)
+{
+    return task->state == FF_TASK_STATE_PENDING && (task->dependencies & ~scheduler.doneMask) == 0;
 }
 
-static inline void* detectGTK2ThreadMain(void* instance)
+//Must be called with the scheduler mutex locked. Unlocks it while the task runs.
+static void runTask(uint32_t id)
 {
-    ffDetectGTK2((FFinstance*)instance);
-    return NULL;
+    FFtask* task = &scheduler.tasks[id];
+    task->state = FF_TASK_STATE_RUNNING;
+    pthread_mutex_unlock(&scheduler.mutex);
+
+    task->func(scheduler.instance);
+
+    pthread_mutex_lock(&scheduler.mutex);
+    task->state = FF_TASK_STATE_DONE;
+    scheduler.doneMask |= (uint64_t) 1 << id;
+    pthread_cond_broadcast(&scheduler.cond);
 }
 
-static inline void* detectGTK3ThreadMain(void* instance)
+static void* workerThreadMain(void* arg)
 {
-    ffDetectGTK3((FFinstance*)instance);
+    UNUSED(arg);
+
+    pthread_mutex_lock(&scheduler.mutex);
+
+    while(!scheduler.shutdown)
+    {
+        uint32_t id = 0;
+        while(id < scheduler.numTasks && !isTaskReady(&scheduler.tasks[id]))
+            ++id;
+
+        if(id == scheduler.numTasks)
+            pthread_cond_wait(&scheduler.cond, &scheduler.mutex);
+        else
+            runTask(id);
+    }
+
+    pthread_mutex_unlock(&scheduler.mutex);
     return NULL;
 }
 
-static inline void* detectGTK4ThreadMain(void* instance)
+//Must be called with the scheduler mutex locked.
+static void waitTask(uint32_t id)
 {
-    ffDetectGTK4((FFinstance*)instance);
-    return NULL;
+    FFtask* task = &scheduler.tasks[id];
+
+    //Resolve dependencies first, so we can run the task ourself if no worker picked it up yet
+    for(uint32_t dep = 0; dep < scheduler.numTasks; ++dep)
+    {
+        if(task->dependencies & ((uint64_t) 1 << dep))
+            waitTask(dep);
+    }
+
+    if(task->state == FF_TASK_STATE_PENDING)
+        runTask(id);
+
+    while(task->state != FF_TASK_STATE_DONE)
+        pthread_cond_wait(&scheduler.cond, &scheduler.mutex);
 }
 
-static inline void* detectWMDEThreadMain(void* instance)
+uint32_t ffTaskAdd(FFtaskfunc func, uint64_t dependencies)
 {
-    ffDetectWMDE((FFinstance*)instance);
-    return NULL;
+    pthread_mutex_lock(&scheduler.mutex);
+
+    //Multiple modules share the same detection, it only needs to run once
+    for(uint32_t id = 0; id < scheduler.numTasks; ++id)
+    {
+        if(scheduler.tasks[id].func == func)
+        {
+            pthread_mutex_unlock(&scheduler.mutex);
+            return id;
+        }
+    }
+
+    if(scheduler.numTasks == FF_TASK_MAX)
+    {
+        pthread_mutex_unlock(&scheduler.mutex);
+        return FF_TASK_INVALID;
+    }
+
+    uint32_t id = scheduler.numTasks++;
+    scheduler.tasks[id] = (FFtask) {
+        .func = func,
+        .dependencies = dependencies,
+        .state = FF_TASK_STATE_PENDING
+    };
+
+    pthread_cond_broadcast(&scheduler.cond);
+    pthread_mutex_unlock(&scheduler.mutex);
+    return id;
 }
 
-static inline void* detectTerminalShellThreadMain(void* instance)
+void ffTaskWait(uint32_t id)
 {
-    ffDetectTerminalShell((FFinstance*)instance);
-    return NULL;
+    if(id >= FF_TASK_MAX)
+        return;
+
+    pthread_mutex_lock(&scheduler.mutex);
+    if(id < scheduler.numTasks)
+        waitTask(id);
+    pthread_mutex_unlock(&scheduler.mutex);
 }
 
-static inline void* startThreadsThreadMain(void* instance)
+typedef struct FFtimedprint
 {
-    pthread_t wmdeThread;
-    pthread_create(&wmdeThread, NULL, detectWMDEThreadMain, instance);
-    pthread_detach(wmdeThread);
+    FFinstance* instance;
+    FFtaskfunc print;
+    FFoutputcapture capture;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool done;
+    bool abandoned; //Set when the printing thread stopped waiting. The print thread frees the job then
+} FFtimedprint;
 
-    pthread_t gtk2Thread;
-    pthread_create(&gtk2Thread, NULL, detectGTK2ThreadMain, instance);
-    pthread_detach(gtk2Thread);
+static void destroyTimedPrint(FFtimedprint* job)
+{
+    ffOutputCaptureDestroy(&job->capture);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+    free(job);
+}
 
-    pthread_t gtk3Thread;
-    pthread_create(&gtk3Thread, NULL, detectGTK3ThreadMain, instance);
-    pthread_detach(gtk3Thread);
+static void* timedPrintThreadMain(void* arg)
+{
+    FFtimedprint* job = arg;
 
-    pthread_t gtk4Thread;
-    pthread_create(&gtk4Thread, NULL, detectGTK4ThreadMain, instance);
-    pthread_detach(gtk4Thread);
+    ffOutputCaptureBegin(&job->capture);
+    job->print(job->instance);
+    ffOutputCaptureEnd();
 
-    pthread_t terminalShellThread;
-    pthread_create(&terminalShellThread, NULL, detectTerminalShellThreadMain, instance);
-    pthread_detach(terminalShellThread);
+    pthread_mutex_lock(&job->mutex);
+    job->done = true;
+    bool abandoned = job->abandoned;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
 
-    pthread_t plasmaThread;
-    pthread_create(&plasmaThread, NULL, detectPlasmaThreadMain, instance);
-    pthread_detach(plasmaThread);
+    if(abandoned)
+        destroyTimedPrint(job);
 
     return NULL;
 }
 
+//Runs the print function on its own thread and waits at most timeoutMs for it. Its output is captured and only appended if it finished in time.
+//A print that overran can't be cancelled (it is usually stuck in a blocking library call), so it keeps running detached and its output is dropped.
+bool ffPrintWithTimeout(FFinstance* instance, FFtaskfunc print, uint32_t timeoutMs)
+{
+    FFtimedprint* job = malloc(sizeof(FFtimedprint));
+    job->instance = instance;
+    job->print = print;
+    job->done = false;
+    job->abandoned = false;
+    pthread_mutex_init(&job->mutex, NULL);
+
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job->cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, timedPrintThreadMain, job) != 0)
+    {
+        //Printing without a deadline is still better than not printing at all
+        pthread_cond_destroy(&job->cond);
+        pthread_mutex_destroy(&job->mutex);
+        free(job);
+        print(instance);
+        return true;
+    }
+    pthread_detach(thread);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000)
+    {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    while(!job->done && pthread_cond_timedwait(&job->cond, &job->mutex, &deadline) != ETIMEDOUT);
+    bool done = job->done;
+    job->abandoned = !done;
+    pthread_mutex_unlock(&job->mutex);
+
+    if(!done)
+    {
+        pthread_mutex_lock(&scheduler.mutex);
+        scheduler.printTimedOut = true;
+        pthread_mutex_unlock(&scheduler.mutex);
+        return false;
+    }
+
+    ffOutputAppendCapture(instance, &job->capture);
+    destroyTimedPrint(job);
+    return true;
+}
+
+static void detectTitle(FFinstance* instance)
+{
+    ffDetectTitle(instance);
+}
+
+static void detectOS(FFinstance* instance)
+{
+    ffDetectOS(instance);
+}
+
+static void detectHost(FFinstance* instance)
+{
+    ffDetectHost(instance);
+}
+
+static void detectPackages(FFinstance* instance)
+{
+    ffDetectPackages(instance);
+}
+
+static void detectWMDE(FFinstance* instance)
+{
+    ffDetectWMDE(instance);
+}
+
+static void detectTerminalShell(FFinstance* instance)
+{
+    ffDetectTerminalShell(instance);
+}
+
+static void detectResolution(FFinstance* instance)
+{
+    ffDetectResolution(instance);
+}
+
+static void detectGTK2(FFinstance* instance)
+{
+    ffDetectGTK2(instance);
+}
+
+static void detectGTK3(FFinstance* instance)
+{
+    ffDetectGTK3(instance);
+}
+
+static void detectGTK4(FFinstance* instance)
+{
+    ffDetectGTK4(instance);
+}
+
+static void detectPlasma(FFinstance* instance)
+{
+    ffDetectPlasma(instance);
+}
+
+static void detectCPU(FFinstance* instance)
+{
+    ffDetectCPU(instance);
+}
+
+static void detectGPU(FFinstance* instance)
+{
+    ffDetectGPU(instance);
+}
+
+static void detectMemory(FFinstance* instance)
+{
+    ffDetectMemory(instance);
+}
+
+static void detectDisk(FFinstance* instance)
+{
+    ffDetectDisk(instance);
+}
+
+static void detectBattery(FFinstance* instance)
+{
+    ffDetectBattery(instance);
+}
+
+static void detectLocale(FFinstance* instance)
+{
+    ffDetectLocale(instance);
+}
+
+typedef struct FFprefetch
+{
+    const char* moduleName;
+    FFtaskfunc func;
+    const char* cacheName; //If set, the detection is skipped when the module will be printed from cache
+    bool needsWMDE;
+} FFprefetch;
+
+//Ordered like the default structure, so workers pick up tasks roughly in print order
+static const FFprefetch prefetches[] = {
+    {"title", detectTitle, NULL, false},
+    {"os", detectOS, "OS", false},
+    {"host", detectHost, "Host", false},
+    {"packages", detectPackages, NULL, false},
+    {"shell", detectTerminalShell, NULL, true},
+    {"resolution", detectResolution, NULL, false},
+    {"desktopenvironment", detectWMDE, NULL, false},
+    {"de", detectWMDE, NULL, false},
+    {"windowmanager", detectWMDE, NULL, false},
+    {"wm", detectWMDE, NULL, false},
+    {"wmtheme", detectWMDE, NULL, false},
+    {"theme", detectGTK2, NULL, true},
+    {"theme", detectGTK3, NULL, true},
+    {"theme", detectGTK4, NULL, true},
+    {"theme", detectPlasma, NULL, true},
+    {"icons", detectGTK2, NULL, true},
+    {"icons", detectGTK3, NULL, true},
+    {"icons", detectGTK4, NULL, true},
+    {"icons", detectPlasma, NULL, true},
+    {"font", detectGTK2, NULL, true},
+    {"font", detectGTK3, NULL, true},
+    {"font", detectGTK4, NULL, true},
+    {"font", detectPlasma, NULL, true},
+    {"cursor", detectGTK2, NULL, true},
+    {"cursor", detectGTK3, NULL, true},
+    {"cursor", detectGTK4, NULL, true},
+    {"terminal", detectTerminalShell, NULL, true},
+    {"terminalfont", detectTerminalShell, NULL, true},
+    {"cpu", detectCPU, "CPU", false},
+    {"gpu", detectGPU, "GPU", false},
+    {"memory", detectMemory, NULL, false},
+    {"disk", detectDisk, NULL, false},
+    {"battery", detectBattery, NULL, false},
+    {"locale", detectLocale, "Locale", false}
+};
+
+#define FF_PREFETCHES_COUNT (sizeof(prefetches) / sizeof(prefetches[0]))
+
+//The task of every prefetch of the current run, FF_TASK_INVALID if it wasn't added
+static uint32_t prefetchTasks[FF_PREFETCHES_COUNT];
+
+static inline bool isPrefetchOf(const FFprefetch* prefetch, const char* moduleName, uint32_t moduleNameLength)
+{
+    return strlen(prefetch->moduleName) == moduleNameLength && strncasecmp(prefetch->moduleName, moduleName, moduleNameLength) == 0;
+}
+
+static void prefetchModule(FFinstance* instance, const char* moduleName, uint32_t moduleNameLength)
+{
+    for(uint32_t i = 0; i < FF_PREFETCHES_COUNT; ++i)
+    {
+        const FFprefetch* prefetch = &prefetches[i];
+
+        if(!isPrefetchOf(prefetch, moduleName, moduleNameLength))
+            continue;
+
+        if(prefetch->cacheName != NULL && ffCacheExists(instance, prefetch->cacheName))
+            continue;
+
+        uint64_t dependencies = 0;
+        if(prefetch->needsWMDE)
+        {
+            //GTK (dconf), Plasma and the terminal font all need to know the DE, so they wait for it instead of racing for its mutex
+            uint32_t wmde = ffTaskAdd(detectWMDE, 0);
+            if(wmde != FF_TASK_INVALID)
+                dependencies |= (uint64_t) 1 << wmde;
+        }
+
+        prefetchTasks[i] = ffTaskAdd(prefetch->func, dependencies);
+    }
+}
+
+void ffPrefetchStructure(FFinstance* instance, const char* structure)
+{
+    for(uint32_t i = 0; i < FF_PREFETCHES_COUNT; ++i)
+        prefetchTasks[i] = FF_TASK_INVALID;
+
+    while(*structure != '\0')
+    {
+        const char* colon = strchr(structure, ':');
+        uint32_t length = colon == NULL ? (uint32_t) strlen(structure) : (uint32_t) (colon - structure);
+
+        prefetchModule(instance, structure, length);
+
+        structure += length;
+        if(*structure == ':')
+            ++structure;
+    }
+}
+
+//Waits for the detections prefetched for the module. Ones that no worker started yet are run by the calling thread
+void ffPrefetchWait(const char* moduleName)
+{
+    uint32_t moduleNameLength = (uint32_t) strlen(moduleName);
+
+    for(uint32_t i = 0; i < FF_PREFETCHES_COUNT; ++i)
+    {
+        if(prefetchTasks[i] != FF_TASK_INVALID && isPrefetchOf(&prefetches[i], moduleName, moduleNameLength))
+            ffTaskWait(prefetchTasks[i]);
+    }
+}
+
 void ffStartDetectionThreads(FFinstance* instance)
 {
-    pthread_t startThreadsThread;
-    pthread_create(&startThreadsThread, NULL, startThreadsThreadMain, instance);
-    pthread_detach(startThreadsThread);
+    scheduler.instance = instance;
+
+    //The main thread prints and runs not yet started tasks itself when it needs them, so more workers than cores only add contention
+    uint32_t numWorkers = (uint32_t) get_nprocs();
+    if(numWorkers < 1)
+        numWorkers = 1;
+    else if(numWorkers > FF_THREADING_MAX_WORKERS)
+        numWorkers = FF_THREADING_MAX_WORKERS;
+
+    pthread_mutex_lock(&scheduler.mutex);
+
+    //Tasks of an earlier run of this process are done
+    scheduler.numTasks = 0;
+    scheduler.doneMask = 0;
+    scheduler.shutdown = false;
+    scheduler.printTimedOut = false;
+
+    for(uint32_t i = 0; i < numWorkers; ++i)
+    {
+        if(pthread_create(&scheduler.workers[scheduler.numWorkers], NULL, workerThreadMain, NULL) == 0)
+            ++scheduler.numWorkers;
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
 }
+
+//Returns false if workers may still be running
+bool ffFinishDetectionThreads(FFinstance* instance)
+{
+    UNUSED(instance);
+
+    pthread_mutex_lock(&scheduler.mutex);
+    scheduler.shutdown = true;
+    bool join = !scheduler.printTimedOut;
+    pthread_cond_broadcast(&scheduler.cond);
+    pthread_mutex_unlock(&scheduler.mutex);
+
+    //Tasks that are still pending are not needed anymore. Running ones are finished by their worker.
+    //After a timeout, waiting for them could hang just like the print did, so they are left to the exit of the process
+    for(uint32_t i = 0; join && i < scheduler.numWorkers; ++i)
+        pthread_join(scheduler.workers[i], NULL);
+
+    scheduler.numWorkers = 0;
+
+    for(uint32_t i = 0; i < FF_PREFETCHES_COUNT; ++i)
+        prefetchTasks[i] = FF_TASK_INVALID;
+
+    return join;
+}
+
+#undef FF_PREFETCHES_COUNT
+#undef FF_THREADING_MAX_WORKERS
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE //gettid via syscall
+
+#include "fastfetch.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define FF_TRACE_EVENTS_PER_BUFFER 256
+#define FF_TRACE_NAME_LENGTH 48
+
+typedef struct FFtraceevent
+{
+    const char* category; //Always a literal
+    char name[FF_TRACE_NAME_LENGTH]; //Copied, names like process arguments don't live long enough
+    uint64_t begin;
+    uint64_t end;
+} FFtraceevent;
+
+//Every thread writes only into its own buffers, so recording needs no lock.
+//New buffers are pushed onto a global list. An event is published by the release store of the length after it,
+//so the list can be read while a worker whose print timed out is still recording.
+typedef struct FFtracebuffer
+{
+    struct FFtracebuffer* next;
+    pid_t tid;
+    uint32_t length;
+    FFtraceevent events[FF_TRACE_EVENTS_PER_BUFFER];
+} FFtracebuffer;
+
+bool ffTraceEnabled = false;
+
+static uint64_t traceStart;
+static FFtracebuffer* buffers;
+static __thread FFtracebuffer* threadBuffer;
+
+uint64_t ffTraceNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+void ffTraceEnable()
+{
+    traceStart = ffTraceNow();
+    ffTraceEnabled = true;
+}
+
+static FFtracebuffer* addBuffer()
+{
+    FFtracebuffer* buffer = malloc(sizeof(FFtracebuffer));
+    buffer->tid = (pid_t) syscall(SYS_gettid);
+    buffer->length = 0;
+
+    buffer->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&buffers, &buffer->next, buffer, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return buffer;
+}
+
+void ffTraceRecord(const char* category, const char* name, uint64_t begin)
+{
+    uint64_t end = ffTraceNow();
+
+    if(threadBuffer == NULL || threadBuffer->length == FF_TRACE_EVENTS_PER_BUFFER)
+        threadBuffer = addBuffer();
+
+    FFtraceevent* event = &threadBuffer->events[threadBuffer->length];
+    event->category = category;
+    strncpy(event->name, name, sizeof(event->name) - 1);
+    event->name[sizeof(event->name) - 1] = '\0';
+    event->begin = begin;
+    event->end = end;
+
+    __atomic_store_n(&threadBuffer->length, threadBuffer->length + 1, __ATOMIC_RELEASE);
+}
+
+void* ffTraceDlopen(const char* fileName, int mode)
+{
+    FF_TRACE_BEGIN(traceBegin);
+    void* library = dlopen(fileName, mode);
+    FF_TRACE_END(traceBegin, "dlopen", fileName);
+    return library;
+}
+
+typedef struct FFtraceentry
+{
+    pid_t tid;
+    const FFtraceevent* event;
+} FFtraceentry;
+
+static int compareEntries(const void* a, const void* b)
+{
+    const FFtraceevent* left = ((const FFtraceentry*) a)->event;
+    const FFtraceevent* right = ((const FFtraceentry*) b)->event;
+    return left->begin < right->begin ? -1 : left->begin > right->begin;
+}
+
+//Trace Event Format, loadable by Perfetto and chrome://tracing. Timestamps are in microseconds
+static void writeTraceFile(const char* fileName, const FFlist* entries)
+{
+    FFstrbuf content;
+    ffStrbufInitA(&content, 128 * entries->length + 64);
+    ffStrbufAppendS(&content, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    pid_t pid = getpid();
+
+    for(uint32_t i = 0; i < entries->length; i++)
+    {
+        const FFtraceentry* entry = ffListGet(entries, i);
+
+        ffStrbufAppendS(&content, "{\"name\":");
+        ffJsonAppendString(&content, entry->event->name);
+        ffStrbufAppendF(&content, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}%s\n",
+            entry->event->category,
+            (double) (entry->event->begin - traceStart) / 1000.0,
+            (double) (entry->event->end - entry->event->begin) / 1000.0,
+            (int) pid,
+            (int) entry->tid,
+            i + 1 < entries->length ? "," : ""
+        );
+    }
+
+    ffStrbufAppendS(&content, "]}\n");
+
+    //Unlike ffWriteFileContent, an older and longer trace must be truncated
+    int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fd == -1 || !ffWriteFDContent(fd, &content))
+        fprintf(stderr, "Error: couldn't write trace file: %s\n", fileName);
+    if(fd != -1)
+        close(fd);
+
+    ffStrbufDestroy(&content);
+}
+
+static void printStatTable(const FFlist* entries)
+{
+    fprintf(stderr, "%-8s %-8s %-32s %10s %10s\n", "Thread", "Type", "Name", "Start(ms)", "Time(ms)");
+
+    for(uint32_t i = 0; i < entries->length; i++)
+    {
+        const FFtraceentry* entry = ffListGet(entries, i);
+        fprintf(stderr, "%-8d %-8s %-32s %10.3f %10.3f\n",
+            (int) entry->tid,
+            entry->event->category,
+            entry->event->name,
+            (double) (entry->event->begin - traceStart) / 1000000.0,
+            (double) (entry->event->end - entry->event->begin) / 1000000.0
+        );
+    }
+}
+
+//Threads that were not joined, because a print timed out, only contribute the events they recorded until now
+void ffTraceFlush(FFinstance* instance)
+{
+    if(!ffTraceEnabled)
+        return;
+
+    FFlist entries;
+    ffListInitA(&entries, sizeof(FFtraceentry), 64);
+
+    for(FFtracebuffer* buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); buffer != NULL; buffer = buffer->next)
+    {
+        uint32_t length = __atomic_load_n(&buffer->length, __ATOMIC_ACQUIRE);
+        for(uint32_t i = 0; i < length; i++)
+        {
+            FFtraceentry* entry = ffListAdd(&entries);
+            entry->tid = buffer->tid;
+            entry->event = &buffer->events[i];
+        }
+    }
+
+    qsort(entries.data, entries.length, entries.elementSize, compareEntries);
+
+    if(instance->config.stat)
+        printStatTable(&entries);
+
+    if(instance->config.traceFile.length > 0)
+        writeTraceFile(instance->config.traceFile.chars, &entries);
+
+    ffListDestroy(&entries);
+}
+
+#undef FF_TRACE_NAME_LENGTH
+#undef FF_TRACE_EVENTS_PER_BUFFER
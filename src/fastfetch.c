@@ -1,3 +1,5 @@
+#define _GNU_SOURCE //accept4, struct ucred
+
 #include "fastfetch.h"
 #include "util/FFvaluestore.h"
 
@@ -7,8 +9,16 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <dirent.h>
-
-#define FASTFETCH_DEFAULT_STRUCTURE "Title:Separator:OS:Host:Kernel:Uptime:Packages:Shell:Resolution:DE:WM:WMTheme:Theme:Icons:Font:Cursor:Terminal:TerminalFont:CPU:GPU:Memory:Disk:Battery:Locale:Break:Colors"
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <dlfcn.h>
 
 #define FASTFETCH_DEFAULT_CONFIG \
     "# Fastfetch configuration\n" \
@@ -26,9 +36,22 @@ typedef struct FFdata
     FFvaluestore valuestore;
     FFstrbuf structure;
     FFstrbuf logoName;
+    FFstrbuf sysroot;
+    FFstrbuf sysrootBatch; //File with a list of sysroots, "-" for stdin
     bool multithreading;
+    bool daemon;
+    uint32_t timeoutMs; //For all modules together, 0 for none
+    uint64_t deadline; //CLOCK_MONOTONIC in ms, set from timeoutMs when the run starts
+    uint32_t watchMs; //Interval of --watch, 0 for a single fetch
+    FFlist moduleTimeouts; //FFmoduletimeout
 } FFdata;
 
+typedef struct FFmoduletimeout
+{
+    void(*print)(FFinstance* instance);
+    uint32_t timeoutMs;
+} FFmoduletimeout;
+
 static inline void printHelp()
 {
     puts(
@@ -61,6 +84,17 @@ static inline void printHelp()
         "                --allow-slow-operations <?value>: Allow operations that are usually very slow for more detailed output\n"
         "                --disable-linewrap <?value>:      Disable linewrap during the run\n"
         "                --hide-cursor <?value>:           Hide the cursor during the run\n"
+        "                --daemon <?value>:                Stay in the background and serve fetches for --client. Options given here are the defaults for every client\n"
+        "                --client:                         Must be the first option. Let a running daemon do the fetch, fall back to a normal run if none is running\n"
+        "                --stat <?value>:                  Print how long every detection, module, library load and command took to stderr\n"
+        "                --trace-file <file>:              Write the timings of --stat as Trace Event Format JSON, which can be opened in Perfetto\n"
+        "                --timeout-ms <ms>:                The time all modules together may take. Modules that are still detecting after it show the last cached value or a placeholder\n"
+        "                --<module>-timeout <ms>:          The time a single module may take, e.g. --resolution-timeout 100\n"
+        "                --timeout-placeholder <str>:      The value shown for modules that timed out and have nothing cached. Default is \"Timed out\"\n"
+        "                --sysroot <dir>:                  Read the files of the system, like /etc/os-release or /var/lib/dpkg/status, from a container image or chroot instead. Disables the cache\n"
+        "                --sysroot-batch <file>:           Fetch every sysroot listed in the file (one per line, - for stdin) in parallel. The results are printed in the order of the list, each after a header naming its sysroot\n"
+        "                --watch <ms>:                     Stay running and redraw the lines of Memory, Uptime, Battery, CPU and Disk that changed every <ms>. Only for text printed to a terminal that is high enough for all of it\n"
+        "                --format <text|json|ndjson>:      Print the detection results of the modules as one JSON object, or one object per module and line, instead of logo and keys. Timeouts only apply to text\n"
         "\n"
         "Logo options:\n"
         "   -l <name>, --logo <name>:         sets the shown logo. Also changes the main color accordingly. This will also load file contents as logo if the given argument is a path\n"
@@ -115,7 +149,6 @@ static inline void printHelp()
         "   --locale-key <key>\n"
         "\n"
         "Library optins: Set the path of a library to load\n"
-        "   --lib-PCI <path>\n"
         "   --lib-X11 <path>\n"
         "   --lib-Xrandr <path>\n"
         "   --lib-gio <path>\n"
@@ -127,8 +160,9 @@ static inline void printHelp()
         "Module specific options:\n"
         "   --disk-folders <folders>: A colon separated list of folder paths for the disk output. Default is \"/:/home\"\n"
         "   --battery-dir <folder>:   The directory where the battery folders are. Standard: /sys/class/power_supply/\n"
+        "   --pci-ids <file>:         The pci.ids file GPU names are looked up in. Standard: the first of /usr/share/hwdata/pci.ids, /usr/share/misc/pci.ids, /usr/share/pci.ids and /var/lib/pciutils/pci.ids\n"
         "\n"
-        "Parsing is not case sensitive. E.g. \"--lib-PCI\" is equal to \"--Lib-Pci\"\n"
+        "Parsing is not case sensitive. E.g. \"--lib-X11\" is equal to \"--Lib-x11\"\n"
         "If a value starts with a ?, it is optional. \"true\" will be used if not set.\n"
         "A (+) at the end indicates that more help can be printed with --help <option>\n"
         "All options can be made permanent in $XDG_CONFIG_HOME/fastfetch/config.conf"
@@ -476,40 +510,135 @@ static inline void printCommandHelp(const char* command)
         fprintf(stderr, "No specific help for command %s provided\n", command);
 }
 
+//Case insensitive lookup of the option and module tables, so dispatch costs the same no matter how many entries there are.
+//The index is built on first use, it only stores positions into the table.
+#define FF_NAME_INDEX_SIZE 256 //Power of two, at least twice the number of entries of the biggest table
+
+typedef struct FFnameindex
+{
+    uint16_t slots[FF_NAME_INDEX_SIZE]; //position + 1, 0 means empty
+    bool init;
+} FFnameindex;
+
+static uint32_t hashNameIgnCase(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for(; *name != '\0'; ++name)
+    {
+        char c = *name;
+        if(c >= 'A' && c <= 'Z')
+            c = (char) (c + ('a' - 'A'));
+        hash = (hash ^ (uint8_t) c) * 16777619u;
+    }
+    return hash;
+}
+
+//Every table entry must start with its name
+#define FF_NAME_AT(table, stride, i) (*(const char* const*) ((const char*) (table) + (size_t) (i) * (stride)))
+
+static uint32_t nameIndexFind(FFnameindex* index, const void* table, size_t stride, uint32_t count, const char* name)
+{
+    if(!index->init)
+    {
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t slot = hashNameIgnCase(FF_NAME_AT(table, stride, i)) & (FF_NAME_INDEX_SIZE - 1);
+            while(index->slots[slot] != 0)
+                slot = (slot + 1) & (FF_NAME_INDEX_SIZE - 1);
+            index->slots[slot] = (uint16_t) (i + 1);
+        }
+        index->init = true;
+    }
+
+    uint32_t slot = hashNameIgnCase(name) & (FF_NAME_INDEX_SIZE - 1);
+    while(index->slots[slot] != 0)
+    {
+        uint32_t i = index->slots[slot] - 1u;
+        if(strcasecmp(FF_NAME_AT(table, stride, i), name) == 0)
+            return i;
+        slot = (slot + 1) & (FF_NAME_INDEX_SIZE - 1);
+    }
+
+    return count;
+}
+
+#undef FF_NAME_AT
+#undef FF_NAME_INDEX_SIZE
+
+typedef struct FFmodule
+{
+    const char* name;
+    void(*print)(FFinstance* instance);
+    void(*json)(FFinstance* instance, FFjsonwriter* writer); //NULL for modules without detection results
+    bool listed; //Aliases are not shown by --print-available-modules
+    const char* keyName; //The key printed when the module timed out. NULL for modules that never time out
+    size_t keyOffset; //Of its custom key FFstrbuf in FFconfig
+} FFmodule;
+
+#define FF_MODULE(name, print, json, keyName, key) {name, print, json, true, keyName, offsetof(FFconfig, key)}
+#define FF_MODULE_ALIAS(name, print, json, keyName, key) {name, print, json, false, keyName, offsetof(FFconfig, key)}
+#define FF_MODULE_UNTIMED(name, print, json) {name, print, json, true, NULL, 0}
+
+static const FFmodule modules[] = {
+    FF_MODULE("Battery", ffPrintBattery, ffJsonBattery, "Battery", batteryKey),
+    FF_MODULE_UNTIMED("Break", ffPrintBreak, NULL),
+    FF_MODULE_UNTIMED("Colors", ffPrintColors, NULL),
+    FF_MODULE("CPU", ffPrintCPU, ffJsonCPU, "CPU", cpuKey),
+    FF_MODULE("Cursor", ffPrintCursor, ffJsonCursor, "Cursor", cursorKey),
+    FF_MODULE("DE", ffPrintDesktopEnvironment, ffJsonDesktopEnvironment, "DE", deKey),
+    FF_MODULE("Disk", ffPrintDisk, ffJsonDisk, "Disk", diskKey),
+    FF_MODULE("Font", ffPrintFont, ffJsonFont, "Font", fontKey),
+    FF_MODULE("GPU", ffPrintGPU, ffJsonGPU, "GPU", gpuKey),
+    FF_MODULE("Host", ffPrintHost, ffJsonHost, "Host", hostKey),
+    FF_MODULE("Icons", ffPrintIcons, ffJsonIcons, "Icons", iconsKey),
+    FF_MODULE("Kernel", ffPrintKernel, ffJsonKernel, "Kernel", kernelKey),
+    FF_MODULE("Locale", ffPrintLocale, ffJsonLocale, "Locale", localeKey),
+    FF_MODULE("Memory", ffPrintMemory, ffJsonMemory, "Memory", memoryKey),
+    FF_MODULE("OS", ffPrintOS, ffJsonOS, "OS", osKey),
+    FF_MODULE("Packages", ffPrintPackages, ffJsonPackages, "Packages", packagesKey),
+    FF_MODULE("Resolution", ffPrintResolution, ffJsonResolution, "Resolution", resolutionKey),
+    FF_MODULE_UNTIMED("Separator", ffPrintSeparator, NULL),
+    FF_MODULE("Shell", ffPrintShell, ffJsonShell, "Shell", shellKey),
+    FF_MODULE("Terminal", ffPrintTerminal, ffJsonTerminal, "Terminal", terminalKey),
+    FF_MODULE("TerminalFont", ffPrintTerminalFont, NULL, "Terminal Font", termFontKey),
+    FF_MODULE("Theme", ffPrintTheme, ffJsonTheme, "Theme", themeKey),
+    FF_MODULE_UNTIMED("Title", ffPrintTitle, ffJsonTitle),
+    FF_MODULE("Uptime", ffPrintUptime, ffJsonUptime, "Uptime", uptimeKey),
+    FF_MODULE("WM", ffPrintWM, ffJsonWM, "WM", wmKey),
+    FF_MODULE("WMTheme", ffPrintWMTheme, NULL, "WM Theme", wmThemeKey),
+    FF_MODULE_ALIAS("DesktopEnvironment", ffPrintDesktopEnvironment, ffJsonDesktopEnvironment, "DE", deKey),
+    FF_MODULE_ALIAS("WindowManager", ffPrintWM, ffJsonWM, "WM", wmKey)
+};
+
+#undef FF_MODULE_UNTIMED
+#undef FF_MODULE_ALIAS
+#undef FF_MODULE
+
+#define FF_MODULES_COUNT ((uint32_t) (sizeof(modules) / sizeof(modules[0])))
+
+static const FFmodule* findModule(const char* name)
+{
+    static FFnameindex index;
+    uint32_t i = nameIndexFind(&index, modules, sizeof(modules[0]), FF_MODULES_COUNT, name);
+    return i < FF_MODULES_COUNT ? &modules[i] : NULL;
+}
+
 static inline void printAvailableModules()
 {
+    for(uint32_t i = 0; i < FF_MODULES_COUNT; ++i)
+    {
+        if(modules[i].listed)
+            puts(modules[i].name);
+    }
+
     puts(
-        "Battery\n"
-        "Break\n"
-        "Colors\n"
-        "CPU\n"
-        "Cursor\n"
-        "DE\n"
-        "Disk\n"
-        "Font\n"
-        "GPU\n"
-        "Host\n"
-        "Icons\n"
-        "Kernel\n"
-        "Locale\n"
-        "Memory\n"
-        "OS\n"
-        "Packages\n"
-        "Resolution\n"
-        "Separator\n"
-        "Shell\n"
-        "Terminal\n"
-        "TerminalFont\n"
-        "Theme\n"
-        "Title\n"
-        "Uptime\n"
-        "WM\n"
-        "WMTheme\n"
         "\n"
         "+ Additional defined by --set"
     );
 }
 
+#undef FF_MODULES_COUNT
+
 static inline void listAvailablePresetsFromFolder(FFstrbuf* folder, uint8_t indentation, const char* folderName)
 {
     DIR* dir = opendir(folder->chars);
@@ -690,254 +819,396 @@ static inline void optionParseString(const char* key, const char* value, FFstrbu
     ffStrbufSetS(buffer, value);
 }
 
-static void parseOption(FFinstance* instance, FFdata* data, const char* key, const char* value)
+typedef enum FFoptionid
 {
-    if(strcasecmp(key, "-h") == 0 || strcasecmp(key, "--help") == 0)
-    {
-        if(value == NULL)
-            printHelp();
-        else
-            printCommandHelp(value);
+    FF_OPTION_HELP,
+    FF_OPTION_VERSION,
+    FF_OPTION_LIST_LOGOS,
+    FF_OPTION_PRINT_LOGOS,
+    FF_OPTION_PRINT_DEFAULT_CONFIG,
+    FF_OPTION_PRINT_DEFAULT_STRUCTURE,
+    FF_OPTION_PRINT_AVAILABLE_MODULES,
+    FF_OPTION_PRINT_AVAILABLE_PRESETS,
+    FF_OPTION_SPACING,
+    FF_OPTION_OFFSETX,
+    FF_OPTION_SET,
+    FF_OPTION_RECACHE,
+    FF_OPTION_NOCACHE,
+    FF_OPTION_LOAD_CONFIG,
+    FF_OPTION_MULTITHREADING,
+    FF_OPTION_DAEMON,
+    FF_OPTION_CLIENT,
+    FF_OPTION_TIMEOUT,
+    FF_OPTION_WATCH,
+    FF_OPTION_FORMAT,
+    FF_OPTION_SYSROOT,
+    FF_OPTION_SYSROOT_BATCH,
+    FF_OPTION_STRUCTURE,
+    FF_OPTION_LOGO,
+    FF_OPTION_COLOR,
+    FF_OPTION_CONFIG_BOOL, //bool in FFconfig at configOffset
+    FF_OPTION_CONFIG_STRING //FFstrbuf in FFconfig at configOffset
+} FFoptionid;
+
+typedef struct FFoption
+{
+    const char* name;
+    FFoptionid id;
+    size_t configOffset;
+} FFoption;
+
+#define FF_OPTION(name, id) {name, id, 0}
+#define FF_OPTION_BOOL(name, field) {name, FF_OPTION_CONFIG_BOOL, offsetof(FFconfig, field)}
+#define FF_OPTION_STRING(name, field) {name, FF_OPTION_CONFIG_STRING, offsetof(FFconfig, field)}
+
+static const FFoption options[] = {
+    FF_OPTION("-h", FF_OPTION_HELP),
+    FF_OPTION("--help", FF_OPTION_HELP),
+    FF_OPTION("-v", FF_OPTION_VERSION),
+    FF_OPTION("--version", FF_OPTION_VERSION),
+    FF_OPTION("--list-logos", FF_OPTION_LIST_LOGOS),
+    FF_OPTION("--print-logos", FF_OPTION_PRINT_LOGOS),
+    FF_OPTION("--print-default-config", FF_OPTION_PRINT_DEFAULT_CONFIG),
+    FF_OPTION("--print-default-structure", FF_OPTION_PRINT_DEFAULT_STRUCTURE),
+    FF_OPTION("--print-available-modules", FF_OPTION_PRINT_AVAILABLE_MODULES),
+    FF_OPTION("--print-available-presets", FF_OPTION_PRINT_AVAILABLE_PRESETS),
+    FF_OPTION("--spacing", FF_OPTION_SPACING),
+    FF_OPTION("-x", FF_OPTION_OFFSETX),
+    FF_OPTION("--offsetx", FF_OPTION_OFFSETX),
+    FF_OPTION("--set", FF_OPTION_SET),
+    FF_OPTION("-r", FF_OPTION_RECACHE),
+    FF_OPTION("--recache", FF_OPTION_RECACHE),
+    FF_OPTION("--nocache", FF_OPTION_NOCACHE),
+    FF_OPTION("--load-config", FF_OPTION_LOAD_CONFIG),
+    FF_OPTION_BOOL("--show-errors", showErrors),
+    FF_OPTION_BOOL("--color-logo", colorLogo),
+    FF_OPTION_BOOL("--print-remaining-logo", printRemainingLogo),
+    FF_OPTION("--multithreading", FF_OPTION_MULTITHREADING),
+    FF_OPTION("--daemon", FF_OPTION_DAEMON),
+    FF_OPTION("--client", FF_OPTION_CLIENT),
+    FF_OPTION_BOOL("--allow-slow-operations", allowSlowOperations),
+    FF_OPTION_BOOL("--disable-linewrap", disableLinewrap),
+    FF_OPTION_BOOL("--hide-cursor", hideCursor),
+    FF_OPTION_BOOL("--stat", stat),
+    FF_OPTION_STRING("--trace-file", traceFile),
+    FF_OPTION("--timeout-ms", FF_OPTION_TIMEOUT),
+    FF_OPTION_STRING("--timeout-placeholder", timeoutPlaceholder),
+    FF_OPTION("--watch", FF_OPTION_WATCH),
+    FF_OPTION("--format", FF_OPTION_FORMAT),
+    FF_OPTION("--sysroot", FF_OPTION_SYSROOT),
+    FF_OPTION("--sysroot-batch", FF_OPTION_SYSROOT_BATCH),
+    FF_OPTION("--structure", FF_OPTION_STRUCTURE),
+    FF_OPTION("-l", FF_OPTION_LOGO),
+    FF_OPTION("--logo", FF_OPTION_LOGO),
+    FF_OPTION_STRING("-s", separator),
+    FF_OPTION_STRING("--separator", separator),
+    FF_OPTION("-c", FF_OPTION_COLOR),
+    FF_OPTION("--color", FF_OPTION_COLOR),
+    FF_OPTION_STRING("--os-format", osFormat),
+    FF_OPTION_STRING("--os-key", osKey),
+    FF_OPTION_STRING("--host-format", hostFormat),
+    FF_OPTION_STRING("--host-key", hostKey),
+    FF_OPTION_STRING("--kernel-format", kernelFormat),
+    FF_OPTION_STRING("--kernel-key", kernelKey),
+    FF_OPTION_STRING("--uptime-format", uptimeFormat),
+    FF_OPTION_STRING("--uptime-key", uptimeKey),
+    FF_OPTION_STRING("--packages-format", packagesFormat),
+    FF_OPTION_STRING("--packages-key", packagesKey),
+    FF_OPTION_STRING("--shell-format", shellFormat),
+    FF_OPTION_STRING("--shell-key", shellKey),
+    FF_OPTION_STRING("--resolution-format", resolutionFormat),
+    FF_OPTION_STRING("--resolution-key", resolutionKey),
+    FF_OPTION_STRING("--de-format", deFormat),
+    FF_OPTION_STRING("--de-key", deKey),
+    FF_OPTION_STRING("--wm-format", wmFormat),
+    FF_OPTION_STRING("--wm-key", wmKey),
+    FF_OPTION_STRING("--wm-theme-format", wmThemeFormat),
+    FF_OPTION_STRING("--wm-theme-key", wmThemeKey),
+    FF_OPTION_STRING("--theme-format", themeFormat),
+    FF_OPTION_STRING("--theme-key", themeKey),
+    FF_OPTION_STRING("--icons-format", iconsFormat),
+    FF_OPTION_STRING("--icons-key", iconsKey),
+    FF_OPTION_STRING("--font-format", fontFormat),
+    FF_OPTION_STRING("--font-key", fontKey),
+    FF_OPTION_STRING("--cursor-key", cursorKey),
+    FF_OPTION_STRING("--cursor-format", cursorFormat),
+    FF_OPTION_STRING("--terminal-format", terminalFormat),
+    FF_OPTION_STRING("--terminal-key", terminalKey),
+    FF_OPTION_STRING("--terminal-font-format", termFontFormat),
+    FF_OPTION_STRING("--terminal-font-key", termFontKey),
+    FF_OPTION_STRING("--cpu-format", cpuFormat),
+    FF_OPTION_STRING("--cpu-key", cpuKey),
+    FF_OPTION_STRING("--gpu-format", gpuFormat),
+    FF_OPTION_STRING("--gpu-key", gpuKey),
+    FF_OPTION_STRING("--memory-format", memoryFormat),
+    FF_OPTION_STRING("--memory-key", memoryKey),
+    FF_OPTION_STRING("--disk-format", diskFormat),
+    FF_OPTION_STRING("--disk-key", diskKey),
+    FF_OPTION_STRING("--battery-format", batteryFormat),
+    FF_OPTION_STRING("--battery-key", batteryKey),
+    FF_OPTION_STRING("--locale-format", localeFormat),
+    FF_OPTION_STRING("--locale-key", localeKey),
+    FF_OPTION_STRING("--lib-X11", libX11),
+    FF_OPTION_STRING("--lib-Xrandr", libXrandr),
+    FF_OPTION_STRING("--lib-gio", libGIO),
+    FF_OPTION_STRING("--lib-DConf", libDConf),
+    FF_OPTION_STRING("--lib-wayland", libWayland),
+    FF_OPTION_STRING("--lib-XFConf", libXFConf),
+    FF_OPTION_STRING("--lib-SQLite", libSQLite),
+    FF_OPTION_STRING("--disk-folders", diskFolders),
+    FF_OPTION_STRING("--battery-dir", batteryDir),
+    FF_OPTION_STRING("--pci-ids", pciIds)
+};
+
+#undef FF_OPTION
+#undef FF_OPTION_BOOL
+#undef FF_OPTION_STRING
+
+static const FFoption* findOption(const char* name)
+{
+    static FFnameindex index;
+    const uint32_t count = (uint32_t) (sizeof(options) / sizeof(options[0]));
+    uint32_t i = nameIndexFind(&index, options, sizeof(options[0]), count, name);
+    return i < count ? &options[i] : NULL;
+}
 
-        exit(0);
-    }
-    else if(strcasecmp(key, "-v") == 0 || strcasecmp(key, "--version") == 0)
-    {
-        puts(FASTFETCH_PROJECT_NAME" "FASTFETCH_PROJECT_VERSION);
-        exit(0);
-    }
-    else if(strcasecmp(key, "--list-logos") == 0)
-    {
-        ffListLogos();
-        exit(0);
-    }
-    else if(strcasecmp(key, "--print-logos") == 0)
-    {
-        ffPrintLogos(instance);
-        exit(0);
-    }
-    else if(strcasecmp(key, "--print-default-config") == 0)
+static inline bool optionNameEndsWith(const char* name, const char* end)
+{
+    size_t nameLength = strlen(name);
+    size_t endLength = strlen(end);
+    return nameLength >= endLength && strcmp(name + nameLength - endLength, end) == 0;
+}
+
+//Every --*-format and --*-key is parsed once here, instead of on every printed line
+static void compileFormats(FFinstance* instance)
+{
+    const uint32_t count = (uint32_t) (sizeof(options) / sizeof(options[0]));
+    for(uint32_t i = 0; i < count; ++i)
     {
-        puts(FASTFETCH_DEFAULT_CONFIG);
-        exit(0);
+        if(options[i].id != FF_OPTION_CONFIG_STRING || (!optionNameEndsWith(options[i].name, "-format") && !optionNameEndsWith(options[i].name, "-key")))
+            continue;
+
+        ffFormatCompile(instance, (const FFstrbuf*) ((const char*) &instance->config + options[i].configOffset));
     }
-    else if(strcasecmp(key, "--print-default-structure") == 0)
+}
+
+static inline FFoutputformat optionParseOutputFormat(const char* key, const char* value)
+{
+    if(value == NULL)
     {
-        puts(FASTFETCH_DEFAULT_STRUCTURE);
-        exit(0);
+        fprintf(stderr, "Error: usage: %s <text|json|ndjson>\n", key);
+        exit(480);
     }
-    else if(strcasecmp(key, "--print-available-modules") == 0)
+
+    if(strcasecmp(value, "text") == 0)
+        return FF_OUTPUT_FORMAT_TEXT;
+    if(strcasecmp(value, "json") == 0)
+        return FF_OUTPUT_FORMAT_JSON;
+    if(strcasecmp(value, "ndjson") == 0)
+        return FF_OUTPUT_FORMAT_NDJSON;
+
+    fprintf(stderr, "Error: unknown output format %s, must be text, json or ndjson\n", value);
+    exit(481);
+}
+
+static inline uint32_t optionParseTimeout(const char* key, const char* value)
+{
+    if(value == NULL)
     {
-        printAvailableModules();
-        exit(0);
+        fprintf(stderr, "Error: usage: %s <ms>\n", key);
+        exit(415);
     }
-    else if(strcasecmp(key, "--print-available-presets") == 0)
+
+    uint32_t timeoutMs;
+    if(sscanf(value, "%u", &timeoutMs) != 1)
     {
-        listAvailablePresets(instance);
-        exit(0);
+        fprintf(stderr, "Error: couldn't parse %s to uint32_t\n", value);
+        exit(416);
     }
-    else if(strcasecmp(key, "--spacing") == 0)
+
+    return timeoutMs;
+}
+
+//--<module>-timeout, with the module named like in the structure
+static bool parseModuleTimeout(FFdata* data, const char* key, const char* value)
+{
+    size_t length = strlen(key);
+    if(length <= strlen("---timeout") || strncmp(key, "--", 2) != 0 || strcmp(key + length - strlen("-timeout"), "-timeout") != 0)
+        return false;
+
+    char moduleName[32];
+    size_t moduleNameLength = length - strlen("---timeout");
+    if(moduleNameLength >= sizeof(moduleName))
+        return false;
+    memcpy(moduleName, key + 2, moduleNameLength);
+    moduleName[moduleNameLength] = '\0';
+
+    const FFmodule* module = findModule(moduleName);
+    if(module == NULL || module->keyName == NULL)
+        return false;
+
+    uint32_t timeoutMs = optionParseTimeout(key, value);
+
+    for(uint32_t i = 0; i < data->moduleTimeouts.length; i++)
     {
-        if(value == NULL)
-        {
-            fprintf(stderr, "Error: usage: %s <width>\n", key);
-            exit(404);
-        }
-        if(sscanf(value, "%hu", &instance->config.logoKeySpacing) != 1)
+        FFmoduletimeout* moduleTimeout = ffListGet(&data->moduleTimeouts, i);
+        if(moduleTimeout->print == module->print)
         {
-            fprintf(stderr, "Error: couldn't parse %s to uint16_t\n", value);
-            exit(405);
+            moduleTimeout->timeoutMs = timeoutMs;
+            return true;
         }
     }
-    else if(strcasecmp(key, "-x") == 0 || strcasecmp(key, "--offsetx") == 0)
+
+    FFmoduletimeout* moduleTimeout = ffListAdd(&data->moduleTimeouts);
+    moduleTimeout->print = module->print;
+    moduleTimeout->timeoutMs = timeoutMs;
+    return true;
+}
+
+static void parseOption(FFinstance* instance, FFdata* data, const char* key, const char* value)
+{
+    const FFoption* option = findOption(key);
+    if(option == NULL && parseModuleTimeout(data, key, value))
+        return;
+
+    if(option == NULL)
     {
-        if(value == NULL)
-        {
-            fprintf(stderr, "Error: usage: %s <offset>\n", key);
-            exit(408);
-        }
-        if(sscanf(value, "%hi", &instance->config.offsetx) != 1)
-        {
-            fprintf(stderr, "Error: couldn't parse %s to int16_t\n", value);
-            exit(409);
-        }
+        fprintf(stderr, "Error: unknown option: %s\n", key);
+        exit(400);
     }
-    else if(strcasecmp(key, "--set") == 0)
+
+    switch(option->id)
     {
-        if(value == NULL)
+        case FF_OPTION_HELP:
+            if(value == NULL)
+                printHelp();
+            else
+                printCommandHelp(value);
+            exit(0);
+        case FF_OPTION_VERSION:
+            puts(FASTFETCH_PROJECT_NAME" "FASTFETCH_PROJECT_VERSION);
+            exit(0);
+        case FF_OPTION_LIST_LOGOS:
+            ffListLogos();
+            exit(0);
+        case FF_OPTION_PRINT_LOGOS:
+            ffPrintLogos(instance);
+            exit(0);
+        case FF_OPTION_PRINT_DEFAULT_CONFIG:
+            puts(FASTFETCH_DEFAULT_CONFIG);
+            exit(0);
+        case FF_OPTION_PRINT_DEFAULT_STRUCTURE:
+            puts(FASTFETCH_DEFAULT_STRUCTURE);
+            exit(0);
+        case FF_OPTION_PRINT_AVAILABLE_MODULES:
+            printAvailableModules();
+            exit(0);
+        case FF_OPTION_PRINT_AVAILABLE_PRESETS:
+            listAvailablePresets(instance);
+            exit(0);
+        case FF_OPTION_SPACING:
+            if(value == NULL)
+            {
+                fprintf(stderr, "Error: usage: %s <width>\n", key);
+                exit(404);
+            }
+            if(sscanf(value, "%hu", &instance->config.logoKeySpacing) != 1)
+            {
+                fprintf(stderr, "Error: couldn't parse %s to uint16_t\n", value);
+                exit(405);
+            }
+            break;
+        case FF_OPTION_OFFSETX:
+            if(value == NULL)
+            {
+                fprintf(stderr, "Error: usage: %s <offset>\n", key);
+                exit(408);
+            }
+            if(sscanf(value, "%hi", &instance->config.offsetx) != 1)
+            {
+                fprintf(stderr, "Error: couldn't parse %s to int16_t\n", value);
+                exit(409);
+            }
+            break;
+        case FF_OPTION_SET:
         {
-            fprintf(stderr, "Error: usage: %s <key=value>\n", key);
-            exit(411);
-        }
+            if(value == NULL)
+            {
+                fprintf(stderr, "Error: usage: %s <key=value>\n", key);
+                exit(411);
+            }
 
-        char* separator = strchr(value, '=');
+            char* separator = strchr(value, '=');
 
-        if(separator == NULL)
-        {
-            fprintf(stderr, "Error: usage: %s <key=value>, '=' missing\n", key);
-            exit(412);
-        }
+            if(separator == NULL)
+            {
+                fprintf(stderr, "Error: usage: %s <key=value>, '=' missing\n", key);
+                exit(412);
+            }
 
-        *separator = '\0';
-
-        ffValuestoreSet(&data->valuestore, value, separator + 1);
-    }
-    else if(strcasecmp(key, "-r") == 0 || strcasecmp(key, "--recache") == 0)
-    {
-        //Set cacheSave as well, beacuse the user expects the values to be cached when expliciting using --recache
-        instance->config.recache = optionParseBoolean(value);
-        instance->config.cacheSave = instance->config.recache;
-    }
-    else if(strcasecmp(key, "--nocache") == 0)
-    {
-        instance->config.recache = optionParseBoolean(value);
-        instance->config.cacheSave = false;
-    }
-    else if(strcasecmp(key, "--load-config") == 0)
-        optionParseConfigFile(instance, data, key, value);
-    else if(strcasecmp(key, "--show-errors") == 0)
-        instance->config.showErrors = optionParseBoolean(value);
-    else if(strcasecmp(key, "--color-logo") == 0)
-        instance->config.colorLogo = optionParseBoolean(value);
-    else if(strcasecmp(key, "--print-remaining-logo") == 0)
-        instance->config.printRemainingLogo = optionParseBoolean(value);
-    else if(strcasecmp(key, "--multithreading") == 0)
-        data->multithreading = optionParseBoolean(value);
-    else if(strcasecmp(key, "--allow-slow-operations") == 0)
-        instance->config.allowSlowOperations = optionParseBoolean(value);
-    else if(strcasecmp(key, "--disable-linewrap") == 0)
-        instance->config.disableLinewrap = optionParseBoolean(value);
-    else if(strcasecmp(key, "--hide-cursor") == 0)
-        instance->config.hideCursor = optionParseBoolean(value);
-    else if(strcasecmp(key, "--structure") == 0)
-        optionParseString(key, value, &data->structure);
-    else if(strcasecmp(key, "-l") == 0 || strcasecmp(key, "--logo") == 0)
-        optionParseString(key, value, &data->logoName);
-    else if(strcasecmp(key, "-s") == 0 || strcasecmp(key, "--separator") == 0)
-        optionParseString(key, value, &instance->config.separator);
-    else if(strcasecmp(key, "-c") == 0 || strcasecmp(key, "--color") == 0)
-    {
-        if(value == NULL)
-        {
-            fprintf(stderr, "Error: usage: %s <str>\n", key);
-            exit(477);
+            *separator = '\0';
+
+            ffValuestoreSet(&data->valuestore, value, separator + 1);
+            break;
         }
-        ffStrbufSetS(&instance->config.color, "\033[");
-        ffStrbufAppendS(&instance->config.color, value);
-        ffStrbufAppendC(&instance->config.color, 'm');
-    }
-    else if(strcasecmp(key, "--os-format") == 0)
-        optionParseString(key, value, &instance->config.osFormat);
-    else if(strcasecmp(key, "--os-key") == 0)
-        optionParseString(key, value, &instance->config.osKey);
-    else if(strcasecmp(key, "--host-format") == 0)
-        optionParseString(key, value, &instance->config.hostFormat);
-    else if(strcasecmp(key, "--host-key") == 0)
-        optionParseString(key, value, &instance->config.hostKey);
-    else if(strcasecmp(key, "--kernel-format") == 0)
-        optionParseString(key, value, &instance->config.kernelFormat);
-    else if(strcasecmp(key, "--kernel-key") == 0)
-        optionParseString(key, value, &instance->config.kernelKey);
-    else if(strcasecmp(key, "--uptime-format") == 0)
-        optionParseString(key, value, &instance->config.uptimeFormat);
-    else if(strcasecmp(key, "--uptime-key") == 0)
-        optionParseString(key, value, &instance->config.uptimeKey);
-    else if(strcasecmp(key, "--packages-format") == 0)
-        optionParseString(key, value, &instance->config.packagesFormat);
-    else if(strcasecmp(key, "--packages-key") == 0)
-        optionParseString(key, value, &instance->config.packagesKey);
-    else if(strcasecmp(key, "--shell-format") == 0)
-        optionParseString(key, value, &instance->config.shellFormat);
-    else if(strcasecmp(key, "--shell-key") == 0)
-        optionParseString(key, value, &instance->config.shellKey);
-    else if(strcasecmp(key, "--resolution-format") == 0)
-        optionParseString(key, value, &instance->config.resolutionFormat);
-    else if(strcasecmp(key, "--resolution-key") == 0)
-        optionParseString(key, value, &instance->config.resolutionKey);
-    else if(strcasecmp(key, "--de-format") == 0)
-        optionParseString(key, value, &instance->config.deFormat);
-    else if(strcasecmp(key, "--de-key") == 0)
-        optionParseString(key, value, &instance->config.deKey);
-    else if(strcasecmp(key, "--wm-format") == 0)
-        optionParseString(key, value, &instance->config.wmFormat);
-    else if(strcasecmp(key, "--wm-key") == 0)
-        optionParseString(key, value, &instance->config.wmKey);
-    else if(strcasecmp(key, "--wm-theme-format") == 0)
-        optionParseString(key, value, &instance->config.wmThemeFormat);
-    else if(strcasecmp(key, "--wm-theme-key") == 0)
-        optionParseString(key, value, &instance->config.wmThemeKey);
-    else if(strcasecmp(key, "--theme-format") == 0)
-        optionParseString(key, value, &instance->config.themeFormat);
-    else if(strcasecmp(key, "--theme-key") == 0)
-        optionParseString(key, value, &instance->config.themeKey);
-    else if(strcasecmp(key, "--icons-format") == 0)
-        optionParseString(key, value, &instance->config.iconsFormat);
-    else if(strcasecmp(key, "--icons-key") == 0)
-        optionParseString(key, value, &instance->config.iconsKey);
-    else if(strcasecmp(key, "--font-format") == 0)
-        optionParseString(key, value, &instance->config.fontFormat);
-    else if(strcasecmp(key, "--font-key") == 0)
-        optionParseString(key, value, &instance->config.fontKey);
-    else if(strcasecmp(key, "--cursor-key") == 0)
-        optionParseString(key, value, &instance->config.cursorKey);
-    else if(strcasecmp(key, "--cursor-format") == 0)
-        optionParseString(key, value, &instance->config.cursorFormat);
-    else if(strcasecmp(key, "--terminal-format") == 0)
-        optionParseString(key, value, &instance->config.terminalFormat);
-    else if(strcasecmp(key, "--terminal-key") == 0)
-        optionParseString(key, value, &instance->config.terminalKey);
-    else if(strcasecmp(key, "--terminal-font-format") == 0)
-        optionParseString(key, value, &instance->config.termFontFormat);
-    else if(strcasecmp(key, "--terminal-font-key") == 0)
-        optionParseString(key, value, &instance->config.termFontKey);
-    else if(strcasecmp(key, "--cpu-format") == 0)
-        optionParseString(key, value, &instance->config.cpuFormat);
-    else if(strcasecmp(key, "--cpu-key") == 0)
-        optionParseString(key, value, &instance->config.cpuKey);
-    else if(strcasecmp(key, "--gpu-format") == 0)
-        optionParseString(key, value, &instance->config.gpuFormat);
-    else if(strcasecmp(key, "--gpu-key") == 0)
-        optionParseString(key, value, &instance->config.gpuKey);
-    else if(strcasecmp(key, "--memory-format") == 0)
-        optionParseString(key, value, &instance->config.memoryFormat);
-    else if(strcasecmp(key, "--memory-key") == 0)
-        optionParseString(key, value, &instance->config.memoryKey);
-    else if(strcasecmp(key, "--disk-format") == 0)
-        optionParseString(key, value, &instance->config.diskFormat);
-    else if(strcasecmp(key, "--disk-key") == 0)
-        optionParseString(key, value, &instance->config.diskKey);
-    else if(strcasecmp(key, "--battery-format") == 0)
-        optionParseString(key, value, &instance->config.batteryFormat);
-    else if(strcasecmp(key, "--battery-key") == 0)
-        optionParseString(key, value, &instance->config.batteryKey);
-    else if(strcasecmp(key, "--locale-format") == 0)
-        optionParseString(key, value, &instance->config.localeFormat);
-    else if(strcasecmp(key, "--locale-key") == 0)
-        optionParseString(key, value, &instance->config.localeKey);
-    else if(strcasecmp(key, "--lib-PCI") == 0)
-        optionParseString(key, value, &instance->config.libPCI);
-    else if(strcasecmp(key, "--lib-X11") == 0)
-        optionParseString(key, value, &instance->config.libX11);
-    else if(strcasecmp(key, "--lib-Xrandr") == 0)
-        optionParseString(key, value, &instance->config.libXrandr);
-    else if(strcasecmp(key, "--lib-gio") == 0)
-        optionParseString(key, value, &instance->config.libGIO);
-    else if(strcasecmp(key, "--lib-DConf") == 0)
-        optionParseString(key, value, &instance->config.libDConf);
-    else if(strcasecmp(key, "--lib-wayland") == 0)
-        optionParseString(key, value, &instance->config.libWayland);
-    else if(strcasecmp(key, "--lib-XFConf") == 0)
-        optionParseString(key, value, &instance->config.libXFConf);
-    else if(strcasecmp(key, "--lib-SQLite") == 0)
-        optionParseString(key, value, &instance->config.libSQLite);
-    else if(strcasecmp(key, "--disk-folders") == 0)
-        optionParseString(key, value, &instance->config.diskFolders);
-    else if(strcasecmp(key, "--battery-dir") == 0)
-        optionParseString(key, value, &instance->config.batteryDir);
-    else
-    {
-        fprintf(stderr, "Error: unknown option: %s\n", key);
-        exit(400);
+        case FF_OPTION_RECACHE:
+            //Set cacheSave as well, beacuse the user expects the values to be cached when expliciting using --recache
+            instance->config.recache = optionParseBoolean(value);
+            instance->config.cacheSave = instance->config.recache;
+            break;
+        case FF_OPTION_NOCACHE:
+            instance->config.recache = optionParseBoolean(value);
+            instance->config.cacheSave = false;
+            break;
+        case FF_OPTION_LOAD_CONFIG:
+            optionParseConfigFile(instance, data, key, value);
+            break;
+        case FF_OPTION_MULTITHREADING:
+            data->multithreading = optionParseBoolean(value);
+            break;
+        case FF_OPTION_DAEMON:
+            data->daemon = optionParseBoolean(value);
+            break;
+        case FF_OPTION_CLIENT:
+            //Only reached if no daemon is running, in which case this is a normal run
+            break;
+        case FF_OPTION_TIMEOUT:
+            data->timeoutMs = optionParseTimeout(key, value);
+            break;
+        case FF_OPTION_WATCH:
+            data->watchMs = optionParseTimeout(key, value);
+            break;
+        case FF_OPTION_FORMAT:
+            instance->config.outputFormat = optionParseOutputFormat(key, value);
+            break;
+        case FF_OPTION_SYSROOT:
+            optionParseString(key, value, &data->sysroot);
+            break;
+        case FF_OPTION_SYSROOT_BATCH:
+            optionParseString(key, value, &data->sysrootBatch);
+            break;
+        case FF_OPTION_STRUCTURE:
+            optionParseString(key, value, &data->structure);
+            break;
+        case FF_OPTION_LOGO:
+            optionParseString(key, value, &data->logoName);
+            break;
+        case FF_OPTION_COLOR:
+            if(value == NULL)
+            {
+                fprintf(stderr, "Error: usage: %s <str>\n", key);
+                exit(477);
+            }
+            ffStrbufSetS(&instance->config.color, "\033[");
+            ffStrbufAppendS(&instance->config.color, value);
+            ffStrbufAppendC(&instance->config.color, 'm');
+            break;
+        case FF_OPTION_CONFIG_BOOL:
+            *(bool*) ((char*) &instance->config + option->configOffset) = optionParseBoolean(value);
+            break;
+        case FF_OPTION_CONFIG_STRING:
+            optionParseString(key, value, (FFstrbuf*) ((char*) &instance->config + option->configOffset));
+            break;
     }
 }
 
@@ -979,7 +1250,7 @@ static void parseArguments(FFinstance* instance, FFdata* data, int argc, const c
 {
     for(int i = 1; i < argc; i++)
     {
-        if(i == argc - 1 || (*argv[i + 1] == '-' && strcasecmp(argv[i], "--offsetx") != 0)) // --offsetx allows negative values
+        if(i == argc - 1 || (*argv[i + 1] == '-' && argv[i + 1][1] != '\0' && strcasecmp(argv[i], "--offsetx") != 0)) // --offsetx allows negative values, a lone - is stdin
         {
             parseOption(instance, data, argv[i], NULL);
         }
@@ -991,8 +1262,31 @@ static void parseArguments(FFinstance* instance, FFdata* data, int argc, const c
     }
 }
 
+static void applySysroot(FFinstance* instance, const char* sysroot)
+{
+    if(!ffSysrootSet(sysroot))
+    {
+        fprintf(stderr, "Error: couldn't open sysroot %s: %s\n", sysroot, strerror(errno));
+        exit(482);
+    }
+
+    //Cached values are the ones of the host
+    instance->config.recache = true;
+    instance->config.cacheSave = false;
+}
+
 static void applyData(FFinstance* instance, FFdata* data)
 {
+    if(data->sysroot.length > 0)
+        applySysroot(instance, data->sysroot.chars);
+
+    //JSON has neither logo nor colored keys
+    if(instance->config.outputFormat != FF_OUTPUT_FORMAT_TEXT)
+    {
+        compileFormats(instance);
+        return;
+    }
+
     //We must do this after parsing all options because of color options
     if(data->logoName.length == 0)
         ffLoadLogo(instance);
@@ -1002,6 +1296,49 @@ static void applyData(FFinstance* instance, FFdata* data)
     //This must be done after loading the logo
     if(instance->config.color.length == 0)
         ffStrbufSetS(&instance->config.color, instance->config.logo.colors[0]);
+
+    compileFormats(instance);
+}
+
+static uint64_t getTimeMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+//0 if the module may take as long as it needs
+static uint32_t getModuleTimeout(const FFdata* data, const FFmodule* module)
+{
+    if(module->keyName == NULL)
+        return 0;
+
+    uint32_t timeoutMs = 0;
+    for(uint32_t i = 0; i < data->moduleTimeouts.length; i++)
+    {
+        const FFmoduletimeout* moduleTimeout = ffListGet(&data->moduleTimeouts, i);
+        if(moduleTimeout->print == module->print)
+            timeoutMs = moduleTimeout->timeoutMs;
+    }
+
+    if(data->deadline == 0)
+        return timeoutMs;
+
+    //Once the global deadline passed, every module still gets a millisecond, enough for values that are already detected
+    uint64_t now = getTimeMs();
+    uint32_t remainingMs = now < data->deadline ? (uint32_t) (data->deadline - now) : 1;
+    return timeoutMs == 0 || remainingMs < timeoutMs ? remainingMs : timeoutMs;
+}
+
+static void printModuleTimedOut(FFinstance* instance, const FFmodule* module)
+{
+    const FFstrbuf* key = (const FFstrbuf*) ((const char*) &instance->config + module->keyOffset);
+
+    if(ffPrintLastCached(instance, module->keyName, key))
+        return;
+
+    ffPrintLogoAndKey(instance, module->keyName, 0, key);
+    ffOutputPut(&instance->config.timeoutPlaceholder);
 }
 
 static void parseStructureCommand(FFinstance* instance, FFdata* data, const char* line)
@@ -1013,83 +1350,393 @@ static void parseStructureCommand(FFinstance* instance, FFdata* data, const char
         return;
     }
 
-    if(strcasecmp(line, "break") == 0)
-        ffPrintBreak(instance);
-    else if(strcasecmp(line, "title") == 0)
-        ffPrintTitle(instance);
-    else if(strcasecmp(line, "separator") == 0)
-        ffPrintSeparator(instance);
-    else if(strcasecmp(line, "os") == 0)
-        ffPrintOS(instance);
-    else if(strcasecmp(line, "host") == 0)
-        ffPrintHost(instance);
-    else if(strcasecmp(line, "kernel") == 0)
-        ffPrintKernel(instance);
-    else if(strcasecmp(line, "uptime") == 0)
-        ffPrintUptime(instance);
-    else if(strcasecmp(line, "packages") == 0)
-        ffPrintPackages(instance);
-    else if(strcasecmp(line, "shell") == 0)
-        ffPrintShell(instance);
-    else if(strcasecmp(line, "resolution") == 0)
-        ffPrintResolution(instance);
-    else if(strcasecmp(line, "desktopenvironment") == 0 || strcasecmp(line, "de") == 0)
-        ffPrintDesktopEnvironment(instance);
-    else if(strcasecmp(line, "windowmanager") == 0 || strcasecmp(line, "wm") == 0)
-        ffPrintWM(instance);
-    else if(strcasecmp(line, "theme") == 0)
-        ffPrintTheme(instance);
-    else if(strcasecmp(line, "wmtheme") == 0)
-        ffPrintWMTheme(instance);
-    else if(strcasecmp(line, "icons") == 0)
-        ffPrintIcons(instance);
-    else if(strcasecmp(line, "font") == 0)
-        ffPrintFont(instance);
-    else if(strcasecmp(line, "cursor") == 0)
-        ffPrintCursor(instance);
-    else if(strcasecmp(line, "terminal") == 0)
-        ffPrintTerminal(instance);
-    else if(strcasecmp(line, "terminalfont") == 0)
-        ffPrintTerminalFont(instance);
-    else if(strcasecmp(line, "cpu") == 0)
-        ffPrintCPU(instance);
-    else if(strcasecmp(line, "gpu") == 0)
-        ffPrintGPU(instance);
-    else if(strcasecmp(line, "memory") == 0)
-        ffPrintMemory(instance);
-    else if(strcasecmp(line, "disk") == 0)
-        ffPrintDisk(instance);
-    else if(strcasecmp(line, "battery") == 0)
-        ffPrintBattery(instance);
-    else if(strcasecmp(line, "locale") == 0)
-        ffPrintLocale(instance);
-    else if(strcasecmp(line, "colors") == 0)
-        ffPrintColors(instance);
+    const FFmodule* module = findModule(line);
+    if(module != NULL)
+    {
+        FF_TRACE_BEGIN(traceBegin);
+
+        //A print with a timeout must not block on its detection before the timeout even started
+        uint32_t timeoutMs = getModuleTimeout(data, module);
+        if(timeoutMs == 0)
+        {
+            ffPrefetchWait(line);
+            module->print(instance);
+        }
+        else if(!ffPrintWithTimeout(instance, module->print, timeoutMs))
+            printModuleTimedOut(instance, module);
+
+        FF_TRACE_END(traceBegin, "print", module->name);
+    }
     else
         ffPrintError(instance, line, 0, NULL, NULL, 0, "<no implementation provided>");
 }
 
-static void run(FFinstance* instance, FFdata* data)
+static bool isJsonWritten(const FFmodule** written, uint32_t numWritten, const FFmodule* module)
 {
-    if(data->multithreading)
-        ffStartDetectionThreads(instance);
+    for(uint32_t i = 0; i < numWritten; ++i)
+    {
+        if(written[i]->json == module->json)
+            return true;
+    }
+    return false;
+}
 
+//Ends the top level object and writes it with its line
+static void writeJsonLine(FFjsonwriter* writer)
+{
+    ffJsonEndObject(writer);
+    ffStrbufAppendC(writer->buffer, '\n');
+    ffOutputWrite(writer->buffer);
+    ffStrbufClear(writer->buffer);
+    ffJsonWriterInit(writer, writer->buffer);
+}
+
+//The results are serialized directly into one buffer. NDJSON writes a line as soon as its module is done, JSON everything at once
+static void runJson(FFinstance* instance, FFdata* data)
+{
+    bool ndjson = instance->config.outputFormat == FF_OUTPUT_FORMAT_NDJSON;
+
+    FFstrbuf buffer;
+    ffStrbufInitA(&buffer, 4096);
+    FFjsonwriter writer;
+    ffJsonWriterInit(&writer, &buffer);
+
+    const FFmodule* written[sizeof(modules) / sizeof(modules[0])];
+    uint32_t numWritten = 0;
+
+    if(!ndjson)
+        ffJsonBeginObject(&writer, NULL);
+
+    //Tells the result sets of --sysroot-batch apart
+    if(ffSysrootGet() != NULL)
+    {
+        if(ndjson)
+            ffJsonBeginObject(&writer, NULL);
+        ffJsonString(&writer, "Sysroot", ffSysrootGet());
+        if(ndjson)
+            writeJsonLine(&writer);
+    }
+
+    uint32_t startIndex = 0;
+    while (startIndex < data->structure.length)
+    {
+        uint32_t colonIndex = ffStrbufNextIndexC(&data->structure, startIndex, ':');
+        data->structure.chars[colonIndex] = '\0';
+        const char* line = data->structure.chars + startIndex;
+        startIndex = colonIndex + 1;
+
+        const char* setValue = ffValuestoreGet(&data->valuestore, line);
+        const FFmodule* module = setValue == NULL ? findModule(line) : NULL;
+
+        //A module without detection results (Break, Colors, ...) has nothing to write, one that is listed twice is only written once
+        if(module != NULL && (module->json == NULL || isJsonWritten(written, numWritten, module)))
+            continue;
+
+        if(ndjson)
+            ffJsonBeginObject(&writer, NULL);
+
+        if(setValue != NULL)
+            ffJsonString(&writer, line, setValue);
+        else if(module != NULL)
+        {
+            FF_TRACE_BEGIN(traceBegin);
+            ffJsonBeginObject(&writer, module->name);
+            ffPrefetchWait(line);
+            module->json(instance, &writer);
+            ffJsonEndObject(&writer);
+            FF_TRACE_END(traceBegin, "json", module->name);
+
+            written[numWritten++] = module;
+        }
+        else
+        {
+            ffJsonBeginObject(&writer, line);
+            ffJsonString(&writer, "error", "<no implementation provided>");
+            ffJsonEndObject(&writer);
+        }
+
+        if(ndjson)
+            writeJsonLine(&writer);
+    }
+
+    if(!ndjson)
+        writeJsonLine(&writer);
+
+    ffStrbufDestroy(&buffer);
+}
+
+//Modules whose values change while fastfetch is running. Only they are printed again in watch mode
+static const FFtaskfunc watchedPrints[] = {
+    ffPrintMemory,
+    ffPrintUptime,
+    ffPrintBattery,
+    ffPrintCPU,
+    ffPrintDisk
+};
+
+typedef struct FFwatchedmodule
+{
+    const FFmodule* module;
+    uint32_t firstRow;
+    uint32_t numRows; //Of the first fetch. Lines that are added later are cut, removed ones are cleared
+    char* lines; //What is currently shown, without logo. On the heap, as the arena is released every tick
+} FFwatchedmodule;
+
+static volatile sig_atomic_t watchStopped = 0;
+
+static void stopWatching(int signal)
+{
+    UNUSED(signal);
+    watchStopped = 1;
+}
+
+static bool isWatched(FFdata* data, const char* line, const FFmodule** module)
+{
+    if(ffValuestoreContains(&data->valuestore, line))
+        return false;
+
+    *module = findModule(line);
+    if(*module == NULL)
+        return false;
+
+    for(uint32_t i = 0; i < sizeof(watchedPrints) / sizeof(watchedPrints[0]); ++i)
+    {
+        if(watchedPrints[i] == (*module)->print)
+            return true;
+    }
+    return false;
+}
+
+static uint32_t countRows(const char* lines, uint32_t length)
+{
+    uint32_t rows = 0;
+    for(uint32_t i = 0; i < length; ++i)
+    {
+        if(lines[i] == '\n')
+            ++rows;
+    }
+    return rows;
+}
+
+static char* copyLines(const FFstrbuf* lines)
+{
+    char* copy = malloc(lines->length + 1);
+    memcpy(copy, lines->chars, lines->length + 1);
+    return copy;
+}
+
+//Prints the command like parseStructureCommand, but through a capture, to know its rows and text. Returns the number of rows
+static uint32_t printStructureCommandWatched(FFinstance* instance, FFdata* data, const char* line, uint32_t firstRow, FFlist* watched)
+{
+    FFoutputcapture capture;
+    ffOutputCaptureBegin(&capture);
+    parseStructureCommand(instance, data, line);
+    ffOutputCaptureEnd();
+
+    ffOutputAppendCapture(instance, &capture);
+
+    uint32_t rows = countRows(capture.buffer.chars, capture.buffer.length);
+
+    const FFmodule* module;
+    if(isWatched(data, line, &module))
+    {
+        FFwatchedmodule* watchedModule = ffListAdd(watched);
+        watchedModule->module = module;
+        watchedModule->firstRow = firstRow;
+        watchedModule->numRows = rows;
+        watchedModule->lines = copyLines(&capture.buffer);
+    }
+
+    ffOutputCaptureDestroy(&capture);
+    return rows;
+}
+
+static void moveCursor(uint32_t* cursorRow, uint32_t row)
+{
+    if(row < *cursorRow)
+        ffOutputAppendF("\033[%uA", *cursorRow - row);
+    else if(row > *cursorRow)
+        ffOutputAppendF("\033[%uB", row - *cursorRow);
+    ffOutputAppendC('\r');
+    *cursorRow = row;
+}
+
+static inline const char* lineEnd(const char* line)
+{
+    const char* end = strchr(line, '\n');
+    return end == NULL ? line + strlen(line) : end;
+}
+
+static inline const char* nextLine(const char* end)
+{
+    return *end == '\n' ? end + 1 : end;
+}
+
+//Prints the module again and overwrites the rows whose text changed
+static void redrawWatched(FFinstance* instance, FFwatchedmodule* watchedModule, uint32_t* cursorRow)
+{
+    FFoutputcapture capture;
+    ffOutputCaptureBegin(&capture);
+    watchedModule->module->print(instance);
+    ffOutputCaptureEnd();
+
+    const char* newLine = capture.buffer.chars;
+    const char* oldLine = watchedModule->lines;
+
+    for(uint32_t i = 0; i < watchedModule->numRows; ++i)
+    {
+        const char* newEnd = lineEnd(newLine);
+        const char* oldEnd = lineEnd(oldLine);
+
+        if(newEnd - newLine != oldEnd - oldLine || memcmp(newLine, oldLine, (size_t) (newEnd - newLine)) != 0)
+        {
+            uint32_t row = watchedModule->firstRow + i;
+            moveCursor(cursorRow, row);
+
+            //Every row shows the logo line of the same index
+            instance->config.logo.currentLine = row < instance->config.logo.compiledLines.length ? row : instance->config.logo.compiledLines.length;
+            ffPrintLogoLine(instance);
+
+            ffOutputAppendNS((uint32_t) (newEnd - newLine), newLine);
+            ffOutputAppendS("\033[K\n");
+            *cursorRow = row + 1;
+        }
+
+        newLine = nextLine(newEnd);
+        oldLine = nextLine(oldEnd);
+    }
+
+    free(watchedModule->lines);
+    watchedModule->lines = copyLines(&capture.buffer);
+
+    ffOutputCaptureDestroy(&capture);
+}
+
+//The first fetch stays on screen, only the rows of watched modules are redrawn in place every tick.
+//Nothing allocated for a tick outlives it, so the memory usage stays the same no matter how long this runs.
+static void watch(FFinstance* instance, FFdata* data, FFlist* watched, uint32_t numRows)
+{
+    //The rest of the logo belongs to the first fetch
+    ffOutputAddSlot();
+    if(instance->config.printRemainingLogo)
+        ffPrintRemainingLogo(instance);
+    if(instance->config.logo.currentLine > numRows)
+        numRows = instance->config.logo.currentLine;
+    ffOutputFlush();
+
+    //A module that timed out could still be detecting, which would race with the next tick
+    if(watched->length == 0 || !ffFinishDetectionThreads(instance))
+        return;
+
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    struct itimerspec interval = {
+        .it_interval = {.tv_sec = data->watchMs / 1000, .tv_nsec = (long) (data->watchMs % 1000) * 1000000},
+        .it_value = {.tv_sec = data->watchMs / 1000, .tv_nsec = (long) (data->watchMs % 1000) * 1000000}
+    };
+    if(timerfd == -1 || timerfd_settime(timerfd, 0, &interval, NULL) == -1)
+    {
+        fprintf(stderr, "Error: couldn't create the timer for --watch\n");
+        if(timerfd != -1)
+            close(timerfd);
+        return;
+    }
+
+    //Without SA_RESTART, so a signal interrupts the wait for the timer and the terminal can be restored by ffFinish
+    struct sigaction action = {.sa_handler = stopWatching};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    //The values of the first fetch are saved now, the ones of ticks not at all. Cached values would never change
+    ffCacheFlush(instance);
+    instance->config.recache = true;
+    instance->config.cacheSave = false;
+
+    uint32_t logoLine = instance->config.logo.currentLine;
+    FFarenamark mark = ffArenaMark(&instance->arena);
+
+    while(!watchStopped)
+    {
+        uint64_t expirations;
+        if(read(timerfd, &expirations, sizeof(expirations)) == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+
+        //Everything of the last tick, including the results of the detections, which makes them detect again
+        ffArenaRelease(&instance->arena, mark);
+        sysinfo(&instance->state.sysinfo);
+
+        uint32_t cursorRow = numRows;
+        for(uint32_t i = 0; i < watched->length; ++i)
+            redrawWatched(instance, ffListGet(watched, i), &cursorRow);
+        if(cursorRow != numRows)
+            moveCursor(&cursorRow, numRows);
+
+        ffOutputFlush();
+    }
+
+    close(timerfd);
+
+    for(uint32_t i = 0; i < watched->length; ++i)
+        free(((FFwatchedmodule*) ffListGet(watched, i))->lines);
+
+    instance->config.logo.currentLine = logoLine;
+}
+
+static void run(FFinstance* instance, FFdata* data)
+{
     if(data->structure.length == 0)
         ffStrbufSetS(&data->structure, FASTFETCH_DEFAULT_STRUCTURE);
 
+    if(instance->config.stat || instance->config.traceFile.length > 0)
+        ffTraceEnable();
+
+    if(data->timeoutMs > 0)
+        data->deadline = getTimeMs() + data->timeoutMs;
+
+    if(data->multithreading)
+    {
+        ffStartDetectionThreads(instance);
+        ffPrefetchStructure(instance, data->structure.chars);
+    }
+
     ffStart(instance);
 
+    if(instance->config.outputFormat != FF_OUTPUT_FORMAT_TEXT)
+    {
+        runJson(instance, data);
+        ffFinish(instance);
+        return;
+    }
+
+    //Cursor addressing makes no sense for pipes, like the ones of --sysroot-batch and --client
+    bool watching = data->watchMs > 0 && isatty(STDOUT_FILENO);
+    FFlist watched;
+    ffListInit(&watched, sizeof(FFwatchedmodule));
+    uint32_t numRows = 0;
+
     uint32_t startIndex = 0;
     while (startIndex < data->structure.length)
     {
         uint32_t colonIndex = ffStrbufNextIndexC(&data->structure, startIndex, ':');
         data->structure.chars[colonIndex] = '\0';
 
-        parseStructureCommand(instance, data, data->structure.chars + startIndex);
+        //Every module gets its own slot in the output frame
+        ffOutputAddSlot();
+        if(watching)
+            numRows += printStructureCommandWatched(instance, data, data->structure.chars + startIndex, numRows, &watched);
+        else
+            parseStructureCommand(instance, data, data->structure.chars + startIndex);
 
         startIndex = colonIndex + 1;
     }
 
+    if(watching)
+        watch(instance, data, &watched, numRows);
+
     ffFinish(instance);
 }
 
@@ -1098,11 +1745,489 @@ static void initData(FFdata* data)
     ffValuestoreInit(&data->valuestore);
     ffStrbufInitA(&data->structure, 256);
     ffStrbufInit(&data->logoName);
+    ffStrbufInit(&data->sysroot);
+    ffStrbufInit(&data->sysrootBatch);
     data->multithreading = true;
+    data->daemon = false;
+    data->timeoutMs = 0;
+    data->deadline = 0;
+    data->watchMs = 0;
+    ffListInit(&data->moduleTimeouts, sizeof(FFmoduletimeout));
+}
+
+//Only a directory that belongs to us and nobody else can write to keeps other users from putting their socket in place of ours
+static bool isPrivateDirectory(const char* path)
+{
+    struct stat st;
+    return lstat(path, &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == getuid() && (st.st_mode & (S_IRWXG | S_IRWXO)) == 0;
+}
+
+//Without XDG_RUNTIME_DIR the socket lives in a directory in /tmp, which the daemon creates
+static bool getSocketAddress(struct sockaddr_un* address, bool create)
+{
+    address->sun_family = AF_UNIX;
+
+    char directory[sizeof(address->sun_path)];
+    const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+    int length;
+    if(runtimeDir != NULL && *runtimeDir != '\0')
+        length = snprintf(directory, sizeof(directory), "%s", runtimeDir);
+    else
+    {
+        length = snprintf(directory, sizeof(directory), "/tmp/fastfetch-%u", (unsigned) getuid());
+        if(create && length > 0 && (size_t) length < sizeof(directory))
+            mkdir(directory, S_IRWXU);
+    }
+
+    if(length <= 0 || (size_t) length >= sizeof(directory) || !isPrivateDirectory(directory))
+        return false;
+
+    length = snprintf(address->sun_path, sizeof(address->sun_path), "%s/fastfetch.sock", directory);
+    return length > 0 && (size_t) length < sizeof(address->sun_path);
+}
+
+//The other side of a socket must be our own user, the daemon or a client. Anything else must not get the environment or write to the terminal
+static bool isPeerOwnUser(int sock)
+{
+    struct ucred credentials;
+    socklen_t credentialsLength = sizeof(credentials);
+    return getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsLength) == 0 && credentials.uid == getuid();
+}
+
+static bool writeAll(int fd, const char* data, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+
+        data += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+//The request is "ppid\0cwd\0", the arguments and the environment, each a list of null terminated strings ended by an empty one
+static bool runClient(int argc, const char** argv)
+{
+    struct sockaddr_un address = {0};
+    if(!getSocketAddress(&address, false))
+        return false;
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sock < 0)
+        return false;
+
+    if(connect(sock, (struct sockaddr*) &address, sizeof(address)) != 0 || !isPeerOwnUser(sock))
+    {
+        close(sock);
+        return false;
+    }
+
+    FFstrbuf request;
+    ffStrbufInitA(&request, 4096);
+
+    ffStrbufAppendF(&request, "%i", (int) getppid());
+    ffStrbufAppendC(&request, '\0');
+
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) != NULL)
+        ffStrbufAppendS(&request, cwd);
+    ffStrbufAppendC(&request, '\0');
+
+    for(int i = 2; i < argc; i++)
+    {
+        ffStrbufAppendS(&request, argv[i]);
+        ffStrbufAppendC(&request, '\0');
+    }
+    ffStrbufAppendC(&request, '\0');
+
+    extern char** environ;
+    for(char** env = environ; *env != NULL; ++env)
+    {
+        ffStrbufAppendS(&request, *env);
+        ffStrbufAppendC(&request, '\0');
+    }
+    ffStrbufAppendC(&request, '\0');
+
+    bool sent = writeAll(sock, request.chars, request.length);
+    ffStrbufDestroy(&request);
+
+    if(!sent)
+    {
+        close(sock);
+        return false;
+    }
+
+    shutdown(sock, SHUT_WR);
+
+    char buffer[4096];
+    ssize_t readed;
+    while((readed = read(sock, buffer, sizeof(buffer))) > 0 || (readed < 0 && errno == EINTR))
+    {
+        if(readed > 0 && !writeAll(STDOUT_FILENO, buffer, (size_t) readed))
+            break;
+    }
+
+    close(sock);
+    return true;
+}
+
+static bool readRequest(int fd, FFstrbuf* request)
+{
+    while(true)
+    {
+        ffStrbufEnsureFree(request, 4096);
+        ssize_t readed = read(fd, request->chars + request->length, request->allocated - request->length - 1);
+
+        if(readed == 0)
+            break;
+
+        if(readed < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+
+        request->length += (uint32_t) readed;
+    }
+
+    request->chars[request->length] = '\0';
+
+    //ppid, cwd and the terminators of the argument and environment lists
+    uint32_t numNulls = 0;
+    for(uint32_t i = 0; i < request->length; ++i)
+    {
+        if(request->chars[i] == '\0')
+            ++numNulls;
+    }
+    return numNulls >= 4 && request->chars[request->length - 1] == '\0' && request->chars[request->length - 2] == '\0';
+}
+
+//Runs in the forked child, the output goes directly to the client
+static void serveClient(FFinstance* instance, FFdata* data, int conn)
+{
+    //The daemon ignores SIGCHLD to reap its children, but we need waitpid to work for the commands we run
+    signal(SIGCHLD, SIG_DFL);
+
+    FFstrbuf request;
+    ffStrbufInitA(&request, 4096);
+    if(!readRequest(conn, &request))
+        exit(1);
+
+    dup2(conn, STDOUT_FILENO);
+    dup2(conn, STDERR_FILENO);
+    close(conn);
+
+    const char* current = request.chars;
+
+    instance->state.ppid = (pid_t) strtol(current, NULL, 10);
+    current += strlen(current) + 1;
+
+    if(*current != '\0' && chdir(current) != 0)
+        fprintf(stderr, "Warning: couldn't change into client working directory %s\n", current);
+    current += strlen(current) + 1;
+
+    FFlist arguments;
+    ffListInitA(&arguments, sizeof(const char*), 16);
+    *(const char**) ffListAdd(&arguments) = "fastfetch";
+    for(; *current != '\0'; current += strlen(current) + 1)
+        *(const char**) ffListAdd(&arguments) = current;
+    ++current;
+
+    //Everything reading the environment must see the one of the client, e.g. XDG_CURRENT_DESKTOP or TERM
+    clearenv();
+    for(; *current != '\0'; current += strlen(current) + 1)
+        putenv((char*) current);
+
+    sysinfo(&instance->state.sysinfo);
+
+    parseArguments(instance, data, (int) arguments.length, (const char**) arguments.data);
+
+    //The cache file mapped at the start of the daemon was likely replaced by other runs since
+    ffCacheRelease();
+    ffCacheValidate(instance);
+
+    applyData(instance, data);
+    run(instance, data);
+
+    exit(0);
+}
+
+//Nobody listens on it anymore. Connecting succeeds while a daemon still runs
+static bool isSocketStale(const struct sockaddr_un* address)
+{
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sock < 0)
+        return false;
+
+    bool stale = connect(sock, (const struct sockaddr*) address, sizeof(*address)) != 0 && errno == ECONNREFUSED;
+    close(sock);
+    return stale;
+}
+
+//Loading the libraries the detectors dlopen is most of the time of a cached run. The daemon keeps them loaded,
+//so the dlopen of a forked client only finds them mapped already. A client that names another library with --lib-* still loads its own
+static void preloadLibraries(FFinstance* instance)
+{
+    const struct
+    {
+        const FFstrbuf* user;
+        const char* fallback;
+    } libraries[] = {
+        {&instance->config.libX11, "libX11.so"},
+        {&instance->config.libXrandr, "libXrandr.so"},
+        {&instance->config.libWayland, "libwayland-client.so"},
+        {&instance->config.libGIO, "libgio-2.0.so"},
+        {&instance->config.libDConf, "libdconf.so"},
+        {&instance->config.libXFConf, "libxfconf-0.so"},
+        {&instance->config.libSQLite, "libsqlite3.so"}
+    };
+
+    //The handles are never closed, a client only drops the reference of its own dlopen
+    for(uint32_t i = 0; i < sizeof(libraries) / sizeof(libraries[0]); i++)
+        dlopen(libraries[i].user->length == 0 ? libraries[i].fallback : libraries[i].user->chars, RTLD_LAZY);
+}
+
+static void runDaemon(FFinstance* instance, FFdata* data)
+{
+    //Detection results are not kept. They depend on client options (e.g. --sysroot or --recache) and on files that change while the daemon runs,
+    //and those of modules that rarely change are read from the fingerprinted cache, which every client maps again
+    preloadLibraries(instance);
+
+    struct sockaddr_un address = {0};
+    if(!getSocketAddress(&address, true))
+    {
+        fputs("Error: couldn't get a socket path in a directory only we can access\n", stderr);
+        exit(478);
+    }
+
+    //Only the socket of a daemon that is gone is replaced
+    struct stat st;
+    if(lstat(address.sun_path, &st) == 0)
+    {
+        if(!S_ISSOCK(st.st_mode) || st.st_uid != getuid() || !isSocketStale(&address))
+        {
+            fprintf(stderr, "Error: %s exists and is not the socket of a stopped daemon\n", address.sun_path);
+            exit(478);
+        }
+        unlink(address.sun_path);
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(
+        sock < 0 ||
+        bind(sock, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+        chmod(address.sun_path, S_IRUSR | S_IWUSR) != 0 ||
+        listen(sock, 16) != 0
+    ) {
+        fprintf(stderr, "Error: couldn't listen on %s: %s\n", address.sun_path, strerror(errno));
+        exit(478);
+    }
+
+    signal(SIGCHLD, SIG_IGN);
+    fflush(stdout);
+    fflush(stderr);
+
+    while(true)
+    {
+        int conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+        if(conn < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            fprintf(stderr, "Error: couldn't accept connection: %s\n", strerror(errno));
+            exit(479);
+        }
+
+        if(!isPeerOwnUser(conn))
+        {
+            close(conn);
+            continue;
+        }
+
+        if(fork() == 0)
+        {
+            close(sock);
+            serveClient(instance, data, conn);
+        }
+
+        close(conn);
+    }
+}
+
+typedef struct FFsysrootjob
+{
+    const char* sysroot; //Points into the list
+    pid_t pid;
+    int fd; //Of the pipe the worker prints into, -1 once the worker is done
+    FFstrbuf output;
+} FFsysrootjob;
+
+static void startSysrootJob(FFinstance* instance, FFdata* data, FFsysrootjob* job)
+{
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC) != 0)
+    {
+        fprintf(stderr, "Error: couldn't create pipe: %s\n", strerror(errno));
+        exit(484);
+    }
+
+    job->pid = fork();
+    if(job->pid == 0)
+    {
+        //A worker is a normal run, which prints into the pipe
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        ffStrbufSetS(&data->sysroot, job->sysroot);
+        applyData(instance, data);
+        run(instance, data);
+        exit(0);
+    }
+
+    if(job->pid < 0)
+    {
+        fprintf(stderr, "Error: couldn't fork: %s\n", strerror(errno));
+        exit(484);
+    }
+
+    close(fds[1]);
+    job->fd = fds[0];
+    ffStrbufInitA(&job->output, 4096);
+}
+
+//Returns false once the worker closed the pipe
+static bool readSysrootJob(FFsysrootjob* job)
+{
+    ffStrbufEnsureFree(&job->output, 4096);
+    ssize_t readed = read(job->fd, job->output.chars + job->output.length, 4096);
+    if(readed < 0 && (errno == EINTR || errno == EAGAIN))
+        return true;
+
+    if(readed <= 0)
+        return false;
+
+    job->output.length += (uint32_t) readed;
+    job->output.chars[job->output.length] = '\0';
+    return true;
+}
+
+//Every sysroot is fetched by its own forked worker, as detection results and the sysroot are global to the process.
+//At most one worker per core runs at a time.
+static void runSysrootBatch(FFinstance* instance, FFdata* data)
+{
+    FFstrbuf list;
+    ffStrbufInitA(&list, 4096);
+    if(ffStrbufCompS(&data->sysrootBatch, "-") == 0)
+        ffAppendFDContent(STDIN_FILENO, &list);
+    else if(!ffAppendFileContent(data->sysrootBatch.chars, &list))
+    {
+        fprintf(stderr, "Error: couldn't read sysroot list %s\n", data->sysrootBatch.chars);
+        exit(483);
+    }
+
+    //One sysroot per line, empty lines and lines starting with # are ignored
+    FFlist jobs;
+    ffListInitA(&jobs, sizeof(FFsysrootjob), 64);
+    for(char* line = strtok(list.chars, "\n"); line != NULL; line = strtok(NULL, "\n"))
+    {
+        while(*line == ' ' || *line == '\t')
+            ++line;
+
+        char* end = line + strlen(line);
+        while(end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            *--end = '\0';
+
+        if(*line != '\0' && *line != '#')
+            ((FFsysrootjob*) ffListAdd(&jobs))->sysroot = line;
+    }
+
+    uint32_t maxRunning = (uint32_t) get_nprocs();
+    if(maxRunning < 1)
+        maxRunning = 1;
+
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * maxRunning);
+    uint32_t* fdJobs = malloc(sizeof(uint32_t) * maxRunning);
+
+    uint32_t started = 0;
+    uint32_t printed = 0;
+    uint32_t running = 0;
+    bool failed = false;
+
+    while(printed < jobs.length)
+    {
+        for(; running < maxRunning && started < jobs.length; ++running, ++started)
+            startSysrootJob(instance, data, ffListGet(&jobs, started));
+
+        nfds_t numFds = 0;
+        for(uint32_t i = printed; i < started; ++i)
+        {
+            FFsysrootjob* job = ffListGet(&jobs, i);
+            if(job->fd == -1)
+                continue;
+
+            fds[numFds].fd = job->fd;
+            fds[numFds].events = POLLIN;
+            fdJobs[numFds] = i;
+            ++numFds;
+        }
+
+        if(poll(fds, numFds, -1) < 0 && errno != EINTR)
+        {
+            fprintf(stderr, "Error: couldn't poll workers: %s\n", strerror(errno));
+            exit(485);
+        }
+
+        for(nfds_t i = 0; i < numFds; ++i)
+        {
+            FFsysrootjob* job = ffListGet(&jobs, fdJobs[i]);
+            if(fds[i].revents == 0 || readSysrootJob(job))
+                continue;
+
+            close(job->fd);
+            job->fd = -1;
+            --running;
+
+            int status;
+            failed |= waitpid(job->pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+
+        //The results are printed in the order of the list, so a slow sysroot holds back the ones after it
+        for(; printed < started; ++printed)
+        {
+            FFsysrootjob* job = ffListGet(&jobs, printed);
+            if(job->fd != -1)
+                break;
+
+            //JSON names the sysroot in the document of each worker instead
+            if(instance->config.outputFormat == FF_OUTPUT_FORMAT_TEXT)
+                printf("%s==> %s <==\n", printed > 0 ? "\n" : "", job->sysroot);
+
+            ffOutputWrite(&job->output);
+            ffStrbufDestroy(&job->output);
+        }
+    }
+
+    free(fds);
+    free(fdJobs);
+
+    //The error of a sysroot that failed was already printed by its worker
+    exit(failed ? 1 : 0);
 }
 
 int main(int argc, const char** argv)
 {
+    //Connecting to a running daemon must be as cheap as possible, so this happens before any initialization
+    if(argc > 1 && strcasecmp(argv[1], "--client") == 0 && runClient(argc, argv))
+        return 0;
+
     FFinstance instance;
     ffInitInstance(&instance);
 
@@ -1111,6 +2236,14 @@ int main(int argc, const char** argv)
 
     parseDefaultConfigFile(&instance, &data);
     parseArguments(&instance, &data, argc, argv);
+
+    //The daemon applies the data per client, as the logo and its color depend on client options
+    if(data.daemon)
+        runDaemon(&instance, &data);
+
+    if(data.sysrootBatch.length > 0)
+        runSysrootBatch(&instance, &data);
+
     applyData(&instance, &data); //Here we do things that need to be done after parsing all options
 
     run(&instance, &data);
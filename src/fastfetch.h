@@ -10,6 +10,9 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <pwd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/statvfs.h>
 #include <sys/utsname.h>
 #include <sys/sysinfo.h>
 
@@ -17,6 +20,9 @@
 
 #include "util/FFstrbuf.h"
 #include "util/FFlist.h"
+#include "util/FFarena.h"
+
+#define FASTFETCH_DEFAULT_STRUCTURE "Title:Separator:OS:Host:Kernel:Uptime:Packages:Shell:Resolution:DE:WM:WMTheme:Theme:Icons:Font:Cursor:Terminal:TerminalFont:CPU:GPU:Memory:Disk:Battery:Locale:Break:Colors"
 
 #define UNUSED(...) (void)(__VA_ARGS__)
 
@@ -24,6 +30,27 @@
 #define FASTFETCH_TEXT_MODIFIER_ERROR "\033[1;31m"
 #define FASTFETCH_TEXT_MODIFIER_RESET "\033[0m"
 
+typedef struct FFlogoline
+{
+    uint32_t offset; // into compiledChars
+    uint32_t length;
+} FFlogoline;
+
+typedef struct FFformat
+{
+    const FFstrbuf* source; // the config field it was compiled from
+    FFstrbuf sourceCopy; // to tell if the field was changed since
+    FFstrbuf literals; // text the ops append
+    FFlist ops; // list of FFformatop, see format.c
+} FFformat;
+
+typedef enum FFoutputformat
+{
+    FF_OUTPUT_FORMAT_TEXT,
+    FF_OUTPUT_FORMAT_JSON, // one object with a member per module
+    FF_OUTPUT_FORMAT_NDJSON // one object per module and line, written as the modules are done
+} FFoutputformat;
+
 typedef struct FFconfig
 {
     struct
@@ -31,7 +58,12 @@ typedef struct FFconfig
         char* lines;
         const char* colors[9]; // colors[0] is used as key color
         bool freeable;
-        bool allLinesSameLength; // a performance optimization
+
+        // lines with colors and spacing already applied, built on first print
+        bool compiled;
+        FFstrbuf compiledChars;
+        FFlist compiledLines; // list of FFlogoline
+        uint32_t currentLine;
     } logo;
 
     uint16_t logoKeySpacing;
@@ -46,6 +78,10 @@ typedef struct FFconfig
     bool allowSlowOperations;
     bool disableLinewrap;
     bool hideCursor;
+    bool stat;
+    FFstrbuf traceFile;
+    FFstrbuf timeoutPlaceholder;
+    FFoutputformat outputFormat;
 
     FFstrbuf osFormat;
     FFstrbuf osKey;
@@ -92,7 +128,8 @@ typedef struct FFconfig
     FFstrbuf localeFormat;
     FFstrbuf localeKey;
 
-    FFstrbuf libPCI;
+    FFlist formats; // list of FFformat, the custom formats and keys compiled once by ffFormatCompile
+
     FFstrbuf libX11;
     FFstrbuf libXrandr;
     FFstrbuf libWayland;
@@ -105,6 +142,8 @@ typedef struct FFconfig
 
     FFstrbuf batteryDir;
 
+    FFstrbuf pciIds;
+
 } FFconfig;
 
 typedef struct FFstate
@@ -114,6 +153,7 @@ typedef struct FFstate
     struct passwd* passwd;
     struct utsname utsname;
     struct sysinfo sysinfo;
+    pid_t ppid; //Where terminal and shell detection starts. Differs from getppid() when serving a daemon client
 
     FFlist configDirs;
     FFstrbuf cacheDir;
@@ -123,8 +163,15 @@ typedef struct FFinstance
 {
     FFconfig config;
     FFstate state;
+    FFarena arena; //Holds everything of a run, released by ffFinish
 } FFinstance;
 
+typedef struct FFjsonwriter
+{
+    FFstrbuf* buffer;
+    bool needsComma; //A value was already written in the current object or array
+} FFjsonwriter;
+
 typedef struct FFTitleResult
 {
     FFstrbuf userName;
@@ -148,6 +195,121 @@ typedef struct FFOSResult
     FFstrbuf error;
 } FFOSResult;
 
+typedef struct FFHostResult
+{
+    FFstrbuf family;
+    FFstrbuf name;
+    FFstrbuf version;
+    bool familySet;
+    bool nameSet;
+    bool versionSet;
+    FFstrbuf error;
+} FFHostResult;
+
+typedef struct FFCPUResult
+{
+    FFstrbuf name;
+    FFstrbuf namePretty;
+    FFstrbuf vendor;
+    int numProcsOnline;
+    int numProcsAvailable;
+    int physicalCores;
+    int numProcs;
+    double biosLimit;
+    double scalingMaxFreq;
+    double scalingMinFreq;
+    double infoMaxFreq;
+    double infoMinFreq;
+    double procGhz;
+    double ghz;
+    FFstrbuf error;
+} FFCPUResult;
+
+typedef struct FFGPU
+{
+    FFstrbuf vendor;
+    const char* vendorPretty; //Either a static string or vendor.chars
+    FFstrbuf name;
+    FFstrbuf namePretty;
+} FFGPU;
+
+typedef struct FFGPUResult
+{
+    FFlist gpus; //List of FFGPU
+    FFstrbuf error;
+} FFGPUResult;
+
+typedef struct FFPackagesResult
+{
+    uint32_t all;
+    uint32_t pacman;
+    uint32_t dpkg;
+    uint32_t rpm;
+    uint32_t xbps;
+    uint32_t flatpak;
+    uint32_t snap;
+    FFstrbuf manjaroBranch;
+} FFPackagesResult;
+
+typedef struct FFMemoryResult
+{
+    uint32_t used;
+    uint32_t total;
+    uint8_t percentage;
+    FFstrbuf error;
+} FFMemoryResult;
+
+typedef struct FFDisk
+{
+    FFstrbuf folder;
+    uint32_t used;
+    uint32_t total;
+    uint32_t files;
+    uint8_t percentage;
+    FFstrbuf error;
+} FFDisk;
+
+typedef struct FFDiskResult
+{
+    FFlist disks; //List of FFDisk
+    FFstrbuf error;
+} FFDiskResult;
+
+typedef struct FFBattery
+{
+    FFstrbuf dir;
+    FFstrbuf manufacturer;
+    FFstrbuf model;
+    FFstrbuf technology;
+    FFstrbuf capacity;
+    FFstrbuf status;
+} FFBattery;
+
+typedef struct FFBatteryResult
+{
+    FFlist batteries; //List of FFBattery
+    FFstrbuf error;
+} FFBatteryResult;
+
+typedef struct FFResolution
+{
+    int width;
+    int height;
+    int refreshRate;
+} FFResolution;
+
+typedef struct FFResolutionResult
+{
+    FFlist resolutions; //List of FFResolution
+    FFstrbuf error;
+} FFResolutionResult;
+
+typedef struct FFLocaleResult
+{
+    FFstrbuf locale;
+    FFstrbuf error;
+} FFLocaleResult;
+
 typedef struct FFPlasmaResult
 {
     FFstrbuf widgetStyle;
@@ -212,10 +374,27 @@ typedef struct FFformatarg
 
 typedef struct FFcache
 {
-    FILE* value;
-    FILE* split;
+    const char* moduleName;
+    FFstrbuf value;
+    FFstrbuf split;
+    uint64_t fingerprint; //Of the inputs when the module was first looked up in the cache
+    bool save; //cacheSave when it was opened
 } FFcache;
 
+typedef struct FFpciids
+{
+    const char* data; //The index, NULL if there is no pci.ids
+    size_t size;
+    bool mapped; //Else data is built.chars
+    FFstrbuf built;
+} FFpciids;
+
+typedef struct FFoutputcapture
+{
+    FFstrbuf buffer;
+    FFlist logoLines; //uint32_t offsets into buffer at which a logo line must be printed
+} FFoutputcapture;
+
 typedef enum FFvarianttype
 {
     FF_VARIANT_TYPE_STRING,
@@ -242,6 +421,11 @@ typedef struct FFfont
     FFlist styles;
 } FFfont;
 
+typedef void(*FFtaskfunc)(FFinstance* instance);
+
+#define FF_TASK_MAX 64
+#define FF_TASK_INVALID FF_TASK_MAX
+
 typedef struct FFpropquery
 {
     const char* start;
@@ -254,11 +438,18 @@ typedef struct FFpropquery
 
 //common/init.c
 void ffInitInstance(FFinstance* instance);
+bool ffDetectionInit(FFinstance* instance, void** result, size_t size, uint32_t* generation);
 void ffStart(FFinstance* instance);
 void ffFinish(FFinstance* instance);
 
 //common/threading.c
 void ffStartDetectionThreads(FFinstance* instance);
+void ffPrefetchStructure(FFinstance* instance, const char* structure);
+void ffPrefetchWait(const char* moduleName);
+bool ffFinishDetectionThreads(FFinstance* instance);
+uint32_t ffTaskAdd(FFtaskfunc func, uint64_t dependencies);
+void ffTaskWait(uint32_t id);
+bool ffPrintWithTimeout(FFinstance* instance, FFtaskfunc print, uint32_t timeoutMs);
 
 //common/io.c
 void ffPrintLogoAndKey(FFinstance* instance, const char* moduleName, uint8_t moduleIndex, const FFstrbuf* customKeyFormat);
@@ -267,13 +458,24 @@ void ffPrintFormatString(FFinstance* instance, const char* moduleName, uint8_t m
 void ffGetCacheFilePath(FFinstance* instance, const char* moduleName, const char* extension, FFstrbuf* buffer);
 void ffReadCacheFile(FFinstance* instance, const char* moduleName, const char* extension, FFstrbuf* buffer);
 void ffWriteCacheFile(FFinstance* instance, const char* moduleName, const char* extension, FFstrbuf* content);
+bool ffPrintLastCached(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat);
 bool ffPrintFromCache(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFstrbuf* formatString, uint32_t numArgs);
 void ffPrintAndSaveToCache(FFinstance* instance, const char* moduleName, const FFstrbuf* customKeyFormat, const FFstrbuf* value, const FFstrbuf* formatString, uint32_t numArgs, const FFformatarg* arguments);
 void ffPrintAndAppendToCache(FFinstance* instance, const char* moduleName, uint8_t moduleIndex, const FFstrbuf* customKeyFormat, FFcache* cache, const FFstrbuf* value, const FFstrbuf* formatString, uint32_t numArgs, const FFformatarg* arguments);
 
 void ffCacheValidate(FFinstance* instance);
+bool ffCacheExists(FFinstance* instance, const char* moduleName);
+bool ffCacheGetValue(FFinstance* instance, const char* moduleName, FFstrbuf* value);
 void ffCacheOpenWrite(FFinstance* instance, const char* moduleName, FFcache* cache);
 void ffCacheClose(FFcache* cache);
+void ffCacheFlush(FFinstance* instance);
+void ffCacheRelease();
+bool ffCacheGetValueFingerprinted(FFinstance* instance, const char* name, uint64_t fingerprint, FFstrbuf* value);
+void ffCacheSetValueFingerprinted(FFinstance* instance, const char* name, uint64_t fingerprint, const FFstrbuf* value);
+
+#define FF_CACHE_FINGERPRINT_INIT 14695981039346656037ULL
+uint64_t ffCacheFingerprintAppend(uint64_t hash, const void* data, size_t length);
+uint64_t ffCacheFingerprintAppendStat(uint64_t hash, const char* path);
 
 void ffAppendFDContent(int fd, FFstrbuf* buffer);
 bool ffAppendFileContent(const char* fileName, FFstrbuf* buffer); //returns true if open() succeeds. This is used to differentiate between <file not found> and <empty file>
@@ -285,14 +487,107 @@ void ffWriteFileContent(const char* fileName, const FFstrbuf* buffer);
 // Buffers which already contain content are not overwritten
 // The last occurence of start in the first file will be the one used
 bool ffParsePropFileValues(const char* filename, uint32_t numQueries, FFpropquery* queries);
+// Uses the first occurence instead and stops reading as soon as every query has a value
+bool ffParsePropFileValuesFirst(const char* filename, uint32_t numQueries, FFpropquery* queries);
 bool ffParsePropFile(const char* filename, const char* start, FFstrbuf* buffer);
 bool ffParsePropFileHomeValues(FFinstance* instance, const char* relativeFile, uint32_t numQueries, FFpropquery* queries);
 bool ffParsePropFileHome(FFinstance* instance, const char* relativeFile, const char* start, FFstrbuf* buffer);
 bool ffParsePropFileConfigValues(FFinstance* instance, const char* relativeFile, uint32_t numQueries, FFpropquery* queries);
 bool ffParsePropFileConfig(FFinstance* instance, const char* relativeFile, const char* start, FFstrbuf* buffer);
 
+//common/sysroot.c
+bool ffSysrootSet(const char* path);
+const char* ffSysrootGet();
+int ffSysrootOpen(const char* path, int flags);
+DIR* ffSysrootOpenDir(const char* path);
+FILE* ffSysrootOpenFile(const char* path);
+bool ffSysrootAccess(const char* path, int mode);
+int ffSysrootStatvfs(const char* path, struct statvfs* fs);
+void ffSysrootAppendPath(FFstrbuf* buffer, const char* path);
+
+//common/pciids.c
+uint64_t ffPciidsFingerprint(FFinstance* instance);
+void ffPciidsOpen(FFinstance* instance, FFpciids* ids);
+const char* ffPciidsGetVendor(const FFpciids* ids, uint16_t vendor);
+const char* ffPciidsGetDevice(const FFpciids* ids, uint16_t vendor, uint16_t device);
+void ffPciidsClose(FFpciids* ids);
+
+//common/output.c
+void ffOutputAddSlot();
+void ffOutputAppend(const FFstrbuf* value);
+void ffOutputAppendS(const char* value);
+void ffOutputAppendNS(uint32_t length, const char* value);
+void ffOutputAppendC(char c);
+void ffOutputAppendNC(uint32_t num, char c);
+void ffOutputAppendUInt(uint64_t value);
+void ffOutputAppendInt(int64_t value);
+void ffOutputAppendF(const char* format, ...);
+void ffOutputPut(const FFstrbuf* value);
+void ffOutputPutS(const char* value);
+void ffOutputFlush();
+void ffOutputWrite(const FFstrbuf* buffer);
+void ffOutputCaptureBegin(FFoutputcapture* target);
+void ffOutputCaptureEnd();
+bool ffOutputCaptureLogoLine();
+void ffOutputAppendCapture(FFinstance* instance, const FFoutputcapture* source);
+void ffOutputCaptureDestroy(FFoutputcapture* target);
+
+//common/trace.c
+extern bool ffTraceEnabled;
+uint64_t ffTraceNow();
+void ffTraceEnable();
+void ffTraceRecord(const char* category, const char* name, uint64_t begin);
+void* ffTraceDlopen(const char* fileName, int mode);
+void ffTraceFlush(FFinstance* instance);
+
+//A disabled trace costs one branch per traced call
+#define FF_TRACE_BEGIN(variable) uint64_t variable = ffTraceEnabled ? ffTraceNow() : 0
+#define FF_TRACE_END(variable, category, name) if(variable != 0) ffTraceRecord(category, name, variable)
+
+//common/json.c
+void ffJsonAppendString(FFstrbuf* buffer, const char* value);
+void ffJsonWriterInit(FFjsonwriter* writer, FFstrbuf* buffer);
+void ffJsonBeginObject(FFjsonwriter* writer, const char* key); //key is NULL for array elements and the top level
+void ffJsonEndObject(FFjsonwriter* writer);
+void ffJsonBeginArray(FFjsonwriter* writer, const char* key);
+void ffJsonEndArray(FFjsonwriter* writer);
+void ffJsonString(FFjsonwriter* writer, const char* key, const char* value); //NULL is written as null
+void ffJsonStrbuf(FFjsonwriter* writer, const char* key, const FFstrbuf* value);
+void ffJsonUInt(FFjsonwriter* writer, const char* key, uint64_t value);
+void ffJsonInt(FFjsonwriter* writer, const char* key, int64_t value);
+void ffJsonDouble(FFjsonwriter* writer, const char* key, double value);
+void ffJsonBool(FFjsonwriter* writer, const char* key, bool value);
+
 //common/processing.c
+#define FF_PROCESS_DEFAULT_TIMEOUT_MS 5000
+
+typedef struct FFprocessgroup
+{
+    FFlist processes;
+    FFinstance* cacheInstance; //If set, outputs are cached, keyed on the arguments and the executables
+} FFprocessgroup;
+
+void ffProcessResolveExecutable(const char* name, FFstrbuf* path);
+void ffProcessGroupInit(FFprocessgroup* group, FFinstance* cacheInstance);
+// executable is what the output of a cached command depends on, if that isn't argv[0], e.g. the shell run by env. Best given with its full path
+bool ffProcessGroupSpawn(FFprocessgroup* group, FFstrbuf* buffer, char* const argv[], const char* executable, uint32_t timeoutMs);
+void ffProcessGroupWait(FFprocessgroup* group);
 void ffProcessAppendStdOut(FFstrbuf* buffer, char* const argv[]);
+void ffProcessAppendStdOutCached(FFinstance* instance, FFstrbuf* buffer, char* const argv[]); //Only for output that depends on nothing but the executable, like versions
+
+//common/processes.c
+#define FF_PROCESS_COMM_LENGTH 16 //TASK_COMM_LEN, the kernel truncates longer names
+
+typedef struct FFprocessentry
+{
+    pid_t pid;
+    pid_t ppid;
+    char comm[FF_PROCESS_COMM_LENGTH];
+} FFprocessentry;
+
+const FFlist* ffProcessTableGet(FFinstance* instance); //Processes of the current user, sorted by pid
+bool ffProcessTableFind(FFinstance* instance, pid_t pid, FFprocessentry* entry);
+void ffProcessGetCmdlineName(pid_t pid, FFstrbuf* name);
 
 //common/logo.c
 void ffLoadLogoSet(FFinstance* instance, const char* logo);
@@ -307,7 +602,8 @@ void ffPrintRemainingLogo(FFinstance* instance);
 
 //common/format.c
 void ffFormatAppendFormatArg(FFstrbuf* buffer, const FFformatarg* formatarg);
-void ffParseFormatString(FFstrbuf* buffer, const FFstrbuf* formatstr, const FFstrbuf* error, uint32_t numArgs, const FFformatarg* arguments);
+void ffFormatCompile(FFinstance* instance, const FFstrbuf* formatstr);
+void ffParseFormatString(FFinstance* instance, FFstrbuf* buffer, const FFstrbuf* formatstr, const FFstrbuf* error, uint32_t numArgs, const FFformatarg* arguments);
 
 //common/parsing.c
 void ffGetGtkPretty(FFstrbuf* buffer, const FFstrbuf* gtk2, const FFstrbuf* gtk3, const FFstrbuf* gtk4);
@@ -319,6 +615,9 @@ void ffFontDestroy(FFfont* font);
 
 bool ffGetPropValue(const char* line, const char* start, FFstrbuf* buffer);
 bool ffGetPropValueFromLines(const char* lines, const char* start, FFstrbuf* buffer);
+// Matches every line against all queries whose bit is set in searched. Returns the queries that are still searched.
+// With firstOccurrence a query is done once it matched, otherwise later occurences replace earlier ones. At most 64 queries are supported
+uint64_t ffGetPropValuesFromLines(const char* lines, uint32_t numQueries, FFpropquery* queries, uint64_t searched, bool firstOccurrence);
 
 void ffParseSemver(FFstrbuf* buffer, const FFstrbuf* major, const FFstrbuf* minor, const FFstrbuf* patch);
 
@@ -351,6 +650,15 @@ const FFTerminalShellResult* ffDetectTerminalShell(FFinstance* instance);
 //Common
 const FFOSResult* ffDetectOS(FFinstance* instance);
 const FFTitleResult* ffDetectTitle(FFinstance* instance);
+const FFHostResult* ffDetectHost(FFinstance* instance);
+const FFPackagesResult* ffDetectPackages(FFinstance* instance);
+const FFResolutionResult* ffDetectResolution(FFinstance* instance);
+const FFCPUResult* ffDetectCPU(FFinstance* instance);
+const FFGPUResult* ffDetectGPU(FFinstance* instance);
+const FFMemoryResult* ffDetectMemory(FFinstance* instance);
+const FFDiskResult* ffDetectDisk(FFinstance* instance);
+const FFBatteryResult* ffDetectBattery(FFinstance* instance);
+const FFLocaleResult* ffDetectLocale(FFinstance* instance);
 
 //Printing
 
@@ -382,4 +690,28 @@ void ffPrintBattery(FFinstance* instance);
 void ffPrintLocale(FFinstance* instance);
 void ffPrintColors(FFinstance* instance);
 
+//JSON, the detection results of a module as members of an object
+
+void ffJsonTitle(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonOS(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonHost(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonKernel(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonUptime(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonPackages(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonShell(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonResolution(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonDesktopEnvironment(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonWM(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonTheme(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonIcons(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonFont(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonCursor(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonTerminal(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonCPU(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonGPU(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonMemory(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonDisk(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonBattery(FFinstance* instance, FFjsonwriter* writer);
+void ffJsonLocale(FFinstance* instance, FFjsonwriter* writer);
+
 #endif
@@ -15,6 +15,7 @@ int main(int argc, char** argv)
 
     //Multithreading --> better performance
     ffStartDetectionThreads(&instance);
+    ffPrefetchStructure(&instance, FASTFETCH_DEFAULT_STRUCTURE);
 
     //Does things like disabling line wrap
     ffStart(&instance);
@@ -2,107 +2,58 @@
 
 #include <unistd.h>
 #include <dirent.h>
+#include <pthread.h>
 
 #define FF_BATTERY_MODULE_NAME "Battery"
 #define FF_BATTERY_NUM_FORMAT_ARGS 5
 
-static void printBattery(FFinstance* instance, FFstrbuf* dir, uint32_t index)
+static void readBatteryFile(FFstrbuf* dir, const char* fileName, FFstrbuf* buffer)
 {
     uint32_t dirLength = dir->length;
 
-    FF_STRBUF_CREATE(manufactor);
-    ffStrbufAppendS(dir, "/manufacturer");
-    ffGetFileContent(dir->chars, &manufactor);
+    ffStrbufInit(buffer);
+    ffStrbufAppendS(dir, fileName);
+    ffGetFileContent(dir->chars, buffer);
     ffStrbufSubstrBefore(dir, dirLength);
+}
 
-    FF_STRBUF_CREATE(model);
-    ffStrbufAppendS(dir, "/model_name");
-    ffGetFileContent(dir->chars, &model);
-    ffStrbufSubstrBefore(dir, dirLength);
-
-    FF_STRBUF_CREATE(technology);
-    ffStrbufAppendS(dir, "/technology");
-    ffGetFileContent(dir->chars, &technology);
-    ffStrbufSubstrBefore(dir, dirLength);
-
-    FF_STRBUF_CREATE(capacity);
-    ffStrbufAppendS(dir, "/capacity");
-    ffGetFileContent(dir->chars, &capacity);
-    ffStrbufSubstrBefore(dir, dirLength);
-
-    FF_STRBUF_CREATE(status);
-    ffStrbufAppendS(dir, "/status");
-    ffGetFileContent(dir->chars, &status);
-    ffStrbufSubstrBefore(dir, dirLength);
-
-    if(ffStrbufIgnCaseCompS(&status, "Unknown") == 0)
-        ffStrbufClear(&status);
-
-    if(capacity.length == 0 && status.length == 0)
-    {
-        ffPrintError(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, "No file in %s could be read or all battery options are disabled", dir->chars);
-        return;
-    }
-
-    if(instance->config.batteryFormat.length == 0)
-    {
-
-        ffPrintLogoAndKey(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey);
-
-        bool showStatus = status.length > 0 && ffStrbufIgnCaseCompS(&status, "Full") != 0;
-
-        if(capacity.length > 0)
-        {
-            ffStrbufWriteTo(&capacity, stdout);
-            putchar('%');
-
-            if(showStatus)
-                fputs(" [", stdout);
-        }
+static void addBattery(FFBatteryResult* result, FFstrbuf* dir)
+{
+    FFBattery* battery = ffListAdd(&result->batteries);
 
-        if(showStatus)
-        {
-            ffStrbufWriteTo(&status, stdout);
+    ffStrbufInitCopy(&battery->dir, dir);
+    readBatteryFile(dir, "/manufacturer", &battery->manufacturer);
+    readBatteryFile(dir, "/model_name", &battery->model);
+    readBatteryFile(dir, "/technology", &battery->technology);
+    readBatteryFile(dir, "/capacity", &battery->capacity);
+    readBatteryFile(dir, "/status", &battery->status);
 
-            if(capacity.length > 0)
-                putchar(']');
-        }
+    if(ffStrbufIgnCaseCompS(&battery->status, "Unknown") == 0)
+        ffStrbufClear(&battery->status);
+}
 
-        putchar('\n');
-    }
-    else
+const FFBatteryResult* ffDetectBattery(FFinstance* instance)
+{
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFBatteryResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
-        ffPrintFormatString(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey, &instance->config.batteryFormat, NULL, FF_BATTERY_NUM_FORMAT_ARGS, (FFformatarg[]){
-            {FF_FORMAT_ARG_TYPE_STRBUF, &manufactor},
-            {FF_FORMAT_ARG_TYPE_STRBUF, &model},
-            {FF_FORMAT_ARG_TYPE_STRBUF, &technology},
-            {FF_FORMAT_ARG_TYPE_STRBUF, &capacity},
-            {FF_FORMAT_ARG_TYPE_STRBUF, &status}
-        });
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
+    FF_TRACE_BEGIN(traceBegin);
 
-    ffStrbufDestroy(&manufactor);
-    ffStrbufDestroy(&model);
-    ffStrbufDestroy(&technology);
-    ffStrbufDestroy(&capacity);
-    ffStrbufDestroy(&status);
-}
+    ffListInitA(&result->batteries, sizeof(FFBattery), 2);
+    ffStrbufInit(&result->error);
 
-void ffPrintBattery(FFinstance* instance)
-{
     FFstrbuf baseDir;
     ffStrbufInitA(&baseDir, 64);
     if(instance->config.batteryDir.length > 0)
     {
         ffStrbufAppend(&baseDir, &instance->config.batteryDir);
 
-        if(baseDir.length == 0)
-        {
-            ffPrintError(instance, FF_BATTERY_MODULE_NAME, 0, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, "custom battery dir is an empty string");
-            ffStrbufDestroy(&baseDir);
-            return;
-        }
-
         if(baseDir.chars[baseDir.length - 1] != '/')
             ffStrbufAppendC(&baseDir, '/');
     }
@@ -111,17 +62,16 @@ void ffPrintBattery(FFinstance* instance)
 
     uint32_t baseDirLength = baseDir.length;
 
-    DIR* dirp = opendir(baseDir.chars);
+    DIR* dirp = ffSysrootOpenDir(baseDir.chars);
     if(dirp == NULL)
     {
-        ffPrintError(instance, FF_BATTERY_MODULE_NAME, 0, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, "opendir(\"%s\") == NULL", baseDir.chars);
+        ffStrbufAppendF(&result->error, "opendir(\"%s\") == NULL", baseDir.chars);
         ffStrbufDestroy(&baseDir);
-        return;
+        FF_TRACE_END(traceBegin, "detect", "Battery");
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
 
-    FFlist dirs;
-    ffListInitA(&dirs, sizeof(FFstrbuf), 4);
-
     struct dirent* entry;
 
     while((entry = readdir(dirp)) != NULL)
@@ -129,33 +79,107 @@ void ffPrintBattery(FFinstance* instance)
         ffStrbufAppendS(&baseDir, entry->d_name);
         ffStrbufAppendS(&baseDir, "/capacity");
 
-        if(access(baseDir.chars, F_OK) == 0)
+        if(ffSysrootAccess(baseDir.chars, F_OK))
         {
-            FFstrbuf* name = ffListAdd(&dirs);
-            ffStrbufInit(name);
-            ffStrbufSetS(name, entry->d_name);
+            ffStrbufSubstrBefore(&baseDir, baseDirLength);
+            ffStrbufAppendS(&baseDir, entry->d_name);
+            addBattery(result, &baseDir);
         }
 
         ffStrbufSubstrBefore(&baseDir, baseDirLength);
     }
 
-    if(dirs.length == 0)
+    closedir(dirp);
+
+    if(result->batteries.length == 0)
+        ffStrbufAppendF(&result->error, "%s doesn't contain any battery folder", baseDir.chars);
+
+    ffStrbufDestroy(&baseDir);
+
+    FF_TRACE_END(traceBegin, "detect", "Battery");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+static void printBattery(FFinstance* instance, const FFBattery* battery, uint8_t index)
+{
+    if(battery->capacity.length == 0 && battery->status.length == 0)
     {
-        ffPrintError(instance, FF_BATTERY_MODULE_NAME, 0, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, "%s doesn't contain any battery folder", baseDir.chars);
-        ffListDestroy(&dirs);
-        ffStrbufDestroy(&baseDir);
+        ffPrintError(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, "No file in %s could be read or all battery options are disabled", battery->dir.chars);
         return;
     }
 
-    for(uint32_t i = 0; i < dirs.length; i++)
+    if(instance->config.batteryFormat.length == 0)
     {
-        FFstrbuf* name = ffListGet(&dirs, i);
-        ffStrbufAppend(&baseDir, name);
-        printBattery(instance, &baseDir, dirs.length == 1 ? 0 : i + 1);
-        ffStrbufSubstrBefore(&baseDir, baseDirLength);
-        ffStrbufDestroy(name);
+
+        ffPrintLogoAndKey(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey);
+
+        bool showStatus = battery->status.length > 0 && ffStrbufIgnCaseCompS(&battery->status, "Full") != 0;
+
+        if(battery->capacity.length > 0)
+        {
+            ffOutputAppend(&battery->capacity);
+            ffOutputAppendC('%');
+
+            if(showStatus)
+                ffOutputAppendS(" [");
+        }
+
+        if(showStatus)
+        {
+            ffOutputAppend(&battery->status);
+
+            if(battery->capacity.length > 0)
+                ffOutputAppendC(']');
+        }
+
+        ffOutputAppendC('\n');
     }
+    else
+    {
+        ffPrintFormatString(instance, FF_BATTERY_MODULE_NAME, index, &instance->config.batteryKey, &instance->config.batteryFormat, NULL, FF_BATTERY_NUM_FORMAT_ARGS, (FFformatarg[]){
+            {FF_FORMAT_ARG_TYPE_STRBUF, &battery->manufacturer},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &battery->model},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &battery->technology},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &battery->capacity},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &battery->status}
+        });
+    }
+}
 
-    ffListDestroy(&dirs);
-    ffStrbufDestroy(&baseDir);
+void ffPrintBattery(FFinstance* instance)
+{
+    const FFBatteryResult* result = ffDetectBattery(instance);
+
+    if(result->error.length > 0)
+    {
+        ffPrintError(instance, FF_BATTERY_MODULE_NAME, 0, &instance->config.batteryKey, &instance->config.batteryFormat, FF_BATTERY_NUM_FORMAT_ARGS, result->error.chars);
+        return;
+    }
+
+    for(uint32_t i = 0; i < result->batteries.length; i++)
+        printBattery(instance, ffListGet(&result->batteries, i), result->batteries.length == 1 ? 0 : (uint8_t) (i + 1));
+}
+
+void ffJsonBattery(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFBatteryResult* result = ffDetectBattery(instance);
+
+    ffJsonBeginArray(writer, "batteries");
+    for(uint32_t i = 0; i < result->batteries.length; i++)
+    {
+        const FFBattery* battery = ffListGet(&result->batteries, i);
+        ffJsonBeginObject(writer, NULL);
+        ffJsonStrbuf(writer, "dir", &battery->dir);
+        ffJsonStrbuf(writer, "manufacturer", &battery->manufacturer);
+        ffJsonStrbuf(writer, "model", &battery->model);
+        ffJsonStrbuf(writer, "technology", &battery->technology);
+        ffJsonStrbuf(writer, "capacity", &battery->capacity);
+        ffJsonStrbuf(writer, "status", &battery->status);
+        ffJsonEndObject(writer);
+    }
+    ffJsonEndArray(writer);
+
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
@@ -3,5 +3,5 @@
 void ffPrintBreak(FFinstance* instance)
 {
     ffPrintLogoLine(instance);
-    putchar('\n');
+    ffOutputAppendC('\n');
 }
@@ -1,6 +1,7 @@
 #include "fastfetch.h"
 
 #include <string.h>
+#include <pthread.h>
 
 #define FF_CPU_MODULE_NAME "CPU"
 #define FF_CPU_NUM_FORMAT_ARGS 14
@@ -34,23 +35,23 @@ static double getGhz(const char* policyFile, const char* cpuFile)
     return herz / 1000.0; //to GHz
 }
 
-void ffPrintCPU(FFinstance* instance)
+const FFCPUResult* ffDetectCPU(FFinstance* instance)
 {
-    if(ffPrintFromCache(instance, FF_CPU_MODULE_NAME, &instance->config.cpuKey, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS))
-        return;
-
-    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
-    if(cpuinfo == NULL)
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFCPUResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
-        ffPrintError(instance, FF_CPU_MODULE_NAME, 0, &instance->config.cpuKey, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS, "fopen(\"/proc/cpuinfo\", \"r\") == NULL");
-        return;
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
+    FF_TRACE_BEGIN(traceBegin);
 
-    FFstrbuf name;
-    ffStrbufInit(&name);
-
-    FFstrbuf vendor;
-    ffStrbufInit(&vendor);
+    ffStrbufInit(&result->name);
+    ffStrbufInitA(&result->namePretty, 64);
+    ffStrbufInit(&result->vendor);
+    ffStrbufInit(&result->error);
 
     FFstrbuf physicalCoresString;
     ffStrbufInit(&physicalCoresString);
@@ -58,76 +59,69 @@ void ffPrintCPU(FFinstance* instance)
     FFstrbuf procGhzString;
     ffStrbufInit(&procGhzString);
 
-    char* line = NULL;
-    size_t len = 0;
-
-    while(getline(&line, &len, cpuinfo) != -1)
-    {
-        ffGetPropValue(line, "model name :", &name);
-        ffGetPropValue(line, "vendor_id :", &vendor);
-        ffGetPropValue(line, "cpu cores :", &physicalCoresString);
-        ffGetPropValue(line, "cpu MHz :", &procGhzString);
-
-        //Stop after the first CPU
-        if(strstr(line, "flags") != NULL)
-            break;
+    //The first occurence of each key belongs to the first CPU, reading stops there
+    if(!ffParsePropFileValuesFirst("/proc/cpuinfo", 4, (FFpropquery[]) {
+        {"model name :", &result->name},
+        {"vendor_id :", &result->vendor},
+        {"cpu cores :", &physicalCoresString},
+        {"cpu MHz :", &procGhzString}
+    })) {
+        ffStrbufAppendS(&result->error, "open(\"/proc/cpuinfo\", O_RDONLY) == -1");
+        ffStrbufDestroy(&physicalCoresString);
+        ffStrbufDestroy(&procGhzString);
+        FF_TRACE_END(traceBegin, "detect", "CPU");
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
 
-    if(line != NULL)
-        free(line);
-
-    fclose(cpuinfo);
-
-    double procGhz = parseHz(&procGhzString) / 1000.0; //to GHz
+    result->procGhz = parseHz(&procGhzString) / 1000.0; //to GHz
     ffStrbufDestroy(&procGhzString);
 
-    double biosLimit      = getGhz("/sys/devices/system/cpu/cpufreq/policy0/bios_limit",       "/sys/devices/system/cpu/cpu0/cpufreq/bios_limit");
-    double scalingMaxFreq = getGhz("/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq", "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq");
-    double scalingMinFreq = getGhz("/sys/devices/system/cpu/cpufreq/policy0/scaling_min_freq", "/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq");
-    double infoMaxFreq    = getGhz("/sys/devices/system/cpu/cpufreq/policy0/cpuinfo_max_freq", "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
-    double infoMinFreq    = getGhz("/sys/devices/system/cpu/cpufreq/policy0/cpuinfo_min_freq", "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_min_freq");
+    result->biosLimit      = getGhz("/sys/devices/system/cpu/cpufreq/policy0/bios_limit",       "/sys/devices/system/cpu/cpu0/cpufreq/bios_limit");
+    result->scalingMaxFreq = getGhz("/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq", "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq");
+    result->scalingMinFreq = getGhz("/sys/devices/system/cpu/cpufreq/policy0/scaling_min_freq", "/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq");
+    result->infoMaxFreq    = getGhz("/sys/devices/system/cpu/cpufreq/policy0/cpuinfo_max_freq", "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
+    result->infoMinFreq    = getGhz("/sys/devices/system/cpu/cpufreq/policy0/cpuinfo_min_freq", "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_min_freq");
 
-    int numProcsOnline = get_nprocs();
-    int numProcsAvailable = get_nprocs_conf();
+    result->numProcsOnline = get_nprocs();
+    result->numProcsAvailable = get_nprocs_conf();
 
-    int physicalCores = 1;
-    sscanf(physicalCoresString.chars, "%i", &physicalCores);
+    result->physicalCores = 1;
+    sscanf(physicalCoresString.chars, "%i", &result->physicalCores);
     ffStrbufDestroy(&physicalCoresString);
 
     //The current get_nprocs* returns 1 on failure. It also makes no sense to have a (1) as count
-    int numProcs = numProcsOnline;
-    if(numProcs <= 1)
-        numProcs = numProcsAvailable;
-    if(numProcs <= 1)
-        numProcs = physicalCores;
-
-    double ghz = biosLimit;
-    if(ghz == 0)
-        ghz = scalingMaxFreq;
-    if(ghz == 0)
-        ghz = infoMaxFreq;
-    if(ghz == 0)
-        ghz = procGhz;
-    if(ghz == 0)
-        ghz = scalingMinFreq;
-    if(ghz == 0)
-        ghz = infoMinFreq;
+    result->numProcs = result->numProcsOnline;
+    if(result->numProcs <= 1)
+        result->numProcs = result->numProcsAvailable;
+    if(result->numProcs <= 1)
+        result->numProcs = result->physicalCores;
+
+    result->ghz = result->biosLimit;
+    if(result->ghz == 0)
+        result->ghz = result->scalingMaxFreq;
+    if(result->ghz == 0)
+        result->ghz = result->infoMaxFreq;
+    if(result->ghz == 0)
+        result->ghz = result->procGhz;
+    if(result->ghz == 0)
+        result->ghz = result->scalingMinFreq;
+    if(result->ghz == 0)
+        result->ghz = result->infoMinFreq;
 
     if(
-        name.length == 0 &&
-        vendor.length == 0 &&
-        numProcs <= 1 &&
-        ghz <= 0
+        result->name.length == 0 &&
+        result->vendor.length == 0 &&
+        result->numProcs <= 1 &&
+        result->ghz <= 0
     ) {
-        ffStrbufDestroy(&name);
-        ffStrbufDestroy(&vendor);
-        ffPrintError(instance, FF_CPU_MODULE_NAME, 0, &instance->config.cpuKey, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS, "No CPU info found in /proc/cpuinfo");
-        return;
+        ffStrbufAppendS(&result->error, "No CPU info found in /proc/cpuinfo");
+        FF_TRACE_END(traceBegin, "detect", "CPU");
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
 
-    FFstrbuf namePretty;
-    ffStrbufInitA(&namePretty, 64);
-    ffStrbufAppend(&namePretty, &name);
+    ffStrbufAppend(&result->namePretty, &result->name);
 
     const char* removeStrings[] = {
         "(R)", "(r)", "(TM)", "(tm)",
@@ -136,50 +130,94 @@ void ffPrintCPU(FFinstance* instance)
         " 2-Core", " 4-Core", " 6-Core", " 8-Core", " 10-Core", " 12-Core", " 14-Core", " 16-Core"
     };
 
-    ffStrbufRemoveStringsA(&namePretty, sizeof(removeStrings) / sizeof(removeStrings[0]), removeStrings);
-    ffStrbufSubstrBeforeFirstC(&namePretty, '@'); //Cut the speed output in the name as we append our own
-    ffStrbufTrimRight(&namePretty, ' '); //If we removed the @ in previous step there was most likely a space before it
+    ffStrbufRemoveStringsA(&result->namePretty, sizeof(removeStrings) / sizeof(removeStrings[0]), removeStrings);
+    ffStrbufSubstrBeforeFirstC(&result->namePretty, '@'); //Cut the speed output in the name as we append our own
+    ffStrbufTrimRight(&result->namePretty, ' '); //If we removed the @ in previous step there was most likely a space before it
+
+    FF_TRACE_END(traceBegin, "detect", "CPU");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void ffPrintCPU(FFinstance* instance)
+{
+    if(ffPrintFromCache(instance, FF_CPU_MODULE_NAME, &instance->config.cpuKey, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS))
+        return;
+
+    const FFCPUResult* result = ffDetectCPU(instance);
+
+    if(result->error.length > 0)
+    {
+        ffPrintError(instance, FF_CPU_MODULE_NAME, 0, &instance->config.cpuKey, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS, result->error.chars);
+        return;
+    }
 
     FFstrbuf cpu;
     ffStrbufInitA(&cpu, 128);
 
-    if(namePretty.length > 0)
-        ffStrbufAppend(&cpu, &namePretty);
-    else if(name.length > 0)
-        ffStrbufAppend(&cpu, &name);
-    else if(vendor.length > 0)
+    if(result->namePretty.length > 0)
+        ffStrbufAppend(&cpu, &result->namePretty);
+    else if(result->name.length > 0)
+        ffStrbufAppend(&cpu, &result->name);
+    else if(result->vendor.length > 0)
     {
-        ffStrbufAppend(&cpu, &vendor);
+        ffStrbufAppend(&cpu, &result->vendor);
         ffStrbufAppendS(&cpu, " unknown processor");
     }
     else
         ffStrbufAppendS(&cpu, "unknown processor");
 
-    if(numProcs > 1)
-        ffStrbufAppendF(&cpu, " (%i)", numProcs);
+    if(result->numProcs > 1)
+    {
+        ffStrbufAppendS(&cpu, " (");
+        ffStrbufAppendInt(&cpu, result->numProcs);
+        ffStrbufAppendC(&cpu, ')');
+    }
 
-    if(ghz > 0)
-        ffStrbufAppendF(&cpu, " @ %.9gGHz", ghz);
+    if(result->ghz > 0)
+    {
+        ffStrbufAppendS(&cpu, " @ ");
+        ffStrbufAppendDouble(&cpu, result->ghz, 9);
+        ffStrbufAppendS(&cpu, "GHz");
+    }
 
     ffPrintAndSaveToCache(instance, FF_CPU_MODULE_NAME, &instance->config.cpuKey, &cpu, &instance->config.cpuFormat, FF_CPU_NUM_FORMAT_ARGS, (FFformatarg[]){
-        {FF_FORMAT_ARG_TYPE_STRBUF, &name},
-        {FF_FORMAT_ARG_TYPE_STRBUF, &namePretty},
-        {FF_FORMAT_ARG_TYPE_STRBUF, &vendor},
-        {FF_FORMAT_ARG_TYPE_INT, &numProcsOnline},
-        {FF_FORMAT_ARG_TYPE_INT, &numProcsAvailable},
-        {FF_FORMAT_ARG_TYPE_INT, &physicalCores},
-        {FF_FORMAT_ARG_TYPE_INT, &numProcs},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &biosLimit},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &scalingMaxFreq},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &scalingMinFreq},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &infoMaxFreq},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &infoMinFreq},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &procGhz},
-        {FF_FORMAT_ARG_TYPE_DOUBLE, &ghz}
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->name},
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->namePretty},
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->vendor},
+        {FF_FORMAT_ARG_TYPE_INT, &result->numProcsOnline},
+        {FF_FORMAT_ARG_TYPE_INT, &result->numProcsAvailable},
+        {FF_FORMAT_ARG_TYPE_INT, &result->physicalCores},
+        {FF_FORMAT_ARG_TYPE_INT, &result->numProcs},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->biosLimit},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->scalingMaxFreq},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->scalingMinFreq},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->infoMaxFreq},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->infoMinFreq},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->procGhz},
+        {FF_FORMAT_ARG_TYPE_DOUBLE, &result->ghz}
     });
 
     ffStrbufDestroy(&cpu);
-    ffStrbufDestroy(&namePretty);
-    ffStrbufDestroy(&name);
-    ffStrbufDestroy(&vendor);
+}
+
+void ffJsonCPU(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFCPUResult* result = ffDetectCPU(instance);
+    ffJsonStrbuf(writer, "name", &result->name);
+    ffJsonStrbuf(writer, "namePretty", &result->namePretty);
+    ffJsonStrbuf(writer, "vendor", &result->vendor);
+    ffJsonInt(writer, "numProcsOnline", result->numProcsOnline);
+    ffJsonInt(writer, "numProcsAvailable", result->numProcsAvailable);
+    ffJsonInt(writer, "physicalCores", result->physicalCores);
+    ffJsonInt(writer, "numProcs", result->numProcs);
+    ffJsonDouble(writer, "biosLimit", result->biosLimit);
+    ffJsonDouble(writer, "scalingMaxFreq", result->scalingMaxFreq);
+    ffJsonDouble(writer, "scalingMinFreq", result->scalingMinFreq);
+    ffJsonDouble(writer, "infoMaxFreq", result->infoMaxFreq);
+    ffJsonDouble(writer, "infoMinFreq", result->infoMinFreq);
+    ffJsonDouble(writer, "procGhz", result->procGhz);
+    ffJsonDouble(writer, "ghz", result->ghz);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
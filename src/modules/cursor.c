@@ -14,16 +14,16 @@ static void printCursor(FFinstance* instance, FFstrbuf* cursorTheme, const FFstr
     if(cursorTheme->length == 0)
         ffStrbufAppendS(cursorTheme, "default");
 
-    ffStrbufWriteTo(cursorTheme, stdout);
+    ffOutputAppend(cursorTheme);
 
     if(cursorSize != NULL && cursorSize->length > 0)
     {
-        fputs(" (", stdout);
-        ffStrbufWriteTo(cursorSize, stdout);
-        fputs("px)", stdout);
+        ffOutputAppendS(" (");
+        ffOutputAppend(cursorSize);
+        ffOutputAppendS("px)");
     }
 
-    putchar('\n');
+    ffOutputAppendC('\n');
 }
 
 static void printCursorGTK(FFinstance* instance)
@@ -216,3 +216,23 @@ void ffPrintCursor(FFinstance* instance)
 
     printCursorGTK(instance);
 }
+
+//Only the GTK settings have a detection result, the other sources are specific to the print
+void ffJsonCursor(FFinstance* instance, FFjsonwriter* writer)
+{
+    if(ffStrbufIgnCaseCompS(&ffDetectWMDE(instance)->wmProtocolName, "TTY") == 0)
+    {
+        ffJsonString(writer, "error", "Cursor isn't supported in TTY");
+        return;
+    }
+
+    const FFGTKResult* gtk2 = ffDetectGTK2(instance);
+    const FFGTKResult* gtk3 = ffDetectGTK3(instance);
+    const FFGTKResult* gtk4 = ffDetectGTK4(instance);
+    ffJsonStrbuf(writer, "gtk2", &gtk2->cursor);
+    ffJsonStrbuf(writer, "gtk2Size", &gtk2->cursorSize);
+    ffJsonStrbuf(writer, "gtk3", &gtk3->cursor);
+    ffJsonStrbuf(writer, "gtk3Size", &gtk3->cursorSize);
+    ffJsonStrbuf(writer, "gtk4", &gtk4->cursor);
+    ffJsonStrbuf(writer, "gtk4Size", &gtk4->cursorSize);
+}
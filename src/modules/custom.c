@@ -3,5 +3,5 @@
 void ffPrintCustom(FFinstance* instance, const char* key, const char* value)
 {
     ffPrintLogoAndKey(instance, key, 0, NULL);
-    puts(value);
+    ffOutputPutS(value);
 }
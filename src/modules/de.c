@@ -19,15 +19,15 @@ void ffPrintDesktopEnvironment(FFinstance* instance)
     {
         ffPrintLogoAndKey(instance, FF_DE_MODULE_NAME, 0, &instance->config.deKey);
 
-        ffStrbufWriteTo(&result->dePrettyName, stdout);
+        ffOutputAppend(&result->dePrettyName);
 
         if(result->deVersion.length > 0)
         {
-            putchar(' ');
-            ffStrbufWriteTo(&result->deVersion, stdout);
+            ffOutputAppendC(' ');
+            ffOutputAppend(&result->deVersion);
         }
 
-        putchar('\n');
+        ffOutputAppendC('\n');
     }
     else
     {
@@ -39,3 +39,12 @@ void ffPrintDesktopEnvironment(FFinstance* instance)
         });
     }
 }
+
+void ffJsonDesktopEnvironment(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFWMDEResult* result = ffDetectWMDE(instance);
+    ffJsonString(writer, "sessionDesktop", result->sessionDesktop);
+    ffJsonStrbuf(writer, "processName", &result->deProcessName);
+    ffJsonStrbuf(writer, "prettyName", &result->dePrettyName);
+    ffJsonStrbuf(writer, "version", &result->deVersion);
+}
@@ -1,5 +1,6 @@
 #include "fastfetch.h"
 
+#include <pthread.h>
 #include <sys/statvfs.h>
 
 #define FF_DISK_MODULE_NAME "Disk"
@@ -16,103 +17,81 @@ static void getKey(FFinstance* instance, FFstrbuf* key, const char* folderPath,
     }
     else
     {
-        ffParseFormatString(key, &instance->config.diskKey, NULL, 1, (FFformatarg[]){
+        ffParseFormatString(instance, key, &instance->config.diskKey, NULL, 1, (FFformatarg[]){
             {FF_FORMAT_ARG_TYPE_STRING, folderPath}
         });
     }
 }
 
-static void printStatvfs(FFinstance* instance, FFstrbuf* key, struct statvfs* fs)
+static void addDisk(FFDiskResult* result, const char* folderPath, struct statvfs* fs, int ret)
 {
-    const uint32_t GB = 1024 * 1024 * 1024;
-
-    uint32_t total     = (fs->f_blocks * fs->f_frsize) / GB;
-    uint32_t available = (fs->f_bfree  * fs->f_frsize) / GB;
-    uint32_t used      = total - available;
-    uint8_t percentage = (used / (double) total) * 100.0;
+    FFDisk* disk = ffListAdd(&result->disks);
+    ffStrbufInit(&disk->folder);
+    ffStrbufAppendS(&disk->folder, folderPath);
+    ffStrbufInit(&disk->error);
 
-    uint32_t files = fs->f_files - fs->f_ffree;
-
-    if(instance->config.diskFormat.length == 0)
-    {
-        ffPrintLogoAndKey(instance, key->chars, 0, NULL);
-        printf("%uGB / %uGB (%u%%)\n", used, total, percentage);
-    }
-    else
+    if(ret != 0)
     {
-        ffPrintFormatString(instance, key->chars, 0, NULL, &instance->config.diskFormat, NULL, FF_DISK_NUM_FORMAT_ARGS, (FFformatarg[]){
-            {FF_FORMAT_ARG_TYPE_UINT, &used},
-            {FF_FORMAT_ARG_TYPE_UINT, &total},
-            {FF_FORMAT_ARG_TYPE_UINT, &files},
-            {FF_FORMAT_ARG_TYPE_UINT8, &percentage}
-        });
+        ffStrbufAppendF(&disk->error, "statvfs(\"%s\", &fs) != 0 (%i)", folderPath, ret);
+        return;
     }
+
+    const uint32_t GB = 1024 * 1024 * 1024;
+
+    disk->total = (uint32_t) ((fs->f_blocks * fs->f_frsize) / GB);
+    uint32_t available = (uint32_t) ((fs->f_bfree  * fs->f_frsize) / GB);
+    disk->used = disk->total - available;
+    disk->percentage = (uint8_t) ((disk->used / (double) disk->total) * 100.0);
+
+    disk->files = (uint32_t) (fs->f_files - fs->f_ffree);
 }
 
-static void printStatvfsCreateKey(FFinstance* instance, const char* folderPath, struct statvfs* fs)
+static void addFolder(FFDiskResult* result, const char* folderPath)
 {
-    FF_STRBUF_CREATE(key);
-    getKey(instance, &key, folderPath, true);
-    printStatvfs(instance, &key, fs);
-    ffStrbufDestroy(&key);
+    struct statvfs fs;
+    int ret = ffSysrootStatvfs(folderPath, &fs);
+    addDisk(result, folderPath, &fs, ret);
 }
 
-static void printFolder(FFinstance* instance, const char* folderPath)
+const FFDiskResult* ffDetectDisk(FFinstance* instance)
 {
-    FF_STRBUF_CREATE(key);
-    getKey(instance, &key, folderPath, true);
-
-    struct statvfs fs;
-    int ret = statvfs(folderPath, &fs);
-    if(ret != 0 && instance->config.diskFormat.length == 0)
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFDiskResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
-        ffPrintError(instance, key.chars, 0, NULL, &instance->config.diskFormat, FF_DISK_NUM_FORMAT_ARGS, "statvfs(\"%s\", &fs) != 0 (%i)", folderPath, ret);
-        ffStrbufDestroy(&key);
-        return;
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
+    FF_TRACE_BEGIN(traceBegin);
 
-    printStatvfs(instance, &key, &fs);
-    ffStrbufDestroy(&key);
-}
+    ffListInitA(&result->disks, sizeof(FFDisk), 2);
+    ffStrbufInit(&result->error);
 
-void ffPrintDisk(FFinstance* instance)
-{
     if(instance->config.diskFolders.length == 0)
     {
-
         struct statvfs fsRoot;
-        int rootRet = statvfs("/", &fsRoot);
+        int rootRet = ffSysrootStatvfs("/", &fsRoot);
 
         struct statvfs fsHome;
-        int homeRet = statvfs("/home", &fsHome);
+        int homeRet = ffSysrootStatvfs("/home", &fsHome);
 
         if(rootRet != 0 && homeRet != 0)
-        {
-            FF_STRBUF_CREATE(key);
-            getKey(instance, &key, "", false);
-            ffPrintError(instance, key.chars, 0, NULL, &instance->config.diskFormat, FF_DISK_NUM_FORMAT_ARGS, "statvfs failed for both / and /home");
-            ffStrbufDestroy(&key);
-            return;
-        }
+            ffStrbufAppendS(&result->error, "statvfs failed for both / and /home");
 
         if(rootRet == 0)
-            printStatvfsCreateKey(instance, "/", &fsRoot);
+            addDisk(result, "/", &fsRoot, rootRet);
 
         if(homeRet == 0 && (rootRet != 0 || fsRoot.f_fsid != fsHome.f_fsid))
-            printStatvfsCreateKey(instance, "/home", &fsHome);
+            addDisk(result, "/home", &fsHome, homeRet);
     }
     else
     {
         ffStrbufTrim(&instance->config.diskFolders, ':');
 
         if(instance->config.diskFolders.length == 0)
-        {
-            FF_STRBUF_CREATE(key);
-            getKey(instance, &key, "", false);
-            ffPrintError(instance, key.chars, 0, NULL, &instance->config.diskFormat, FF_DISK_NUM_FORMAT_ARGS, "Custom disk folders string doesn't contain any folders");
-            ffStrbufDestroy(&key);
-            return;
-        }
+            ffStrbufAppendS(&result->error, "Custom disk folders string doesn't contain any folders");
 
         uint32_t startIndex = 0;
         while (startIndex < instance->config.diskFolders.length)
@@ -120,9 +99,90 @@ void ffPrintDisk(FFinstance* instance)
             uint32_t colonIndex = ffStrbufNextIndexC(&instance->config.diskFolders, startIndex, ':');
             instance->config.diskFolders.chars[colonIndex] = '\0';
 
-            printFolder(instance, instance->config.diskFolders.chars + startIndex);
+            addFolder(result, instance->config.diskFolders.chars + startIndex);
+
+            //Restored for the next detection in watch mode
+            if(colonIndex < instance->config.diskFolders.length)
+                instance->config.diskFolders.chars[colonIndex] = ':';
 
             startIndex = colonIndex + 1;
         }
     }
+
+    FF_TRACE_END(traceBegin, "detect", "Disk");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+static void printDisk(FFinstance* instance, const FFDisk* disk)
+{
+    FF_STRBUF_CREATE(key);
+    getKey(instance, &key, disk->folder.chars, true);
+
+    if(disk->error.length > 0)
+    {
+        ffPrintError(instance, key.chars, 0, NULL, &instance->config.diskFormat, FF_DISK_NUM_FORMAT_ARGS, disk->error.chars);
+    }
+    else if(instance->config.diskFormat.length == 0)
+    {
+        ffPrintLogoAndKey(instance, key.chars, 0, NULL);
+        ffOutputAppendUInt(disk->used);
+        ffOutputAppendS("GB / ");
+        ffOutputAppendUInt(disk->total);
+        ffOutputAppendS("GB (");
+        ffOutputAppendUInt(disk->percentage);
+        ffOutputAppendS("%)\n");
+    }
+    else
+    {
+        ffPrintFormatString(instance, key.chars, 0, NULL, &instance->config.diskFormat, NULL, FF_DISK_NUM_FORMAT_ARGS, (FFformatarg[]){
+            {FF_FORMAT_ARG_TYPE_UINT, &disk->used},
+            {FF_FORMAT_ARG_TYPE_UINT, &disk->total},
+            {FF_FORMAT_ARG_TYPE_UINT, &disk->files},
+            {FF_FORMAT_ARG_TYPE_UINT8, &disk->percentage}
+        });
+    }
+
+    ffStrbufDestroy(&key);
+}
+
+void ffPrintDisk(FFinstance* instance)
+{
+    const FFDiskResult* result = ffDetectDisk(instance);
+
+    if(result->error.length > 0)
+    {
+        FF_STRBUF_CREATE(key);
+        getKey(instance, &key, "", false);
+        ffPrintError(instance, key.chars, 0, NULL, &instance->config.diskFormat, FF_DISK_NUM_FORMAT_ARGS, result->error.chars);
+        ffStrbufDestroy(&key);
+        return;
+    }
+
+    for(uint32_t i = 0; i < result->disks.length; i++)
+        printDisk(instance, ffListGet(&result->disks, i));
+}
+
+void ffJsonDisk(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFDiskResult* result = ffDetectDisk(instance);
+
+    ffJsonBeginArray(writer, "disks");
+    for(uint32_t i = 0; i < result->disks.length; i++)
+    {
+        const FFDisk* disk = ffListGet(&result->disks, i);
+        ffJsonBeginObject(writer, NULL);
+        ffJsonStrbuf(writer, "folder", &disk->folder);
+        ffJsonUInt(writer, "usedGiB", disk->used);
+        ffJsonUInt(writer, "totalGiB", disk->total);
+        ffJsonUInt(writer, "files", disk->files);
+        ffJsonUInt(writer, "percentage", disk->percentage);
+        if(disk->error.length > 0)
+            ffJsonStrbuf(writer, "error", &disk->error);
+        ffJsonEndObject(writer);
+    }
+    ffJsonEndArray(writer);
+
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
@@ -45,13 +45,13 @@ void ffPrintFont(FFinstance* instance)
         ffPrintLogoAndKey(instance, FF_FONT_MODULE_NAME, 0, &instance->config.fontKey);
         if(plasma.pretty.length > 0)
         {
-            ffStrbufWriteTo(&plasma.pretty, stdout);
-            fputs(" [Plasma]", stdout);
+            ffOutputAppend(&plasma.pretty);
+            ffOutputAppendS(" [Plasma]");
 
             if(gtk.length > 0)
-                fputs(", ", stdout);
+                ffOutputAppendS(", ");
         }
-        ffStrbufPutTo(&gtk, stdout);
+        ffOutputPut(&gtk);
     }
     else
     {
@@ -86,3 +86,17 @@ void ffPrintFont(FFinstance* instance)
     ffFontDestroy(&gtk4);
     ffStrbufDestroy(&gtk);
 }
+
+void ffJsonFont(FFinstance* instance, FFjsonwriter* writer)
+{
+    if(ffStrbufIgnCaseCompS(&ffDetectWMDE(instance)->wmProtocolName, "TTY") == 0)
+    {
+        ffJsonString(writer, "error", "Font isn't supported in TTY");
+        return;
+    }
+
+    ffJsonStrbuf(writer, "plasma", &ffDetectPlasma(instance)->font);
+    ffJsonStrbuf(writer, "gtk2", &ffDetectGTK2(instance)->font);
+    ffJsonStrbuf(writer, "gtk3", &ffDetectGTK3(instance)->font);
+    ffJsonStrbuf(writer, "gtk4", &ffDetectGTK4(instance)->font);
+}
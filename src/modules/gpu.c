@@ -1,146 +1,235 @@
 #include "fastfetch.h"
 
 #include <string.h>
-#include <dlfcn.h>
-#include <pci/pci.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #define FF_GPU_MODULE_NAME "GPU"
 #define FF_GPU_NUM_FORMAT_ARGS 4
 
-static void printGPU(FFinstance* instance, struct pci_access* pacc, struct pci_dev* dev, FFcache* cache, uint8_t counter, char*(*ffpci_lookup_name)(struct pci_access*, char*, int, int, ...))
+//Base classes and subclasses of VGA compatible, 3D and other display controllers
+#define FF_GPU_CLASS_VGA 0x0300
+#define FF_GPU_CLASS_3D 0x0302
+#define FF_GPU_CLASS_DISPLAY 0x0380
+
+typedef struct FFpcidevice
 {
-    char vendor[512];
-    vendor[0] = '\0';
-    ffpci_lookup_name(pacc, vendor, sizeof(vendor), PCI_LOOKUP_VENDOR, dev->vendor_id, dev->device_id);
-
-    const char* vendorPretty;
-    if(strcasecmp(vendor, "Advanced Micro Devices, Inc. [AMD/ATI]") == 0)
-        vendorPretty = "AMD ATI";
-    else if(strcasecmp(vendor, "NVIDIA Corporation") == 0)
-        vendorPretty = "Nvidia";
-    else if(strcasecmp(vendor, "Intel Corporation") == 0)
-        vendorPretty = "Intel";
-    else
-        vendorPretty = vendor;
+    char address[32]; //Domain, bus, device and function, e.g. 0000:01:00.0
+    uint16_t vendorId;
+    uint16_t deviceId;
+} FFpcidevice;
 
-    char name[512];
-    name[0] = '\0';
-    ffpci_lookup_name(pacc, name, sizeof(name), PCI_LOOKUP_DEVICE, dev->vendor_id, dev->device_id);
+//Reads a file like class or vendor of a device in /sys/bus/pci/devices, which contains a hex number like 0x10de
+static bool readDeviceHex(int devicesFD, const char* address, const char* fileName, uint32_t* value)
+{
+    char path[64];
+    size_t addressLength = strlen(address);
+    size_t fileNameLength = strlen(fileName);
+    if(addressLength + 1 + fileNameLength >= sizeof(path))
+        return false;
+
+    memcpy(path, address, addressLength);
+    path[addressLength] = '/';
+    memcpy(path + addressLength + 1, fileName, fileNameLength + 1);
+
+    int fd = openat(devicesFD, path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+
+    char buffer[32];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if(length <= 0)
+        return false;
+    buffer[length] = '\0';
+
+    char* end;
+    *value = (uint32_t) strtoul(buffer, &end, 16);
+    return end != buffer;
+}
 
-    FFstrbuf namePretty;
-    ffStrbufInitA(&namePretty, 512);
-    ffStrbufAppendS(&namePretty, name);
-    ffStrbufSubstrBeforeLastC(&namePretty, ']');
-    ffStrbufSubstrAfterFirstC(&namePretty, '[');
+static int compareDevices(const void* a, const void* b)
+{
+    return strcmp(((const FFpcidevice*) a)->address, ((const FFpcidevice*) b)->address);
+}
 
-    FFstrbuf gpu;
-    ffStrbufInitA(&gpu, 128);
+static void addGPU(FFGPUResult* result, const FFpciids* ids, const FFpcidevice* device)
+{
+    FFGPU* gpu = ffListAdd(&result->gpus);
 
-    ffStrbufSetF(&gpu, "%s %s", vendorPretty, namePretty.chars);
+    //Unknown ids are named like lspci does
+    ffStrbufInit(&gpu->vendor);
+    const char* vendor = ffPciidsGetVendor(ids, device->vendorId);
+    if(vendor != NULL)
+        ffStrbufAppendS(&gpu->vendor, vendor);
+    else
+        ffStrbufAppendF(&gpu->vendor, "Vendor %04x", device->vendorId);
+
+    if(ffStrbufIgnCaseCompS(&gpu->vendor, "Advanced Micro Devices, Inc. [AMD/ATI]") == 0)
+        gpu->vendorPretty = "AMD ATI";
+    else if(ffStrbufIgnCaseCompS(&gpu->vendor, "NVIDIA Corporation") == 0)
+        gpu->vendorPretty = "Nvidia";
+    else if(ffStrbufIgnCaseCompS(&gpu->vendor, "Intel Corporation") == 0)
+        gpu->vendorPretty = "Intel";
+    else
+        gpu->vendorPretty = gpu->vendor.chars;
 
-    ffPrintAndAppendToCache(instance, FF_GPU_MODULE_NAME, counter, &instance->config.gpuKey, cache, &gpu, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, (FFformatarg[]){
-        {FF_FORMAT_ARG_TYPE_STRING, vendor},
-        {FF_FORMAT_ARG_TYPE_STRING, vendorPretty},
-        {FF_FORMAT_ARG_TYPE_STRING, name},
-        {FF_FORMAT_ARG_TYPE_STRBUF, &namePretty}
-    });
+    ffStrbufInit(&gpu->name);
+    const char* name = ffPciidsGetDevice(ids, device->vendorId, device->deviceId);
+    if(name != NULL)
+        ffStrbufAppendS(&gpu->name, name);
+    else
+        ffStrbufAppendF(&gpu->name, "Device %04x", device->deviceId);
 
-    ffStrbufDestroy(&gpu);
-    ffStrbufDestroy(&namePretty);
+    ffStrbufInitA(&gpu->namePretty, gpu->name.length + 1);
+    ffStrbufAppend(&gpu->namePretty, &gpu->name);
+    ffStrbufSubstrBeforeLastC(&gpu->namePretty, ']');
+    ffStrbufSubstrAfterFirstC(&gpu->namePretty, '[');
 }
 
-void ffPrintGPU(FFinstance* instance)
+//The kernel exports the ids of every PCI device in sysfs, so only the names of the GPUs need a lookup
+const FFGPUResult* ffDetectGPU(FFinstance* instance)
 {
-    if(ffPrintFromCache(instance, FF_GPU_MODULE_NAME, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS))
-        return;
-
-    const char* pciLibName = instance->config.libPCI.length == 0 ? "libpci.so" : instance->config.libPCI.chars;
-    void* pci = dlopen(pciLibName, RTLD_LAZY);
-    if(pci == NULL)
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFGPUResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlopen(\"%s\", RTLD_LAZY) == NULL", pciLibName);
-        return;
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
+    FF_TRACE_BEGIN(traceBegin);
 
-    struct pci_access*(*ffpci_alloc)() = dlsym(pci, "pci_alloc");
-    if(ffpci_alloc == NULL)
-    {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_alloc\") == NULL");
-        return;
-    }
+    ffListInitA(&result->gpus, sizeof(FFGPU), 4);
+    ffStrbufInit(&result->error);
 
-    void(*ffpci_init)(struct pci_access*) = dlsym(pci, "pci_init");
-    if(ffpci_init == NULL)
+    DIR* dir = ffSysrootOpenDir("/sys/bus/pci/devices");
+    if(dir == NULL)
     {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_init\") == NULL");
-        return;
+        ffStrbufAppendS(&result->error, "opendir(\"/sys/bus/pci/devices\") == NULL");
+        FF_TRACE_END(traceBegin, "detect", "GPU");
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
 
-    void(*ffpci_scan_bus)(struct pci_access*) = dlsym(pci, "pci_scan_bus");
-    if(ffpci_scan_bus == NULL)
+    FFlist devices;
+    ffListInitA(&devices, sizeof(FFpcidevice), 4);
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
     {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_init\") == NULL");
-        return;
+        if(entry->d_name[0] == '.' || strlen(entry->d_name) >= sizeof(((FFpcidevice*) NULL)->address))
+            continue;
+
+        uint32_t class, vendorId, deviceId;
+        if(!readDeviceHex(dirfd(dir), entry->d_name, "class", &class))
+            continue;
+
+        //The lowest byte is the programming interface
+        class >>= 8;
+        if(class != FF_GPU_CLASS_VGA && class != FF_GPU_CLASS_3D && class != FF_GPU_CLASS_DISPLAY)
+            continue;
+
+        if(
+            !readDeviceHex(dirfd(dir), entry->d_name, "vendor", &vendorId) ||
+            !readDeviceHex(dirfd(dir), entry->d_name, "device", &deviceId)
+        ) continue;
+
+        FFpcidevice* device = ffListAdd(&devices);
+        strcpy(device->address, entry->d_name);
+        device->vendorId = (uint16_t) vendorId;
+        device->deviceId = (uint16_t) deviceId;
     }
 
-    int(*ffpci_fill_info)(struct pci_dev*, int) = dlsym(pci, "pci_fill_info");
-    if(ffpci_fill_info == NULL)
+    closedir(dir);
+
+    if(devices.length == 0)
+        ffStrbufAppendS(&result->error, "No GPU found");
+    else
     {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_fill_info\") == NULL");
-        return;
+        //readdir returns the devices in no particular order, bus order keeps the GPU indices stable
+        qsort(devices.data, devices.length, sizeof(FFpcidevice), compareDevices);
+
+        FFpciids ids;
+        ffPciidsOpen(instance, &ids);
+
+        for(uint32_t i = 0; i < devices.length; i++)
+            addGPU(result, &ids, ffListGet(&devices, i));
+
+        ffPciidsClose(&ids);
     }
 
-    char*(*ffpci_lookup_name)(struct pci_access*, char*, int, int, ...) = dlsym(pci, "pci_lookup_name");
-    if(ffpci_lookup_name == NULL)
-    {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_lookup_name\") == NULL");
+    ffListDestroy(&devices);
+
+    FF_TRACE_END(traceBegin, "detect", "GPU");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+#undef FF_GPU_CLASS_DISPLAY
+#undef FF_GPU_CLASS_3D
+#undef FF_GPU_CLASS_VGA
+
+void ffPrintGPU(FFinstance* instance)
+{
+    if(ffPrintFromCache(instance, FF_GPU_MODULE_NAME, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS))
         return;
-    }
 
-    void(*ffpci_cleanup)(struct pci_access*) = dlsym(pci, "pci_cleanup");
-    if(ffpci_cleanup == NULL)
+    const FFGPUResult* result = ffDetectGPU(instance);
+
+    if(result->error.length > 0)
     {
-        dlclose(pci);
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "dlsym(pci, \"pci_cleanup\") == NULL");
+        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, result->error.chars);
         return;
     }
 
-    struct pci_access *pacc = ffpci_alloc();
-    ffpci_init(pacc);
-    ffpci_scan_bus(pacc);
-
-    FFlist devices;
-    ffListInitA(&devices, sizeof(struct pci_dev*), 4);
-
     FFcache cache;
     ffCacheOpenWrite(instance, FF_GPU_MODULE_NAME, &cache);
 
-    struct pci_dev* dev;
-    for (dev=pacc->devices; dev; dev=dev->next)
+    FFstrbuf output;
+    ffStrbufInitA(&output, 128);
+
+    for(uint32_t i = 0; i < result->gpus.length; i++)
     {
-        ffpci_fill_info(dev, PCI_FILL_IDENT | PCI_FILL_CLASS);
-        char class[1024];
-        ffpci_lookup_name(pacc, class, sizeof(class), PCI_LOOKUP_CLASS, dev->device_class);
-        if(
-            strcasecmp("VGA compatible controller", class) == 0 ||
-            strcasecmp("3D controller", class)             == 0 ||
-            strcasecmp("Display controller", class)        == 0
-        ) *(struct pci_dev**)ffListAdd(&devices) = dev;
+        const FFGPU* gpu = ffListGet(&result->gpus, i);
+
+        ffStrbufClear(&output);
+        ffStrbufAppendS(&output, gpu->vendorPretty);
+        ffStrbufAppendC(&output, ' ');
+        ffStrbufAppend(&output, &gpu->namePretty);
+
+        ffPrintAndAppendToCache(instance, FF_GPU_MODULE_NAME, result->gpus.length == 1 ? 0 : (uint8_t) (i + 1), &instance->config.gpuKey, &cache, &output, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, (FFformatarg[]){
+            {FF_FORMAT_ARG_TYPE_STRBUF, &gpu->vendor},
+            {FF_FORMAT_ARG_TYPE_STRING, gpu->vendorPretty},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &gpu->name},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &gpu->namePretty}
+        });
     }
 
-    for(uint32_t i = 0; i < devices.length; i++)
-        printGPU(instance, pacc, *(struct pci_dev**)ffListGet(&devices, i), &cache, devices.length == 1 ? 0 : i + 1, ffpci_lookup_name);
+    ffStrbufDestroy(&output);
+    ffCacheClose(&cache);
+}
+
+void ffJsonGPU(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFGPUResult* result = ffDetectGPU(instance);
 
-    if(devices.length == 0)
-        ffPrintError(instance, FF_GPU_MODULE_NAME, 0, &instance->config.gpuKey, &instance->config.gpuFormat, FF_GPU_NUM_FORMAT_ARGS, "No GPU found");
+    ffJsonBeginArray(writer, "gpus");
+    for(uint32_t i = 0; i < result->gpus.length; i++)
+    {
+        const FFGPU* gpu = ffListGet(&result->gpus, i);
+        ffJsonBeginObject(writer, NULL);
+        ffJsonStrbuf(writer, "vendor", &gpu->vendor);
+        ffJsonString(writer, "vendorPretty", gpu->vendorPretty);
+        ffJsonStrbuf(writer, "name", &gpu->name);
+        ffJsonStrbuf(writer, "namePretty", &gpu->namePretty);
+        ffJsonEndObject(writer);
+    }
+    ffJsonEndArray(writer);
 
-    ffCacheClose(&cache);
-    ffListDestroy(&devices);
-    ffpci_cleanup(pacc);
-    dlclose(pci);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
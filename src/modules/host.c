@@ -1,5 +1,7 @@
 #include "fastfetch.h"
 
+#include <pthread.h>
+
 #define FF_HOST_MODULE_NAME "Host"
 #define FF_HOST_NUM_FORMAT_ARGS 3
 
@@ -38,72 +40,98 @@ static inline void getHostValue(const char* devicesPath, const char* classPath,
         ffGetFileContent(classPath, buffer);
 }
 
-void ffPrintHost(FFinstance* instance)
+const FFHostResult* ffDetectHost(FFinstance* instance)
 {
-    if(ffPrintFromCache(instance, FF_HOST_MODULE_NAME, &instance->config.hostKey, &instance->config.hostFormat, FF_HOST_NUM_FORMAT_ARGS))
-        return;
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFHostResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return result;
+    }
+    FF_TRACE_BEGIN(traceBegin);
 
-    FFstrbuf family;
-    ffStrbufInit(&family);
-    getHostValue("/sys/devices/virtual/dmi/id/product_family", "/sys/class/dmi/id/product_family", &family);
-    bool familySet = hostValueSet(&family);
+    ffStrbufInit(&result->family);
+    getHostValue("/sys/devices/virtual/dmi/id/product_family", "/sys/class/dmi/id/product_family", &result->family);
+    result->familySet = hostValueSet(&result->family);
 
-    FFstrbuf name;
-    ffStrbufInit(&name);
-    getHostValue("/sys/devices/virtual/dmi/id/product_name", "/sys/class/dmi/id/product_name", &name);
+    ffStrbufInit(&result->name);
+    getHostValue("/sys/devices/virtual/dmi/id/product_name", "/sys/class/dmi/id/product_name", &result->name);
 
-    if(name.length == 0)
-        ffGetFileContent("/sys/firmware/devicetree/base/model", &name);
+    if(result->name.length == 0)
+        ffGetFileContent("/sys/firmware/devicetree/base/model", &result->name);
 
-    if(name.length == 0)
-        ffGetFileContent("/tmp/sysinfo/model", &name);
+    if(result->name.length == 0)
+        ffGetFileContent("/tmp/sysinfo/model", &result->name);
 
-    bool nameSet = hostValueSet(&name);
+    result->nameSet = hostValueSet(&result->name);
 
-    if(ffStrbufStartsWithS(&name, "Standard PC"))
+    if(ffStrbufStartsWithS(&result->name, "Standard PC"))
     {
         FFstrbuf copy;
-        ffStrbufInitCopy(&copy, &name);
-        ffStrbufSetS(&name, "KVM/QEMU ");
-        ffStrbufAppend(&name, &copy);
+        ffStrbufInitCopy(&copy, &result->name);
+        ffStrbufSetS(&result->name, "KVM/QEMU ");
+        ffStrbufAppend(&result->name, &copy);
         ffStrbufDestroy(&copy);
     }
 
-    FFstrbuf version;
-    ffStrbufInit(&version);
-    getHostValue("/sys/devices/virtual/dmi/id/product_version", "/sys/class/dmi/id/product_version", &version);
-    bool versionSet = hostValueSet(&version);
+    ffStrbufInit(&result->version);
+    getHostValue("/sys/devices/virtual/dmi/id/product_version", "/sys/class/dmi/id/product_version", &result->version);
+    result->versionSet = hostValueSet(&result->version);
+
+    ffStrbufInit(&result->error);
+    if(!result->familySet && !result->nameSet)
+        ffStrbufAppendS(&result->error, "neither family nor name is set by O.E.M.");
+
+    FF_TRACE_END(traceBegin, "detect", "Host");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void ffPrintHost(FFinstance* instance)
+{
+    if(ffPrintFromCache(instance, FF_HOST_MODULE_NAME, &instance->config.hostKey, &instance->config.hostFormat, FF_HOST_NUM_FORMAT_ARGS))
+        return;
 
-    if(!familySet && !nameSet)
+    const FFHostResult* result = ffDetectHost(instance);
+
+    if(result->error.length > 0)
     {
-        ffStrbufDestroy(&family);
-        ffStrbufDestroy(&name);
-        ffStrbufDestroy(&version);
-        ffPrintError(instance, FF_HOST_MODULE_NAME, 0, &instance->config.hostKey, &instance->config.hostFormat, FF_HOST_NUM_FORMAT_ARGS, "neither family nor name is set by O.E.M.");
+        ffPrintError(instance, FF_HOST_MODULE_NAME, 0, &instance->config.hostKey, &instance->config.hostFormat, FF_HOST_NUM_FORMAT_ARGS, result->error.chars);
         return;
     }
 
     FFstrbuf host;
     ffStrbufInit(&host);
 
-    if(nameSet)
-        ffStrbufAppend(&host, &name);
+    if(result->nameSet)
+        ffStrbufAppend(&host, &result->name);
     else
-        ffStrbufAppend(&host, &family);
+        ffStrbufAppend(&host, &result->family);
 
-    if(versionSet)
+    if(result->versionSet)
     {
         ffStrbufAppendC(&host, ' ');
-        ffStrbufAppend(&host, &version);
+        ffStrbufAppend(&host, &result->version);
     }
 
     ffPrintAndSaveToCache(instance, FF_HOST_MODULE_NAME, &instance->config.hostKey, &host, &instance->config.hostFormat, FF_HOST_NUM_FORMAT_ARGS, (FFformatarg[]) {
-        {FF_FORMAT_ARG_TYPE_STRBUF, &family},
-        {FF_FORMAT_ARG_TYPE_STRBUF, &name},
-        {FF_FORMAT_ARG_TYPE_STRBUF, &version}
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->family},
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->name},
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->version}
     });
 
-    ffStrbufDestroy(&family);
-    ffStrbufDestroy(&name);
-    ffStrbufDestroy(&version);
+    ffStrbufDestroy(&host);
+}
+
+void ffJsonHost(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFHostResult* result = ffDetectHost(instance);
+    ffJsonString(writer, "family", result->familySet ? result->family.chars : NULL);
+    ffJsonString(writer, "name", result->nameSet ? result->name.chars : NULL);
+    ffJsonString(writer, "version", result->versionSet ? result->version.chars : NULL);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
@@ -33,14 +33,14 @@ void ffPrintIcons(FFinstance* instance)
 
         if(plasma->length > 0)
         {
-            ffStrbufWriteTo(plasma, stdout);
-            fputs(" [Plasma]", stdout);
+            ffOutputAppend(plasma);
+            ffOutputAppendS(" [Plasma]");
 
             if(gtkPretty.length > 0)
-                fputs(", ", stdout);
+                ffOutputAppendS(", ");
         }
 
-        ffStrbufPutTo(&gtkPretty, stdout);
+        ffOutputPut(&gtkPretty);
     }
     else
     {
@@ -55,3 +55,17 @@ void ffPrintIcons(FFinstance* instance)
 
     ffStrbufDestroy(&gtkPretty);
 }
+
+void ffJsonIcons(FFinstance* instance, FFjsonwriter* writer)
+{
+    if(ffStrbufIgnCaseCompS(&ffDetectWMDE(instance)->wmProtocolName, "TTY") == 0)
+    {
+        ffJsonString(writer, "error", "Icons aren't supported in TTY");
+        return;
+    }
+
+    ffJsonStrbuf(writer, "plasma", &ffDetectPlasma(instance)->icons);
+    ffJsonStrbuf(writer, "gtk2", &ffDetectGTK2(instance)->icons);
+    ffJsonStrbuf(writer, "gtk3", &ffDetectGTK3(instance)->icons);
+    ffJsonStrbuf(writer, "gtk4", &ffDetectGTK4(instance)->icons);
+}
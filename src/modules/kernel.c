@@ -8,7 +8,7 @@ void ffPrintKernel(FFinstance* instance)
     if(instance->config.kernelFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_KERNEL_MODULE_NAME, 0, &instance->config.kernelKey);
-        puts(instance->state.utsname.release);
+        ffOutputPutS(instance->state.utsname.release);
     }
     else
     {
@@ -19,3 +19,11 @@ void ffPrintKernel(FFinstance* instance)
         });
     }
 }
+
+void ffJsonKernel(FFinstance* instance, FFjsonwriter* writer)
+{
+    ffJsonString(writer, "sysname", instance->state.utsname.sysname);
+    ffJsonString(writer, "release", instance->state.utsname.release);
+    ffJsonString(writer, "version", instance->state.utsname.version);
+    ffJsonString(writer, "machine", instance->state.utsname.machine);
+}
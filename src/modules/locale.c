@@ -1,5 +1,7 @@
 #include "fastfetch.h"
 
+#include <pthread.h>
+
 #define FF_LOCALE_MODULE_NAME "Locale"
 #define FF_LOCALE_NUM_FORMAT_ARGS 1
 
@@ -20,28 +22,57 @@ static void getLocaleFromEnv(FFstrbuf* locale)
     ffStrbufAppendS(locale, getenv("LC_MESSAGES"));
 }
 
-void ffPrintLocale(FFinstance* instance)
+const FFLocaleResult* ffDetectLocale(FFinstance* instance)
 {
-	if(ffPrintFromCache(instance, FF_LOCALE_MODULE_NAME, &instance->config.localeKey, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS))
-        return;
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFLocaleResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return result;
+    }
+    FF_TRACE_BEGIN(traceBegin);
+
+    ffStrbufInit(&result->locale);
+    ffStrbufInit(&result->error);
 
-	FFstrbuf locale;
-    ffStrbufInit(&locale);
+    ffParsePropFile("/etc/locale.conf", "LANG =", &result->locale);
 
-    ffParsePropFile("/etc/locale.conf", "LANG =", &locale);
+    if(result->locale.length == 0)
+        getLocaleFromEnv(&result->locale);
 
-	if (locale.length == 0)
-        getLocaleFromEnv(&locale);
+    if(result->locale.length == 0)
+        ffStrbufAppendS(&result->error, "No locale found");
+
+    FF_TRACE_END(traceBegin, "detect", "Locale");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
 
-    if(locale.length == 0)
+void ffPrintLocale(FFinstance* instance)
+{
+    if(ffPrintFromCache(instance, FF_LOCALE_MODULE_NAME, &instance->config.localeKey, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS))
+        return;
+
+    const FFLocaleResult* result = ffDetectLocale(instance);
+
+    if(result->error.length > 0)
     {
-        ffPrintError(instance, FF_LOCALE_MODULE_NAME, 0, &instance->config.localeKey, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS, "No locale found");
+        ffPrintError(instance, FF_LOCALE_MODULE_NAME, 0, &instance->config.localeKey, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS, result->error.chars);
         return;
     }
 
-    ffPrintAndSaveToCache(instance, FF_LOCALE_MODULE_NAME, &instance->config.localeKey, &locale, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS, (FFformatarg[]){
-        {FF_FORMAT_ARG_TYPE_STRBUF, &locale}
+    ffPrintAndSaveToCache(instance, FF_LOCALE_MODULE_NAME, &instance->config.localeKey, &result->locale, &instance->config.localeFormat, FF_LOCALE_NUM_FORMAT_ARGS, (FFformatarg[]){
+        {FF_FORMAT_ARG_TYPE_STRBUF, &result->locale}
     });
+}
 
-	ffStrbufDestroy(&locale);
+void ffJsonLocale(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFLocaleResult* result = ffDetectLocale(instance);
+    ffJsonStrbuf(writer, "locale", &result->locale);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
 }
@@ -1,57 +1,114 @@
 #include "fastfetch.h"
 
+#include <pthread.h>
+
 #define FF_MEMORY_MODULE_NAME "Memory"
 #define FF_MEMORY_NUM_FORMAT_ARGS 3
 
 // Impl inspired by: https://github.com/sam-barr/paleofetch/blob/b7c58a52c0de39b53c9b5f417889a5886d324bfa/paleofetch.c#L544
-void ffPrintMemory(FFinstance* instance)
+const FFMemoryResult* ffDetectMemory(FFinstance* instance)
 {
-    FILE* meminfo = fopen("/proc/meminfo", "r");
-    if(meminfo == NULL) {
-        ffPrintError(instance, FF_MEMORY_MODULE_NAME, 0, &instance->config.memoryKey, &instance->config.memoryFormat, FF_MEMORY_NUM_FORMAT_ARGS, "fopen(\"/proc/meminfo\", \"r\") == NULL");
-        return;
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFMemoryResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
+    FF_TRACE_BEGIN(traceBegin);
 
-    char* line = NULL;
-    size_t len = 0;
+    ffStrbufInit(&result->error);
 
-    uint32_t total, shared, memfree, buffers, cached, reclaimable;
+    FFstrbuf total, shared, memfree, buffers, cached, reclaimable;
+    ffStrbufInit(&total);
+    ffStrbufInit(&shared);
+    ffStrbufInit(&memfree);
+    ffStrbufInit(&buffers);
+    ffStrbufInit(&cached);
+    ffStrbufInit(&reclaimable);
 
-    while (getline(&line, &len, meminfo) != -1) {
-        sscanf(line, "MemTotal: %u", &total);
-        sscanf(line, "Shmem: %u", &shared);
-        sscanf(line, "MemFree: %u", &memfree);
-        sscanf(line, "Buffers: %u", &buffers);
-        sscanf(line, "Cached: %u", &cached);
-        sscanf(line, "SReclaimable: %u", &reclaimable);
+    bool opened = ffParsePropFileValuesFirst("/proc/meminfo", 6, (FFpropquery[]) {
+        {"MemTotal:", &total},
+        {"Shmem:", &shared},
+        {"MemFree:", &memfree},
+        {"Buffers:", &buffers},
+        {"Cached:", &cached},
+        {"SReclaimable:", &reclaimable}
+    });
+
+    //Values are in kB
+    uint32_t totalKB = (uint32_t) strtoul(total.chars, NULL, 10);
+    uint32_t sharedKB = (uint32_t) strtoul(shared.chars, NULL, 10);
+    uint32_t memfreeKB = (uint32_t) strtoul(memfree.chars, NULL, 10);
+    uint32_t buffersKB = (uint32_t) strtoul(buffers.chars, NULL, 10);
+    uint32_t cachedKB = (uint32_t) strtoul(cached.chars, NULL, 10);
+    uint32_t reclaimableKB = (uint32_t) strtoul(reclaimable.chars, NULL, 10);
+
+    ffStrbufDestroy(&total);
+    ffStrbufDestroy(&shared);
+    ffStrbufDestroy(&memfree);
+    ffStrbufDestroy(&buffers);
+    ffStrbufDestroy(&cached);
+    ffStrbufDestroy(&reclaimable);
+
+    if(!opened)
+    {
+        ffStrbufAppendS(&result->error, "open(\"/proc/meminfo\", O_RDONLY) == -1");
+        FF_TRACE_END(traceBegin, "detect", "Memory");
+        pthread_mutex_unlock(&mutex);
+        return result;
     }
 
-    if(line != NULL)
-        free(line);
+    result->used = (totalKB + sharedKB - memfreeKB - buffersKB - cachedKB - reclaimableKB) / 1024;
+    result->total = totalKB / 1024;
+    result->percentage = (uint8_t) ((result->used / (double) result->total) * 100);
 
-    fclose(meminfo);
+    if(result->used == 0 && result->total == 0 && result->percentage == 0)
+        ffStrbufAppendS(&result->error, "/proc/meminfo could't be parsed");
 
-    uint32_t used_mem = (total + shared - memfree - buffers - cached - reclaimable) / 1024;
-    uint32_t total_mem = total / 1024;
-    uint8_t percentage = (uint8_t) ((used_mem / (double) total_mem) * 100);
+    FF_TRACE_END(traceBegin, "detect", "Memory");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void ffPrintMemory(FFinstance* instance)
+{
+    const FFMemoryResult* result = ffDetectMemory(instance);
 
-    if(used_mem == 0 && total_mem == 0 && percentage == 0)
+    if(result->error.length > 0)
     {
-        ffPrintError(instance, FF_MEMORY_MODULE_NAME, 0, &instance->config.memoryKey, &instance->config.memoryFormat, FF_MEMORY_NUM_FORMAT_ARGS, "/proc/meminfo could't be parsed");
+        ffPrintError(instance, FF_MEMORY_MODULE_NAME, 0, &instance->config.memoryKey, &instance->config.memoryFormat, FF_MEMORY_NUM_FORMAT_ARGS, result->error.chars);
         return;
     }
 
     if(instance->config.memoryFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_MEMORY_MODULE_NAME, 0, &instance->config.memoryKey);
-        printf("%uMiB / %uMiB (%u%%)\n", used_mem, total_mem, percentage);
+        ffOutputAppendUInt(result->used);
+        ffOutputAppendS("MiB / ");
+        ffOutputAppendUInt(result->total);
+        ffOutputAppendS("MiB (");
+        ffOutputAppendUInt(result->percentage);
+        ffOutputAppendS("%)\n");
     }
     else
     {
         ffPrintFormatString(instance, FF_MEMORY_MODULE_NAME, 0, &instance->config.memoryKey, &instance->config.memoryFormat, NULL, FF_MEMORY_NUM_FORMAT_ARGS, (FFformatarg[]){
-            {FF_FORMAT_ARG_TYPE_UINT, &used_mem},
-            {FF_FORMAT_ARG_TYPE_UINT, &total_mem},
-            {FF_FORMAT_ARG_TYPE_UINT8, &percentage}
+            {FF_FORMAT_ARG_TYPE_UINT, &result->used},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->total},
+            {FF_FORMAT_ARG_TYPE_UINT8, &result->percentage}
         });
     }
 }
+
+void ffJsonMemory(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFMemoryResult* result = ffDetectMemory(instance);
+    ffJsonUInt(writer, "usedMiB", result->used);
+    ffJsonUInt(writer, "totalMiB", result->total);
+    ffJsonUInt(writer, "percentage", result->percentage);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
+}
@@ -8,72 +8,57 @@
 const FFOSResult* ffDetectOS(FFinstance* instance)
 {
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    static FFOSResult result;
-    static bool init = false;
+    static FFOSResult* result;
+    static uint32_t generation;
     pthread_mutex_lock(&mutex);
-    if(init)
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
-    init = true;
-
-    FILE* osRelease = fopen("/etc/os-release", "r");
-
-    if(osRelease == NULL)
-        osRelease = fopen("/usr/lib/os-release", "r");
-
-    ffStrbufInitA(&result.error, 64);
-    if(osRelease == NULL)
-    {
-        ffStrbufAppendS(&result.error, "couldn't read /etc/os-release nor /usr/lib/os-release");
-        return &result;
-    }
-
-    ffStrbufInit(&result.systemName);
-    ffStrbufInit(&result.name);
-    ffStrbufInit(&result.prettyName);
-    ffStrbufInit(&result.id);
-    ffStrbufInit(&result.idLike);
-    ffStrbufInit(&result.variant);
-    ffStrbufInit(&result.variantID);
-    ffStrbufInit(&result.version);
-    ffStrbufInit(&result.versionID);
-    ffStrbufInit(&result.codename);
-    ffStrbufInit(&result.buildID);
-    ffStrbufInit(&result.architecture);
-    ffStrbufInit(&result.error);
-
-    ffStrbufSetS(&result.systemName, instance->state.utsname.sysname);
-    ffStrbufSetS(&result.architecture, instance->state.utsname.machine);
-
-    char* line = NULL;
-    size_t len = 0;
+    FF_TRACE_BEGIN(traceBegin);
+
+    ffStrbufInit(&result->systemName);
+    ffStrbufInit(&result->name);
+    ffStrbufInit(&result->prettyName);
+    ffStrbufInit(&result->id);
+    ffStrbufInit(&result->idLike);
+    ffStrbufInit(&result->variant);
+    ffStrbufInit(&result->variantID);
+    ffStrbufInit(&result->version);
+    ffStrbufInit(&result->versionID);
+    ffStrbufInit(&result->codename);
+    ffStrbufInit(&result->buildID);
+    ffStrbufInit(&result->architecture);
+    ffStrbufInit(&result->error);
+
+    ffStrbufSetS(&result->systemName, instance->state.utsname.sysname);
+    ffStrbufSetS(&result->architecture, instance->state.utsname.machine);
 
     // Documentation of the fields:
     // https://www.freedesktop.org/software/systemd/man/os-release.html
-    while (getline(&line, &len, osRelease) != -1)
-    {
-        ffGetPropValue(line, "NAME =", &result.name);
-        ffGetPropValue(line, "PRETTY_NAME =", &result.prettyName);
-        ffGetPropValue(line, "ID =", &result.id);
-        ffGetPropValue(line, "ID_LIKE =", &result.idLike);
-        ffGetPropValue(line, "VARIANT =", &result.variant);
-        ffGetPropValue(line, "VARIANT_ID =", &result.variantID);
-        ffGetPropValue(line, "VERSION =", &result.version);
-        ffGetPropValue(line, "VERSION_ID =", &result.versionID);
-        ffGetPropValue(line, "VERSION_CODENAME =", &result.codename);
-        ffGetPropValue(line, "BUILD_ID =", &result.buildID);
-    }
-
-    if(line != NULL)
-        free(line);
-
-    fclose(osRelease);
-
+    FFpropquery queries[] = {
+        {"NAME =", &result->name},
+        {"PRETTY_NAME =", &result->prettyName},
+        {"ID =", &result->id},
+        {"ID_LIKE =", &result->idLike},
+        {"VARIANT =", &result->variant},
+        {"VARIANT_ID =", &result->variantID},
+        {"VERSION =", &result->version},
+        {"VERSION_ID =", &result->versionID},
+        {"VERSION_CODENAME =", &result->codename},
+        {"BUILD_ID =", &result->buildID}
+    };
+
+    if(
+        !ffParsePropFileValuesFirst("/etc/os-release", (uint32_t) (sizeof(queries) / sizeof(queries[0])), queries) &&
+        !ffParsePropFileValuesFirst("/usr/lib/os-release", (uint32_t) (sizeof(queries) / sizeof(queries[0])), queries)
+    ) ffStrbufAppendS(&result->error, "couldn't read /etc/os-release nor /usr/lib/os-release");
+
+    FF_TRACE_END(traceBegin, "detect", "OS");
     pthread_mutex_unlock(&mutex);
 
-    return &result;
+    return result;
 }
 
 void ffPrintOS(FFinstance* instance)
@@ -159,3 +144,22 @@ void ffPrintOS(FFinstance* instance)
 
     ffStrbufDestroy(&os);
 }
+
+void ffJsonOS(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFOSResult* result = ffDetectOS(instance);
+    ffJsonStrbuf(writer, "systemName", &result->systemName);
+    ffJsonStrbuf(writer, "name", &result->name);
+    ffJsonStrbuf(writer, "prettyName", &result->prettyName);
+    ffJsonStrbuf(writer, "id", &result->id);
+    ffJsonStrbuf(writer, "idLike", &result->idLike);
+    ffJsonStrbuf(writer, "variant", &result->variant);
+    ffJsonStrbuf(writer, "variantID", &result->variantID);
+    ffJsonStrbuf(writer, "version", &result->version);
+    ffJsonStrbuf(writer, "versionID", &result->versionID);
+    ffJsonStrbuf(writer, "codename", &result->codename);
+    ffJsonStrbuf(writer, "buildID", &result->buildID);
+    ffJsonStrbuf(writer, "architecture", &result->architecture);
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
+}
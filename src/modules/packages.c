@@ -1,14 +1,21 @@
+#define _GNU_SOURCE //memmem
+
 #include "fastfetch.h"
 
 #include <string.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define FF_PACKAGES_MODULE_NAME "Packages"
 #define FF_PACKAGES_NUM_FORMAT_ARGS 8
 
 static uint32_t getNumElements(const char* dirname, unsigned char type)
 {
-    DIR* dirp = opendir(dirname);
+    DIR* dirp = ffSysrootOpenDir(dirname);
     if(dirp == NULL)
         return 0;
 
@@ -28,45 +35,127 @@ static uint32_t getNumElements(const char* dirname, unsigned char type)
     return num_elements;
 }
 
-static uint32_t getNumStrings(const char* filename, const char* needle)
+//Counts the lines starting with needle. The file is mapped instead of read line by line, dpkg's status file can be several MB
+static uint32_t getNumLinesStartingWith(const char* filename, const char* needle)
 {
-    FILE* file = fopen(filename, "r");
-    if(file == NULL)
+    int fd = ffSysrootOpen(filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
         return 0;
 
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t) st.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return 0;
+
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    size_t needleLength = strlen(needle);
     uint32_t count = 0;
 
-    char* line = NULL;
-    size_t len = 0;
+    if(size >= needleLength && memcmp(data, needle, needleLength) == 0)
+        ++count;
+
+    //Search for "\n<needle>", so only matches at the start of a line count
+    char lineNeedle[32];
+    lineNeedle[0] = '\n';
+    memcpy(lineNeedle + 1, needle, needleLength);
 
-    while(getline(&line, &len, file) != EOF)
+    const char* current = data;
+    const char* end = data + size;
+    while((current = memmem(current, (size_t) (end - current), lineNeedle, needleLength + 1)) != NULL)
     {
-        if(strstr(line, needle) != NULL)
-            ++count;
+        ++count;
+        current += needleLength + 1;
     }
 
-    if(line != NULL)
-        free(line);
+    munmap((void*) data, size);
+    return count;
+}
 
-    fclose(file);
+//Returns false if the count must be detected again, because the database of the manager changed since it was cached
+static bool getCachedCount(FFinstance* instance, const char* cacheName, uint32_t* count)
+{
+    FF_STRBUF_CREATE(value);
+    bool cached = ffCacheGetValue(instance, cacheName, &value);
+    if(cached)
+        *count = (uint32_t) strtoul(value.chars, NULL, 10);
+    ffStrbufDestroy(&value);
+    return cached;
+}
 
-    return count;
+static void setCachedCount(FFinstance* instance, const char* cacheName, uint32_t count)
+{
+    FFcache cache;
+    ffCacheOpenWrite(instance, cacheName, &cache);
+    ffStrbufAppendUInt(&cache.value, count);
+    ffStrbufAppendC(&cache.value, '\0');
+    ffCacheClose(&cache);
 }
 
-void ffPrintPackages(FFinstance* instance)
+const FFPackagesResult* ffDetectPackages(FFinstance* instance)
 {
-    uint32_t pacman = getNumElements("/var/lib/pacman/local", DT_DIR);
-    uint32_t dpkg = getNumStrings("/var/lib/dpkg/status", "Status: ");
-    uint32_t rpm = ffSettingsGetSQLiteColumnCount(instance, "/var/lib/rpm/rpmdb.sqlite", "Packages");
-    uint32_t xbps = getNumElements("/var/db/xbps", DT_REG);
-    uint32_t flatpak = getNumElements("/var/lib/flatpak/app", DT_DIR);
-    uint32_t snap = getNumElements("/snap", DT_DIR);
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFPackagesResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return result;
+    }
+    FF_TRACE_BEGIN(traceBegin);
+
+    #define FF_COUNT_PACKAGES(name, cacheName, expression) \
+        if(!getCachedCount(instance, cacheName, &result->name)) \
+        { \
+            result->name = expression; \
+            setCachedCount(instance, cacheName, result->name); \
+        }
+
+    //SQLite opens the database by path itself
+    FF_STRBUF_CREATE(rpmdb);
+    ffSysrootAppendPath(&rpmdb, "/var/lib/rpm/rpmdb.sqlite");
+
+    //The keys the counts are cached with are defined in cacheInputs in io.c
+    FF_COUNT_PACKAGES(pacman, "PackagesPacman", getNumElements("/var/lib/pacman/local", DT_DIR));
+    FF_COUNT_PACKAGES(dpkg, "PackagesDpkg", getNumLinesStartingWith("/var/lib/dpkg/status", "Status: "));
+    FF_COUNT_PACKAGES(rpm, "PackagesRpm", ffSettingsGetSQLiteColumnCount(instance, rpmdb.chars, "Packages"));
+    FF_COUNT_PACKAGES(xbps, "PackagesXbps", getNumElements("/var/db/xbps", DT_REG));
+    FF_COUNT_PACKAGES(flatpak, "PackagesFlatpak", getNumElements("/var/lib/flatpak/app", DT_DIR));
+    FF_COUNT_PACKAGES(snap, "PackagesSnap", getNumElements("/snap", DT_DIR));
+
+    #undef FF_COUNT_PACKAGES
+
+    ffStrbufDestroy(&rpmdb);
 
     //Accounting for the /snap/bin folder
-    if(snap > 0)
-        --snap;
+    if(result->snap > 0)
+        --result->snap;
 
-    uint32_t all = pacman + dpkg + rpm + xbps + flatpak + snap;
+    result->all = result->pacman + result->dpkg + result->rpm + result->xbps + result->flatpak + result->snap;
+
+    ffStrbufInit(&result->manjaroBranch);
+    if(ffParsePropFile("/etc/pacman-mirrors.conf", "Branch =", &result->manjaroBranch) && result->manjaroBranch.length == 0)
+        ffStrbufSetS(&result->manjaroBranch, "stable");
+
+    FF_TRACE_END(traceBegin, "detect", "Packages");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void ffPrintPackages(FFinstance* instance)
+{
+    const FFPackagesResult* result = ffDetectPackages(instance);
+
+    uint32_t all = result->all;
 
     if(all == 0)
     {
@@ -74,30 +163,27 @@ void ffPrintPackages(FFinstance* instance)
         return;
     }
 
-    FFstrbuf manjaroBranch;
-    ffStrbufInit(&manjaroBranch);
-    if(ffParsePropFile("/etc/pacman-mirrors.conf", "Branch =", &manjaroBranch) && manjaroBranch.length == 0)
-        ffStrbufSetS(&manjaroBranch, "stable");
-
     if(instance->config.packagesFormat.length == 0)
     {
-        ffPrintLogoAndKey(instance, FF_PACKAGES_MODULE_NAME, 0, &instance->config.batteryKey);
+        ffPrintLogoAndKey(instance, FF_PACKAGES_MODULE_NAME, 0, &instance->config.packagesKey);
 
         #define FF_PRINT_PACKAGE(name) \
-        if(name > 0) \
+        if(result->name > 0) \
         { \
-            printf("%u ("#name")", name); \
-            if((all = all - name) > 0) \
-                printf(", "); \
+            ffOutputAppendUInt(result->name); \
+            ffOutputAppendS(" ("#name")"); \
+            if((all = all - result->name) > 0) \
+                ffOutputAppendS(", "); \
         };
 
-        if(pacman > 0)
+        if(result->pacman > 0)
         {
-            printf("%u (pacman)", pacman);
-            if(manjaroBranch.length > 0)
-                printf("[%s]", manjaroBranch.chars);
-            if((all = all - pacman) > 0)
-                printf(", ");
+            ffOutputAppendUInt(result->pacman);
+            ffOutputAppendS(" (pacman)");
+            if(result->manjaroBranch.length > 0)
+                ffOutputAppendF("[%s]", result->manjaroBranch.chars);
+            if((all = all - result->pacman) > 0)
+                ffOutputAppendS(", ");
         };
 
         FF_PRINT_PACKAGE(dpkg)
@@ -111,21 +197,32 @@ void ffPrintPackages(FFinstance* instance)
 
         #undef FF_PRINT_PACKAGE
 
-        putchar('\n');
+        ffOutputAppendC('\n');
     }
     else
     {
         ffPrintFormatString(instance, FF_PACKAGES_MODULE_NAME, 0, &instance->config.packagesKey, &instance->config.packagesFormat, NULL, FF_PACKAGES_NUM_FORMAT_ARGS, (FFformatarg[]){
-            {FF_FORMAT_ARG_TYPE_UINT, &all},
-            {FF_FORMAT_ARG_TYPE_UINT, &pacman},
-            {FF_FORMAT_ARG_TYPE_STRBUF, &manjaroBranch},
-            {FF_FORMAT_ARG_TYPE_UINT, &dpkg},
-            {FF_FORMAT_ARG_TYPE_UINT, &rpm},
-            {FF_FORMAT_ARG_TYPE_UINT, &xbps},
-            {FF_FORMAT_ARG_TYPE_UINT, &flatpak},
-            {FF_FORMAT_ARG_TYPE_UINT, &snap}
+            {FF_FORMAT_ARG_TYPE_UINT, &result->all},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->pacman},
+            {FF_FORMAT_ARG_TYPE_STRBUF, &result->manjaroBranch},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->dpkg},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->rpm},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->xbps},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->flatpak},
+            {FF_FORMAT_ARG_TYPE_UINT, &result->snap}
         });
     }
+}
 
-    ffStrbufDestroy(&manjaroBranch);
+void ffJsonPackages(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFPackagesResult* result = ffDetectPackages(instance);
+    ffJsonUInt(writer, "all", result->all);
+    ffJsonUInt(writer, "pacman", result->pacman);
+    ffJsonUInt(writer, "dpkg", result->dpkg);
+    ffJsonUInt(writer, "rpm", result->rpm);
+    ffJsonUInt(writer, "xbps", result->xbps);
+    ffJsonUInt(writer, "flatpak", result->flatpak);
+    ffJsonUInt(writer, "snap", result->snap);
+    ffJsonStrbuf(writer, "manjaroBranch", &result->manjaroBranch);
 }
@@ -10,7 +10,7 @@
 #define FF_RESOLUTION_MODULE_NAME "Resolution"
 #define FF_RESOLUTION_NUM_FORMAT_ARGS 3
 
-#define FF_LIBRARY_LOAD(libraryNameUser, libraryNameDefault) dlopen(libraryNameUser.length == 0 ? libraryNameDefault : libraryNameUser.chars, RTLD_LAZY); \
+#define FF_LIBRARY_LOAD(libraryNameUser, libraryNameDefault) ffTraceDlopen(libraryNameUser.length == 0 ? libraryNameDefault : libraryNameUser.chars, RTLD_LAZY); \
     if(dlerror() != NULL) \
         return false;
 
@@ -22,45 +22,6 @@
 
 typedef void* DynamicLibrary;
 
-typedef struct ResolutionResult
-{
-    int width;
-    int height;
-    int refreshRate;
-} ResolutionResult;
-
-static bool printResolutionResultList(FFinstance* instance, FFlist* results)
-{
-    for(uint32_t i = 0; i < results->length; i++)
-    {
-        ResolutionResult* result = ffListGet(results, i);
-        uint8_t moduleIndex = results->length == 1 ? 0 : i + 1;
-
-        if(instance->config.resolutionFormat.length == 0)
-        {
-            ffPrintLogoAndKey(instance, FF_RESOLUTION_MODULE_NAME, moduleIndex, &instance->config.resolutionKey);
-            printf("%ix%i", result->width, result->height);
-
-            if(result->refreshRate > 0)
-                printf(" @ %iHz", result->refreshRate);
-
-            putchar('\n');
-        }
-        else
-        {
-            ffPrintFormatString(instance, FF_RESOLUTION_MODULE_NAME, moduleIndex, &instance->config.resolutionKey, &instance->config.resolutionFormat, NULL, FF_RESOLUTION_NUM_FORMAT_ARGS, (FFformatarg[]) {
-                {FF_FORMAT_ARG_TYPE_INT, &result->width},
-                {FF_FORMAT_ARG_TYPE_INT, &result->height},
-                {FF_FORMAT_ARG_TYPE_INT, &result->refreshRate}
-            });
-        }
-    }
-
-    bool res = results->length > 0;
-    ffListDestroy(results);
-    return res;
-}
-
 static int parseRefreshRate(int32_t refreshRate)
 {
     if(refreshRate <= 0)
@@ -79,14 +40,14 @@ static int parseRefreshRate(int32_t refreshRate)
     return refreshRate;
 }
 
-static void printResolutionDRMBackend(FFinstance* instance)
+static void detectResolutionDRMBackend(FFResolutionResult* result)
 {
     const char* drmDirPath = "/sys/class/drm/";
 
-    DIR* dirp = opendir(drmDirPath);
+    DIR* dirp = ffSysrootOpenDir(drmDirPath);
     if(dirp == NULL)
     {
-        ffPrintError(instance, FF_RESOLUTION_MODULE_NAME, 0, &instance->config.resolutionKey, &instance->config.resolutionFormat, FF_RESOLUTION_NUM_FORMAT_ARGS, "Couldn't connect to a display server or open %s", drmDirPath);
+        ffStrbufAppendF(&result->error, "Couldn't connect to a display server or open %s", drmDirPath);
         return;
     }
 
@@ -96,9 +57,6 @@ static void printResolutionDRMBackend(FFinstance* instance)
 
     uint32_t drmDirLength = drmDir.length;
 
-    FFlist modes;
-    ffListInitA(&modes, sizeof(ResolutionResult), 4);
-
     struct dirent* entry;
 
     while((entry = readdir(dirp)) != NULL)
@@ -106,21 +64,21 @@ static void printResolutionDRMBackend(FFinstance* instance)
         ffStrbufAppendS(&drmDir, entry->d_name);
         ffStrbufAppendS(&drmDir, "/modes");
 
-        FILE* modeFile = fopen(drmDir.chars, "r");
+        FILE* modeFile = ffSysrootOpenFile(drmDir.chars);
         if(modeFile == NULL)
         {
             ffStrbufSubstrBefore(&drmDir, drmDirLength);
             continue;
         }
 
-        ResolutionResult* result = ffListAdd(&modes);
-        result->width = 0;
-        result->height = 0;
-        result->refreshRate = 0;
+        FFResolution* resolution = ffListAdd(&result->resolutions);
+        resolution->width = 0;
+        resolution->height = 0;
+        resolution->refreshRate = 0;
 
-        int scanned = fscanf(modeFile, "%ix%i", &result->width, &result->height);
-        if(scanned < 2 || result->width == 0 || result->height == 0)
-            --modes.length;
+        int scanned = fscanf(modeFile, "%ix%i", &resolution->width, &resolution->height);
+        if(scanned < 2 || resolution->width == 0 || resolution->height == 0)
+            --result->resolutions.length;
 
         fclose(modeFile);
         ffStrbufSubstrBefore(&drmDir, drmDirLength);
@@ -129,14 +87,8 @@ static void printResolutionDRMBackend(FFinstance* instance)
     closedir(dirp);
     ffStrbufDestroy(&drmDir);
 
-    if(modes.length == 0)
-    {
-        ffPrintError(instance, FF_RESOLUTION_MODULE_NAME, 0, &instance->config.resolutionKey, &instance->config.resolutionFormat, FF_RESOLUTION_NUM_FORMAT_ARGS, "Couldn't connect to a display server or find a resolution in %s", drmDirPath);
-        ffListDestroy(&modes);
-        return;
-    }
-
-    printResolutionResultList(instance, &modes);
+    if(result->resolutions.length == 0)
+        ffStrbufAppendF(&result->error, "Couldn't connect to a display server or find a resolution in %s", drmDirPath);
 }
 
 static void x11AddScreenAsResult(FFlist* results, Screen* screen, int refreshRate)
@@ -144,13 +96,13 @@ static void x11AddScreenAsResult(FFlist* results, Screen* screen, int refreshRat
     if(WidthOfScreen(screen) == 0 || HeightOfScreen(screen) == 0)
         return;
 
-    ResolutionResult* result = ffListAdd(results);
+    FFResolution* result = ffListAdd(results);
     result->width = WidthOfScreen(screen);
     result->height = HeightOfScreen(screen);
     result->refreshRate = refreshRate;
 }
 
-static bool printResolutionX11Backend(FFinstance* instance)
+static bool detectResolutionX11Backend(FFinstance* instance, FFResolutionResult* result)
 {
     DynamicLibrary x11 = FF_LIBRARY_LOAD(instance->config.libX11, "libX11.so");
 
@@ -164,16 +116,13 @@ static bool printResolutionX11Backend(FFinstance* instance)
         return false;
     }
 
-    FFlist results;
-    ffListInitA(&results, sizeof(ResolutionResult), 4);
-
     for(int i = 0; i < ScreenCount(display); i++)
-        x11AddScreenAsResult(&results, ScreenOfDisplay(display, i), 0);
+        x11AddScreenAsResult(&result->resolutions, ScreenOfDisplay(display, i), 0);
 
     ffXCloseDisplay(display);
     dlclose(x11);
 
-    return printResolutionResultList(instance, &results);
+    return result->resolutions.length > 0;
 }
 
 typedef struct XrandrData
@@ -192,7 +141,7 @@ typedef struct XrandrData
 
     //Init once
     Display* display;
-    FFlist results;
+    FFlist* results;
 
     //Init per screen
     int defaultRefreshRate;
@@ -222,7 +171,7 @@ static bool xrandrHandleOutputInfo(XrandrData* data, XRROutputInfo* outputInfo)
         return false;
     }
 
-    ResolutionResult* result = ffListAdd(&data->results);
+    FFResolution* result = ffListAdd(data->results);
     result->width = modeInfo->width;
     result->height = modeInfo->height;
     result->refreshRate = parseRefreshRate(modeInfo->dotClock / (modeInfo->hTotal * modeInfo->vTotal));
@@ -240,7 +189,7 @@ static bool xrandrHandleMonitorFallback(XrandrData* data, XRRMonitorInfo* monito
     if(monitorInfo->width == 0 || monitorInfo->height == 0)
         return false;
 
-    ResolutionResult* result = ffListAdd(&data->results);
+    FFResolution* result = ffListAdd(data->results);
     result->width = monitorInfo->width;
     result->height = monitorInfo->height;
     result->refreshRate = data->defaultRefreshRate;
@@ -299,7 +248,7 @@ static void xrandrHandleScreen(XrandrData* data, Screen* screen)
     XRRMonitorInfo* monitorInfos = data->ffXRRGetMonitors(data->display, window, True, &numberOfMonitors);
     if(monitorInfos == NULL)
     {
-        x11AddScreenAsResult(&data->results, screen, data->defaultRefreshRate);
+        x11AddScreenAsResult(data->results, screen, data->defaultRefreshRate);
         return;
     }
 
@@ -313,13 +262,13 @@ static void xrandrHandleScreen(XrandrData* data, Screen* screen)
         foundAMonitor = xrandrLoopMonitors(data, monitorInfos, numberOfMonitors, xrandrHandleMonitorFallback);
 
     if(!foundAMonitor)
-        x11AddScreenAsResult(&data->results, screen, data->defaultRefreshRate);
+        x11AddScreenAsResult(data->results, screen, data->defaultRefreshRate);
 
     data->ffXRRFreeScreenResources(data->screenResources);
     data->ffXRRFreeMonitors(monitorInfos);
 }
 
-static bool printResolutionXrandrBackend(FFinstance* instance)
+static bool detectResolutionXrandrBackend(FFinstance* instance, FFResolutionResult* result)
 {
     DynamicLibrary xrandr = FF_LIBRARY_LOAD(instance->config.libXrandr, "libXrandr.so");
 
@@ -347,7 +296,7 @@ static bool printResolutionXrandrBackend(FFinstance* instance)
         return false;
     }
 
-    ffListInitA(&data.results, sizeof(ResolutionResult), 4);
+    data.results = &result->resolutions;
 
     for(int i = 0; i < ScreenCount(data.display); i++)
         xrandrHandleScreen(&data, ScreenOfDisplay(data.display, i));
@@ -355,13 +304,12 @@ static bool printResolutionXrandrBackend(FFinstance* instance)
     ffXCloseDisplay(data.display);
     dlclose(xrandr);
 
-    return printResolutionResultList(instance, &data.results);
+    return result->resolutions.length > 0;
 }
 
 typedef struct WaylandData
 {
-    FFinstance* instance;
-    FFlist results;
+    FFlist* results;
     struct wl_proxy*(*ffwl_proxy_marshal_constructor_versioned)(struct wl_proxy*, uint32_t, const struct wl_interface*, uint32_t, ...);
     int(*ffwl_proxy_add_listener)(struct wl_proxy*, void (**)(void), void *data);
     void(*ffwl_proxy_destroy)(struct wl_proxy*);
@@ -417,7 +365,7 @@ static void waylandOutputModeListener(void* data, struct wl_output* output, uint
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
     pthread_mutex_lock(&mutex);
 
-    ResolutionResult* result = ffListAdd(&wldata->results);
+    FFResolution* result = ffListAdd(wldata->results);
 
     pthread_mutex_unlock(&mutex);
 
@@ -440,7 +388,7 @@ static void waylandGlobalAddListener(void* data, struct wl_registry* registry, u
     }
 }
 
-static bool printResolutionWaylandBackend(FFinstance* instance)
+static bool detectResolutionWaylandBackend(FFinstance* instance, FFResolutionResult* result)
 {
     const char* sessionType = getenv("XDG_SESSION_TYPE");
     if(sessionType != NULL && strcasecmp(sessionType, "wayland") != 0)
@@ -477,8 +425,7 @@ static bool printResolutionWaylandBackend(FFinstance* instance)
         return false;
     }
 
-    data.instance = instance;
-    ffListInitA(&data.results, sizeof(ResolutionResult), 4);
+    data.results = &result->resolutions;
 
     struct wl_registry_listener regestry_listener;
     regestry_listener.global = waylandGlobalAddListener;
@@ -497,19 +444,97 @@ static bool printResolutionWaylandBackend(FFinstance* instance)
     ffwl_display_disconnect(display);
     dlclose(wayland);
 
-    return printResolutionResultList(instance, &data.results);
+    return result->resolutions.length > 0;
 }
 
-void ffPrintResolution(FFinstance* instance)
+const FFResolutionResult* ffDetectResolution(FFinstance* instance)
 {
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    static FFResolutionResult* result;
+    static uint32_t generation;
+    pthread_mutex_lock(&mutex);
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
+    {
+        pthread_mutex_unlock(&mutex);
+        return result;
+    }
+    FF_TRACE_BEGIN(traceBegin);
+
+    ffListInitA(&result->resolutions, sizeof(FFResolution), 4);
+    ffStrbufInit(&result->error);
+
     if(
-        printResolutionWaylandBackend(instance) ||
-        printResolutionXrandrBackend(instance) ||
-        printResolutionX11Backend(instance)
-    ) return;
+        !detectResolutionWaylandBackend(instance, result) &&
+        !detectResolutionXrandrBackend(instance, result) &&
+        !detectResolutionX11Backend(instance, result)
+    ) detectResolutionDRMBackend(result);
 
-    printResolutionDRMBackend(instance);
+    FF_TRACE_END(traceBegin, "detect", "Resolution");
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+void ffPrintResolution(FFinstance* instance)
+{
+    const FFResolutionResult* result = ffDetectResolution(instance);
+
+    if(result->error.length > 0)
+    {
+        ffPrintError(instance, FF_RESOLUTION_MODULE_NAME, 0, &instance->config.resolutionKey, &instance->config.resolutionFormat, FF_RESOLUTION_NUM_FORMAT_ARGS, result->error.chars);
+        return;
+    }
+
+    for(uint32_t i = 0; i < result->resolutions.length; i++)
+    {
+        FFResolution* resolution = ffListGet(&result->resolutions, i);
+        uint8_t moduleIndex = result->resolutions.length == 1 ? 0 : (uint8_t) (i + 1);
+
+        if(instance->config.resolutionFormat.length == 0)
+        {
+            ffPrintLogoAndKey(instance, FF_RESOLUTION_MODULE_NAME, moduleIndex, &instance->config.resolutionKey);
+            ffOutputAppendInt(resolution->width);
+            ffOutputAppendC('x');
+            ffOutputAppendInt(resolution->height);
+
+            if(resolution->refreshRate > 0)
+            {
+                ffOutputAppendS(" @ ");
+                ffOutputAppendInt(resolution->refreshRate);
+                ffOutputAppendS("Hz");
+            }
+
+            ffOutputAppendC('\n');
+        }
+        else
+        {
+            ffPrintFormatString(instance, FF_RESOLUTION_MODULE_NAME, moduleIndex, &instance->config.resolutionKey, &instance->config.resolutionFormat, NULL, FF_RESOLUTION_NUM_FORMAT_ARGS, (FFformatarg[]) {
+                {FF_FORMAT_ARG_TYPE_INT, &resolution->width},
+                {FF_FORMAT_ARG_TYPE_INT, &resolution->height},
+                {FF_FORMAT_ARG_TYPE_INT, &resolution->refreshRate}
+            });
+        }
+    }
 }
 
 #undef FF_LIBRARY_LOAD
 #undef FF_LIBRARY_LOAD_SYMBOL
+
+void ffJsonResolution(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFResolutionResult* result = ffDetectResolution(instance);
+
+    ffJsonBeginArray(writer, "resolutions");
+    for(uint32_t i = 0; i < result->resolutions.length; i++)
+    {
+        const FFResolution* resolution = ffListGet(&result->resolutions, i);
+        ffJsonBeginObject(writer, NULL);
+        ffJsonInt(writer, "width", resolution->width);
+        ffJsonInt(writer, "height", resolution->height);
+        ffJsonInt(writer, "refreshRate", resolution->refreshRate);
+        ffJsonEndObject(writer);
+    }
+    ffJsonEndArray(writer);
+
+    if(result->error.length > 0)
+        ffJsonStrbuf(writer, "error", &result->error);
+}
@@ -7,7 +7,6 @@ void ffPrintSeparator(FFinstance* instance)
 
     ffPrintLogoLine(instance);
 
-    for(uint32_t i = 0; i < titleLength; i++)
-        putchar('-');
-    putchar('\n');
+    ffOutputAppendNC(titleLength, '-');
+    ffOutputAppendC('\n');
 }
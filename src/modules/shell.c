@@ -19,15 +19,15 @@ void ffPrintShell(FFinstance* instance)
     if(instance->config.shellFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_SHELL_MODULE_NAME, 0, &instance->config.shellKey);
-        fputs(result->shellExeName, stdout);
+        ffOutputAppendS(result->shellExeName);
 
         if(result->shellVersion.length > 0)
         {
-            putchar(' ');
-            ffStrbufWriteTo(&result->shellVersion, stdout);
+            ffOutputAppendC(' ');
+            ffOutputAppend(&result->shellVersion);
         }
 
-        putchar('\n');
+        ffOutputAppendC('\n');
     }
     else
     {
@@ -42,3 +42,13 @@ void ffPrintShell(FFinstance* instance)
         });
     }
 }
+
+void ffJsonShell(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFTerminalShellResult* result = ffDetectTerminalShell(instance);
+    ffJsonStrbuf(writer, "processName", &result->shellProcessName);
+    ffJsonStrbuf(writer, "exe", &result->shellExe);
+    ffJsonStrbuf(writer, "version", &result->shellVersion);
+    ffJsonStrbuf(writer, "userShellExe", &result->userShellExe);
+    ffJsonStrbuf(writer, "userShellVersion", &result->userShellVersion);
+}
@@ -20,7 +20,7 @@ void ffPrintTerminal(FFinstance* instance)
     if(instance->config.terminalFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_TERMINAL_MODULE_NAME, 0, &instance->config.terminalKey);
-        puts(result->terminalExeName);
+        ffOutputPutS(result->terminalExeName);
     }
     else
     {
@@ -31,3 +31,10 @@ void ffPrintTerminal(FFinstance* instance)
         });
     }
 }
+
+void ffJsonTerminal(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFTerminalShellResult* result = ffDetectTerminalShell(instance);
+    ffJsonStrbuf(writer, "processName", &result->terminalProcessName);
+    ffJsonStrbuf(writer, "exe", &result->terminalExe);
+}
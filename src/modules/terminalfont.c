@@ -14,7 +14,7 @@ static void printTerminalFont(FFinstance* instance, const char* raw, FFfont* fon
     if(instance->config.termFontFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_TERMFONT_MODULE_NAME, 0, &instance->config.termFontKey);
-        ffStrbufPutTo(&font->pretty, stdout);
+        ffOutputPut(&font->pretty);
     }
     else
     {
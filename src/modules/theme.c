@@ -41,37 +41,37 @@ void ffPrintTheme(FFinstance* instance)
 
         if(plasma->widgetStyle.length > 0)
         {
-            ffStrbufWriteTo(&plasma->widgetStyle, stdout);
+            ffOutputAppend(&plasma->widgetStyle);
 
             if(plasma->colorScheme.length > 0)
             {
-                fputs(" (", stdout);
+                ffOutputAppendS(" (");
 
                 if(plasmaColorPretty.length > 0)
-                    ffStrbufWriteTo(&plasmaColorPretty, stdout);
+                    ffOutputAppend(&plasmaColorPretty);
                 else
-                    ffStrbufWriteTo(&plasma->colorScheme, stdout);
+                    ffOutputAppend(&plasma->colorScheme);
 
-                putchar(')');
+                ffOutputAppendC(')');
             }
         }
         else if(plasma->colorScheme.length > 0)
         {
             if(plasmaColorPretty.length > 0)
-                ffStrbufWriteTo(&plasmaColorPretty, stdout);
+                ffOutputAppend(&plasmaColorPretty);
             else
-                ffStrbufWriteTo(&plasma->colorScheme, stdout);
+                ffOutputAppend(&plasma->colorScheme);
         }
 
         if(plasma->widgetStyle.length > 0 || plasma->colorScheme.length > 0)
         {
-            fputs(" [Plasma]", stdout);
+            ffOutputAppendS(" [Plasma]");
 
             if(gtkPretty.length > 0)
-                fputs(", ", stdout);
+                ffOutputAppendS(", ");
         }
 
-        ffStrbufPutTo(&gtkPretty, stdout);
+        ffOutputPut(&gtkPretty);
     }
     else
     {
@@ -89,3 +89,21 @@ void ffPrintTheme(FFinstance* instance)
     ffStrbufDestroy(&plasmaColorPretty);
     ffStrbufDestroy(&gtkPretty);
 }
+
+void ffJsonTheme(FFinstance* instance, FFjsonwriter* writer)
+{
+    //Same check as the printed value, so no settings library is loaded in a TTY
+    if(ffStrbufIgnCaseCompS(&ffDetectWMDE(instance)->wmProtocolName, "TTY") == 0)
+    {
+        ffJsonString(writer, "error", "Theme isn't supported in TTY");
+        return;
+    }
+
+    const FFPlasmaResult* plasma = ffDetectPlasma(instance);
+    ffJsonStrbuf(writer, "plasmaWidgetStyle", &plasma->widgetStyle);
+    ffJsonStrbuf(writer, "plasmaColorScheme", &plasma->colorScheme);
+
+    ffJsonStrbuf(writer, "gtk2", &ffDetectGTK2(instance)->theme);
+    ffJsonStrbuf(writer, "gtk3", &ffDetectGTK3(instance)->theme);
+    ffJsonStrbuf(writer, "gtk4", &ffDetectGTK4(instance)->theme);
+}
@@ -6,34 +6,35 @@
 const FFTitleResult* ffDetectTitle(FFinstance* instance)
 {
     static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    static bool init = false;
-    static FFTitleResult result;
+    static uint32_t generation;
+    static FFTitleResult* result;
 
     pthread_mutex_lock(&mutex);
-    if(init)
+    if(!ffDetectionInit(instance, (void**) &result, sizeof(*result), &generation))
     {
         pthread_mutex_unlock(&mutex);
-        return &result;
+        return result;
     }
-    init = true;
+    FF_TRACE_BEGIN(traceBegin);
 
-    ffStrbufInit(&result.userName);
-    ffStrbufAppendS(&result.userName, instance->state.passwd->pw_name);
+    ffStrbufInit(&result->userName);
+    ffStrbufAppendS(&result->userName, instance->state.passwd->pw_name);
 
-    ffStrbufInitA(&result.hostname, 256);
-    gethostname(result.hostname.chars, result.hostname.allocated);
-    ffStrbufRecalculateLength(&result.hostname);
+    ffStrbufInitA(&result->hostname, 256);
+    gethostname(result->hostname.chars, result->hostname.allocated);
+    ffStrbufRecalculateLength(&result->hostname);
 
+    FF_TRACE_END(traceBegin, "detect", "Title");
     pthread_mutex_unlock(&mutex);
-    return &result;
+    return result;
 }
 
 static inline void printTitlePart(FFinstance* instance, const FFstrbuf* content)
 {
-    fputs(FASTFETCH_TEXT_MODIFIER_BOLT, stdout);
-    ffStrbufWriteTo(&instance->config.color, stdout);
-    ffStrbufWriteTo(content, stdout);
-    fputs(FASTFETCH_TEXT_MODIFIER_RESET, stdout);
+    ffOutputAppendS(FASTFETCH_TEXT_MODIFIER_BOLT);
+    ffOutputAppend(&instance->config.color);
+    ffOutputAppend(content);
+    ffOutputAppendS(FASTFETCH_TEXT_MODIFIER_RESET);
 }
 
 void ffPrintTitle(FFinstance* instance)
@@ -43,7 +44,14 @@ void ffPrintTitle(FFinstance* instance)
     ffPrintLogoLine(instance);
 
     printTitlePart(instance, &result->userName);
-    putchar('@');
+    ffOutputAppendC('@');
     printTitlePart(instance, &result->hostname);
-    putchar('\n');
+    ffOutputAppendC('\n');
+}
+
+void ffJsonTitle(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFTitleResult* result = ffDetectTitle(instance);
+    ffJsonStrbuf(writer, "userName", &result->userName);
+    ffJsonStrbuf(writer, "hostname", &result->hostname);
 }
@@ -16,17 +16,27 @@ void ffPrintUptime(FFinstance* instance)
 
         if(days == 0 && hours == 0 && minutes == 0)
         {
-            printf("%u seconds\n", seconds);
+            ffOutputAppendUInt(seconds);
+            ffOutputAppendS(" seconds\n");
         }
         else
         {
             if(days > 0)
-                printf("%u day%s, ", days, days <= 1 ? "" : "s");
+            {
+                ffOutputAppendUInt(days);
+                ffOutputAppendS(days <= 1 ? " day, " : " days, ");
+            }
             if(hours > 0)
-                printf("%u hour%s, ", hours, hours <= 1 ? "" : "s");
+            {
+                ffOutputAppendUInt(hours);
+                ffOutputAppendS(hours <= 1 ? " hour, " : " hours, ");
+            }
             if(minutes > 0)
-                printf("%u min%s", minutes, minutes <= 1 ? "" : "s");
-            putchar('\n');
+            {
+                ffOutputAppendUInt(minutes);
+                ffOutputAppendS(minutes <= 1 ? " min" : " mins");
+            }
+            ffOutputAppendC('\n');
         }
     }
     else
@@ -39,3 +49,8 @@ void ffPrintUptime(FFinstance* instance)
         });
     }
 }
+
+void ffJsonUptime(FFinstance* instance, FFjsonwriter* writer)
+{
+    ffJsonInt(writer, "seconds", instance->state.sysinfo.uptime);
+}
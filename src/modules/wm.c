@@ -19,23 +19,23 @@ void ffPrintWM(FFinstance* instance)
 
         if(result->wmPrettyName.length == 0 && result->wmProcessName.length == 0)
         {
-            ffStrbufPutTo(&result->wmProtocolName, stdout);
+            ffOutputPut(&result->wmProtocolName);
         }
         else
         {
             if(result->wmPrettyName.length > 0)
-                ffStrbufWriteTo(&result->wmPrettyName, stdout);
+                ffOutputAppend(&result->wmPrettyName);
             else
-                ffStrbufWriteTo(&result->wmProcessName, stdout);
+                ffOutputAppend(&result->wmProcessName);
 
             if(result->wmProtocolName.length > 0)
             {
-                fputs(" (", stdout);
-                ffStrbufWriteTo(&result->wmProtocolName, stdout);
-                putchar(')');
+                ffOutputAppendS(" (");
+                ffOutputAppend(&result->wmProtocolName);
+                ffOutputAppendC(')');
             }
 
-            putchar('\n');
+            ffOutputAppendC('\n');
         }
     }
     else
@@ -48,3 +48,11 @@ void ffPrintWM(FFinstance* instance)
         });
     }
 }
+
+void ffJsonWM(FFinstance* instance, FFjsonwriter* writer)
+{
+    const FFWMDEResult* result = ffDetectWMDE(instance);
+    ffJsonStrbuf(writer, "processName", &result->wmProcessName);
+    ffJsonStrbuf(writer, "prettyName", &result->wmPrettyName);
+    ffJsonStrbuf(writer, "protocolName", &result->wmProtocolName);
+}
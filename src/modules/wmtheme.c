@@ -9,7 +9,7 @@ static void printWMTheme(FFinstance* instance, const char* theme)
     if(instance->config.wmThemeFormat.length == 0)
     {
         ffPrintLogoAndKey(instance, FF_WMTHEME_MODULE_NAME, 0, &instance->config.wmThemeKey);
-        puts(theme);
+        ffOutputPutS(theme);
     }
     else
     {
@@ -174,7 +174,7 @@ static void printOpenbox(FFinstance* instance, const FFstrbuf* dePrettyName)
     char* line = NULL;
     size_t len = 0;
 
-    FILE* file = fopen(absolutePath.chars, "r");
+    FILE* file = ffSysrootOpenFile(absolutePath.chars);
     if(file == NULL)
     {
         ffPrintError(instance, FF_WMTHEME_MODULE_NAME, 0, &instance->config.wmThemeKey, &instance->config.wmThemeFormat, FF_WMTHEME_NUM_FORMAT_ARGS, "Couldn't open \"%s\"", absolutePath.chars);
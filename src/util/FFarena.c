@@ -0,0 +1,188 @@
+#include "FFarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FF_ARENA_FIRST_CHUNK_SIZE (16 * 1024)
+#define FF_ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+#define FF_ARENA_ALIGNMENT 16
+
+struct FFarenachunk
+{
+    FFarenachunk* next;
+    size_t size;
+    size_t used;
+    size_t last; //Offset of the newest allocation, which can grow in place
+    char data[]; //The header is a multiple of FF_ARENA_ALIGNMENT
+};
+
+static uint32_t generations;
+static FFarena* current;
+
+static inline size_t alignSize(size_t size)
+{
+    return (size + FF_ARENA_ALIGNMENT - 1) & ~(size_t) (FF_ARENA_ALIGNMENT - 1);
+}
+
+void ffArenaInit(FFarena* arena)
+{
+    pthread_mutex_init(&arena->mutex, NULL);
+    arena->chunks = NULL;
+    arena->generation = __atomic_add_fetch(&generations, 1, __ATOMIC_RELAXED);
+}
+
+//Must be called with the mutex locked
+static void* arenaAlloc(FFarena* arena, size_t size)
+{
+    //Zero sized allocations would share their address with the next one, which could then be grown over
+    size = alignSize(size == 0 ? 1 : size);
+
+    FFarenachunk* chunk = arena->chunks;
+    if(chunk == NULL || chunk->size - chunk->used < size)
+    {
+        //Every chunk is twice as large as the one before, so even long runs only need a few
+        size_t chunkSize = chunk == NULL ? FF_ARENA_FIRST_CHUNK_SIZE : chunk->size * 2;
+        if(chunkSize > FF_ARENA_MAX_CHUNK_SIZE)
+            chunkSize = FF_ARENA_MAX_CHUNK_SIZE;
+        if(chunkSize < size)
+            chunkSize = size;
+
+        chunk = malloc(sizeof(FFarenachunk) + chunkSize);
+        chunk->next = arena->chunks;
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+
+    chunk->last = chunk->used;
+    chunk->used += size;
+    return chunk->data + chunk->last;
+}
+
+void* ffArenaAlloc(FFarena* arena, size_t size)
+{
+    pthread_mutex_lock(&arena->mutex);
+    void* ptr = arenaAlloc(arena, size);
+    pthread_mutex_unlock(&arena->mutex);
+    return ptr;
+}
+
+void* ffArenaRealloc(FFarena* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+    pthread_mutex_lock(&arena->mutex);
+
+    //A strbuf or list that is appended to is mostly the newest allocation, so it just grows
+    FFarenachunk* chunk = arena->chunks;
+    if(chunk != NULL && ptr == chunk->data + chunk->last && chunk->size - chunk->last >= alignSize(newSize))
+    {
+        chunk->used = chunk->last + alignSize(newSize);
+        pthread_mutex_unlock(&arena->mutex);
+        return ptr;
+    }
+
+    void* result = arenaAlloc(arena, newSize);
+    pthread_mutex_unlock(&arena->mutex);
+
+    memcpy(result, ptr, oldSize < newSize ? oldSize : newSize);
+    return result;
+}
+
+bool ffArenaOwns(FFarena* arena, const void* ptr)
+{
+    pthread_mutex_lock(&arena->mutex);
+
+    bool owns = false;
+    for(FFarenachunk* chunk = arena->chunks; chunk != NULL && !owns; chunk = chunk->next)
+        owns = (const char*) ptr >= chunk->data && (const char*) ptr < chunk->data + chunk->size;
+
+    pthread_mutex_unlock(&arena->mutex);
+    return owns;
+}
+
+//Everything allocated from the arena is invalid afterwards. The arena itself stays usable
+void ffArenaReset(FFarena* arena)
+{
+    pthread_mutex_lock(&arena->mutex);
+
+    FFarenachunk* chunk = arena->chunks;
+    while(chunk != NULL)
+    {
+        FFarenachunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+    arena->generation = __atomic_add_fetch(&generations, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&arena->mutex);
+}
+
+//Nothing allocated before the mark can grow in place afterwards, it would overlap what is allocated after the release
+FFarenamark ffArenaMark(FFarena* arena)
+{
+    pthread_mutex_lock(&arena->mutex);
+
+    if(arena->chunks != NULL)
+        arena->chunks->last = arena->chunks->used;
+
+    FFarenamark mark = {
+        .chunk = arena->chunks,
+        .used = arena->chunks == NULL ? 0 : arena->chunks->used
+    };
+
+    pthread_mutex_unlock(&arena->mutex);
+    return mark;
+}
+
+//Like ffArenaReset, but only for what was allocated after the mark. Nothing allocated before it may have been reallocated since
+void ffArenaRelease(FFarena* arena, FFarenamark mark)
+{
+    pthread_mutex_lock(&arena->mutex);
+
+    while(arena->chunks != mark.chunk)
+    {
+        FFarenachunk* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    if(mark.chunk != NULL)
+    {
+        mark.chunk->used = mark.used;
+        mark.chunk->last = mark.used;
+    }
+
+    arena->generation = __atomic_add_fetch(&generations, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&arena->mutex);
+}
+
+void ffArenaUse(FFarena* arena)
+{
+    current = arena;
+}
+
+void* ffAlloc(size_t size)
+{
+    if(current == NULL)
+        return malloc(size);
+    return ffArenaAlloc(current, size);
+}
+
+void* ffRealloc(void* ptr, size_t oldSize, size_t newSize)
+{
+    if(current == NULL || (oldSize > 0 && !ffArenaOwns(current, ptr)))
+        return realloc(ptr, newSize);
+    return ffArenaRealloc(current, ptr, oldSize, newSize);
+}
+
+void ffFree(void* ptr)
+{
+    if(current == NULL || !ffArenaOwns(current, ptr))
+        free(ptr);
+}
+
+#undef FF_ARENA_ALIGNMENT
+#undef FF_ARENA_MAX_CHUNK_SIZE
+#undef FF_ARENA_FIRST_CHUNK_SIZE
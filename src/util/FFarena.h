@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef FASTFETCH_INCLUDED_FFARENA
+#define FASTFETCH_INCLUDED_FFARENA
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct FFarenachunk FFarenachunk;
+
+//Bump allocator, all memory is released at once by ffArenaReset
+typedef struct FFarena
+{
+    pthread_mutex_t mutex; //Detection threads allocate concurrently
+    FFarenachunk* chunks; //Newest first, allocations are served from it
+    uint32_t generation; //Unique per init and reset, so state that outlived its memory can be told apart
+} FFarena;
+
+//The state of an arena, to release everything allocated after it
+typedef struct FFarenamark
+{
+    FFarenachunk* chunk;
+    size_t used;
+} FFarenamark;
+
+void ffArenaInit(FFarena* arena);
+void* ffArenaAlloc(FFarena* arena, size_t size);
+void* ffArenaRealloc(FFarena* arena, void* ptr, size_t oldSize, size_t newSize);
+bool ffArenaOwns(FFarena* arena, const void* ptr);
+void ffArenaReset(FFarena* arena);
+FFarenamark ffArenaMark(FFarena* arena);
+void ffArenaRelease(FFarena* arena, FFarenamark mark);
+
+//FFstrbuf and FFlist allocate through these. They use the arena given to ffArenaUse, or the heap if there is none.
+//Memory of the heap is still reallocated and freed on the heap after an arena is in use.
+void ffArenaUse(FFarena* arena);
+void* ffAlloc(size_t size);
+void* ffRealloc(void* ptr, size_t oldSize, size_t newSize);
+void ffFree(void* ptr);
+
+#endif
@@ -1,4 +1,5 @@
 #include "FFlist.h"
+#include "FFarena.h"
 
 #include <malloc.h>
 #include <memory.h>
@@ -13,7 +14,7 @@ void ffListInitA(FFlist* list, uint32_t elementSize, uint32_t capacity)
     list->elementSize = elementSize;
     list->capacity = capacity;
     list->length = 0;
-    list->data = malloc(list->capacity * list->elementSize);
+    list->data = ffAlloc(list->capacity * list->elementSize);
 }
 
 void* ffListGet(const FFlist* list, uint32_t index)
@@ -25,8 +26,9 @@ void* ffListAdd(FFlist* list)
 {
     if(list->length == list->capacity)
     {
-        list->capacity = list->capacity * 2 * list->elementSize;
-        list->data = realloc(list->data, list->capacity);
+        uint32_t capacity = list->capacity == 0 ? FF_LIST_DEFAULT_ALLOC : list->capacity * 2;
+        list->data = ffRealloc(list->data, list->capacity * list->elementSize, capacity * list->elementSize);
+        list->capacity = capacity;
     }
     void* adress = list->data + (list->length * list->elementSize);
     ++list->length;
@@ -46,5 +48,5 @@ uint32_t ffListFirstIndexComp(const FFlist* list, void* compElement, bool(*compF
 
 void ffListDestroy(FFlist* list)
 {
-    free(list->data);
+    ffFree(list->data);
 }
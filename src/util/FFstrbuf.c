@@ -1,8 +1,12 @@
 #include "FFstrbuf.h"
+#include "FFarena.h"
 
 #include <malloc.h>
 #include <ctype.h>
 #include <string.h>
+#include <math.h>
+
+static char emptyString[1] = "";
 
 static bool strbufCharsLeft(uint32_t i, const void* strbuf)
 {
@@ -16,7 +20,9 @@ static bool strbufCharsLeftS(uint32_t i, const void* str)
 
 void ffStrbufInit(FFstrbuf* strbuf)
 {
-    ffStrbufInitA(strbuf, FASTFETCH_STRBUF_DEFAULT_ALLOC);
+    strbuf->allocated = 0;
+    strbuf->length = 0;
+    strbuf->chars = emptyString;
 }
 
 void ffStrbufInitCopy(FFstrbuf* strbuf, const FFstrbuf* src)
@@ -27,12 +33,14 @@ void ffStrbufInitCopy(FFstrbuf* strbuf, const FFstrbuf* src)
 
 void ffStrbufInitS(FFstrbuf* strbuf, const char* value)
 {
-    ffStrbufInitAS(strbuf, FASTFETCH_STRBUF_DEFAULT_ALLOC, value);
+    ffStrbufInit(strbuf);
+    ffStrbufAppendS(strbuf, value);
 }
 
 void ffStrbufInitNS(FFstrbuf* strbuf, uint32_t length, const char* value)
 {
-    ffStrbufInitANS(strbuf, FASTFETCH_STRBUF_DEFAULT_ALLOC, length, value);
+    ffStrbufInit(strbuf);
+    ffStrbufAppendNS(strbuf, length, value);
 }
 
 void ffStrbufInitC(FFstrbuf* strbuf, const char c)
@@ -44,12 +52,12 @@ void ffStrbufInitA(FFstrbuf* strbuf, uint32_t allocate)
 {
     if(allocate == 0)
     {
-        fprintf(stderr, "ffStrbufInitA(): allocation size == 0, changing to 1");
-        allocate = 1;
+        ffStrbufInit(strbuf);
+        return;
     }
 
     strbuf->allocated = allocate;
-    strbuf->chars = (char*) malloc(sizeof(char) * strbuf->allocated);
+    strbuf->chars = (char*) ffAlloc(sizeof(char) * strbuf->allocated);
 
     ffStrbufClear(strbuf);
 }
@@ -74,7 +82,7 @@ void ffStrbufInitAC(FFstrbuf* strbuf, uint32_t allocate, const char c)
 
 void ffStrbufInitF(FFstrbuf* strbuf, const char* format, ...)
 {
-    ffStrbufInitA(strbuf, FASTFETCH_STRBUF_DEFAULT_ALLOC);
+    ffStrbufInit(strbuf);
     va_list arguments;
     va_start(arguments, format);
     ffStrbufAppendVF(strbuf, format, arguments);
@@ -83,7 +91,7 @@ void ffStrbufInitF(FFstrbuf* strbuf, const char* format, ...)
 
 void ffStrbufInitVF(FFstrbuf* strbuf, const char* format, va_list arguments)
 {
-    ffStrbufInitA(strbuf, FASTFETCH_STRBUF_DEFAULT_ALLOC);
+    ffStrbufInit(strbuf);
     ffStrbufAppendVF(strbuf, format, arguments);
 }
 
@@ -91,24 +99,36 @@ void ffStrbufEnsureCapacity(FFstrbuf* strbuf, uint32_t allocate)
 {
     if(strbuf->allocated >= allocate)
         return;
+
+    if(strbuf->allocated == 0)
+    {
+        strbuf->chars = ffAlloc(sizeof(char) * allocate);
+        strbuf->chars[0] = '\0';
+    }
+    else
+        strbuf->chars = ffRealloc(strbuf->chars, sizeof(char) * strbuf->allocated, sizeof(char) * allocate);
+
     strbuf->allocated = allocate;
-    strbuf->chars = realloc(strbuf->chars, sizeof(char) * strbuf->allocated);
 }
 
+//Makes room for free chars plus the '\0' byte. Always leaves the strbuf writable, even for free == 0
 void ffStrbufEnsureFree(FFstrbuf* strbuf, uint32_t free)
 {
     uint32_t allocate = strbuf->allocated;
-    if(allocate < 2)
+    if(allocate == 0)
+        allocate = FASTFETCH_STRBUF_DEFAULT_ALLOC;
+    else if(allocate < 2)
         allocate = 2;
-    while((strbuf->length + free) > allocate)
+    while((strbuf->length + free) >= allocate)
         allocate *= 2;
     ffStrbufEnsureCapacity(strbuf, allocate);
 }
 
 void ffStrbufClear(FFstrbuf* strbuf)
 {
-    strbuf->chars[0] = '\0';
     strbuf->length = 0;
+    if(strbuf->allocated > 0)
+        strbuf->chars[0] = '\0';
 }
 
 void ffStrbufSet(FFstrbuf* strbuf, const FFstrbuf* value)
@@ -159,7 +179,7 @@ void ffStrbufAppend(FFstrbuf* strbuf, const FFstrbuf* value)
 
 void ffStrbufAppendTransformS(FFstrbuf* strbuf, const char* value, int(*transformFunc)(int))
 {
-    if(value == NULL)
+    if(value == NULL || *value == '\0')
         return;
 
     for(uint32_t i = 0; value[i] != '\0'; i++)
@@ -173,7 +193,7 @@ void ffStrbufAppendTransformS(FFstrbuf* strbuf, const char* value, int(*transfor
 
 void ffStrbufAppendS(FFstrbuf* strbuf, const char* value)
 {
-    if(value == NULL)
+    if(value == NULL || *value == '\0')
         return;
 
     for(uint32_t i = 0; value[i] != '\0'; i++)
@@ -188,7 +208,7 @@ void ffStrbufAppendS(FFstrbuf* strbuf, const char* value)
 
 void ffStrbufAppendNS(FFstrbuf* strbuf, uint32_t length, const char* value)
 {
-    if(value == NULL)
+    if(value == NULL || length == 0 || *value == '\0')
         return;
 
     ffStrbufEnsureFree(strbuf, length);
@@ -206,7 +226,7 @@ void ffStrbufAppendNS(FFstrbuf* strbuf, uint32_t length, const char* value)
 
 void ffStrbufAppendSExcludingC(FFstrbuf* strbuf, const char* value, char exclude)
 {
-    if(value == NULL)
+    if(value == NULL || *value == '\0')
         return;
 
     for(uint32_t i = 0; value[i] != '\0'; i++)
@@ -223,7 +243,7 @@ void ffStrbufAppendSExcludingC(FFstrbuf* strbuf, const char* value, char exclude
 
 void ffStrbufAppendNSExludingC(FFstrbuf* strbuf, uint32_t length, const char* value, char exclude)
 {
-    if(value == NULL)
+    if(value == NULL || length == 0)
         return;
 
     ffStrbufEnsureFree(strbuf, length);
@@ -269,7 +289,7 @@ void ffStrbufAppendVF(FFstrbuf* strbuf, const char* format, va_list arguments)
 
     if(strbuf->length + written >= strbuf->allocated)
     {
-        ffStrbufEnsureCapacity(strbuf, strbuf->allocated * 2);
+        ffStrbufEnsureFree(strbuf, written);
         ffStrbufAppendVF(strbuf, format, arguments); //Try again with larger buffer
     }
     else
@@ -279,6 +299,175 @@ void ffStrbufAppendVF(FFstrbuf* strbuf, const char* format, va_list arguments)
     }
 }
 
+//Numbers are formatted here instead of by printf, which parses the format and looks up the locale for every call
+
+static const uint64_t powersOf10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+//Writes the digits right aligned into digits[20] and returns where they start
+static uint32_t uintToDigits(uint64_t value, char digits[20])
+{
+    uint32_t start = 20;
+    do
+    {
+        digits[--start] = (char) ('0' + value % 10);
+        value /= 10;
+    } while(value > 0);
+    return start;
+}
+
+void ffStrbufAppendUInt(FFstrbuf* strbuf, uint64_t value)
+{
+    char digits[20];
+    uint32_t start = uintToDigits(value, digits);
+    ffStrbufAppendNS(strbuf, 20 - start, digits + start);
+}
+
+void ffStrbufAppendInt(FFstrbuf* strbuf, int64_t value)
+{
+    if(value < 0)
+    {
+        ffStrbufAppendC(strbuf, '-');
+        ffStrbufAppendUInt(strbuf, 0 - (uint64_t) value); //Also correct for INT64_MIN
+    }
+    else
+        ffStrbufAppendUInt(strbuf, (uint64_t) value);
+}
+
+__extension__ typedef unsigned __int128 FFuint128;
+
+static FFuint128 powerOf10(uint32_t exponent)
+{
+    if(exponent < 20)
+        return powersOf10[exponent];
+    return (FFuint128) powersOf10[19] * powersOf10[exponent - 19];
+}
+
+//Same output as printf("%.*g", precision, value).
+//The value is a binary fraction m / 2^e, so value * 10^k can be divided exactly in 128 bits and rounded half to even like glibc does.
+//This covers the range numbers of modules are in, everything else goes through printf.
+void ffStrbufAppendDouble(FFstrbuf* strbuf, double value, uint32_t precision)
+{
+    if(precision == 0)
+        precision = 1;
+
+    double absolute = value < 0 ? -value : value;
+    if(precision > 17 || !(absolute >= 1e-5 && absolute < 1e15))
+    {
+        if(value == 0)
+            ffStrbufAppendS(strbuf, signbit(value) ? "-0" : "0");
+        else
+            ffStrbufAppendF(strbuf, "%.*g", (int) precision, value);
+        return;
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &absolute, sizeof(bits));
+    uint64_t mantissa = (bits & ((1ULL << 52) - 1)) | (1ULL << 52); //Subnormals are out of range
+    int32_t binaryExponent = (int32_t) (bits >> 52) - 1075; //Always negative in range
+
+    //log10(2) is about 78913 / 2^18. The estimate is at most one too small
+    int32_t binaryLog = binaryExponent + 52;
+    int32_t exponent = binaryLog >= 0 ? binaryLog * 78913 / 262144 : -((-binaryLog * 78913 + 262143) / 262144);
+
+    uint64_t digitsValue;
+    while(true)
+    {
+        //value * 10^scale = mantissa * 10^scale / 2^shift. Only shifts and 64 bit divisions are needed, no 128 bit ones
+        int32_t scale = (int32_t) precision - 1 - exponent;
+        uint32_t shift = (uint32_t) -binaryExponent;
+
+        FFuint128 numerator = mantissa;
+        FFuint128 denominator = (FFuint128) 1 << shift;
+        uint64_t quotient;
+        if(scale >= 0)
+        {
+            numerator *= powerOf10((uint32_t) scale);
+            quotient = (uint64_t) (numerator >> shift);
+        }
+        else
+        {
+            quotient = (uint64_t) (numerator >> shift) / powersOf10[-scale];
+            denominator *= powersOf10[-scale];
+        }
+
+        if(quotient >= powersOf10[precision])
+        {
+            ++exponent;
+            continue;
+        }
+        if(quotient < powersOf10[precision - 1])
+        {
+            --exponent;
+            continue;
+        }
+
+        FFuint128 remainder2 = (numerator - quotient * denominator) * 2;
+        digitsValue = quotient;
+        if(remainder2 > denominator || (remainder2 == denominator && (digitsValue & 1)))
+            ++digitsValue;
+
+        if(digitsValue == powersOf10[precision])
+        {
+            digitsValue = powersOf10[precision - 1];
+            ++exponent;
+        }
+        break;
+    }
+
+    //digitsValue has exactly precision digits
+    char digits[17];
+    for(uint32_t i = precision; i > 0; --i)
+    {
+        digits[i - 1] = (char) ('0' + digitsValue % 10);
+        digitsValue /= 10;
+    }
+
+    //Without the # flag, trailing zeros of the fraction are removed
+    uint32_t numDigits = precision;
+    while(numDigits > 1 && digits[numDigits - 1] == '0')
+        --numDigits;
+
+    if(value < 0)
+        ffStrbufAppendC(strbuf, '-');
+
+    if(exponent < -4 || exponent >= (int32_t) precision)
+    {
+        ffStrbufAppendC(strbuf, digits[0]);
+        if(numDigits > 1)
+        {
+            ffStrbufAppendC(strbuf, '.');
+            ffStrbufAppendNS(strbuf, numDigits - 1, digits + 1);
+        }
+
+        ffStrbufAppendS(strbuf, exponent < 0 ? "e-" : "e+");
+        uint32_t absoluteExponent = (uint32_t) (exponent < 0 ? -exponent : exponent);
+        if(absoluteExponent < 10)
+            ffStrbufAppendC(strbuf, '0');
+        ffStrbufAppendUInt(strbuf, absoluteExponent);
+    }
+    else if(exponent >= 0)
+    {
+        uint32_t integerDigits = (uint32_t) exponent + 1;
+        ffStrbufAppendNS(strbuf, integerDigits, digits);
+        if(numDigits > integerDigits)
+        {
+            ffStrbufAppendC(strbuf, '.');
+            ffStrbufAppendNS(strbuf, numDigits - integerDigits, digits + integerDigits);
+        }
+    }
+    else
+    {
+        ffStrbufAppendS(strbuf, "0.");
+        for(int32_t i = -1; i > exponent; --i)
+            ffStrbufAppendC(strbuf, '0');
+        ffStrbufAppendNS(strbuf, numDigits, digits);
+    }
+}
+
 char ffStrbufGetC(FFstrbuf* strbuf, uint32_t index)
 {
     if(index >= strbuf->length)
@@ -334,6 +523,9 @@ void ffStrbufTrimLeft(FFstrbuf* strbuf, char c)
 
 void ffStrbufTrimRight(FFstrbuf* strbuf, char c)
 {
+    if(strbuf->length == 0)
+        return;
+
     while(strbuf->length > 0 && strbuf->chars[strbuf->length - 1] == c)
         --strbuf->length;
     strbuf->chars[strbuf->length] = '\0';
@@ -635,5 +827,9 @@ void ffStrbufRecalculateLength(FFstrbuf* strbuf)
 
 void ffStrbufDestroy(FFstrbuf* strbuf)
 {
-    free(strbuf->chars);
+    if(strbuf->allocated > 0)
+        ffFree(strbuf->chars);
+
+    //Destroying twice or appending afterwards stays safe
+    ffStrbufInit(strbuf);
 }
@@ -10,6 +10,8 @@
 
 #define FASTFETCH_STRBUF_DEFAULT_ALLOC 32
 
+//A strbuf with allocated == 0 points to a shared empty string, which is never written.
+//ffStrbufInit doesn't allocate, the first append does. Anything writing to chars directly must call ffStrbufEnsureFree first.
 typedef struct FFstrbuf
 {
     uint32_t allocated;
@@ -52,6 +54,9 @@ void ffStrbufAppendNS(FFstrbuf* strbuf, uint32_t length, const char* value);
 void ffStrbufAppendC(FFstrbuf* strbuf, const char c);
 void ffStrbufAppendF(FFstrbuf* strbuf, const char* format, ...);
 void ffStrbufAppendVF(FFstrbuf* strbuf, const char* format, va_list arguments);
+void ffStrbufAppendUInt(FFstrbuf* strbuf, uint64_t value);
+void ffStrbufAppendInt(FFstrbuf* strbuf, int64_t value);
+void ffStrbufAppendDouble(FFstrbuf* strbuf, double value, uint32_t precision);
 
 char ffStrbufGetC(FFstrbuf* strbuf, uint32_t index);
 
@@ -1,48 +1,141 @@
 #include <stdint.h>
 #include <malloc.h>
 #include <string.h>
+#include <strings.h>
 
 #include "FFvaluestore.h"
 
+#define FF_VALUESTORE_MIN_CAPACITY 16
+#define FF_VALUESTORE_MIN_POOL 256
+
 void ffValuestoreInit(FFvaluestore* vs)
 {
-    vs->capacity = 32;
-    vs->pairs = calloc(vs->capacity, sizeof(FFvaluestorePair));
+    //Nothing is allocated until the first set, most runs don't have any
+    vs->entries = NULL;
     vs->size = 0;
+    vs->capacity = 0;
+    vs->strings = NULL;
+    vs->numStrings = 0;
+    vs->pool = NULL;
+    vs->poolLength = 0;
+    vs->poolCapacity = 0;
 }
 
-void ffValuestoreSet(FFvaluestore* vs, const char* name, const char* value)
+//FNV-1a
+static uint32_t hashString(const char* string, bool ignoreCase)
 {
-    for(uint32_t i = 0; i < vs->size; i++)
+    uint32_t hash = 2166136261u;
+    for(; *string != '\0'; ++string)
     {
-        if(strcasecmp(vs->pairs[i].name, name) == 0)
-        {
-            strcpy(vs->pairs[i].value, value);
-            return;
-        }
+        char c = *string;
+        if(ignoreCase && c >= 'A' && c <= 'Z')
+            c = (char) (c + ('a' - 'A'));
+        hash = (hash ^ (uint8_t) c) * 16777619u;
     }
+    return hash;
+}
+
+static FFvaluestoreEntry* findEntry(FFvaluestore* vs, const char* name)
+{
+    uint32_t slot = hashString(name, true) & (vs->capacity - 1);
+    while(vs->entries[slot].name != 0 && strcasecmp(vs->pool + vs->entries[slot].name, name) != 0)
+        slot = (slot + 1) & (vs->capacity - 1);
+    return &vs->entries[slot];
+}
+
+static uint32_t* findString(FFvaluestore* vs, const char* string)
+{
+    uint32_t slot = hashString(string, false) & (vs->capacity - 1);
+    while(vs->strings[slot] != 0 && strcmp(vs->pool + vs->strings[slot], string) != 0)
+        slot = (slot + 1) & (vs->capacity - 1);
+    return &vs->strings[slot];
+}
+
+//Both tables are kept at most 3/4 full, so probing stays short
+static void grow(FFvaluestore* vs)
+{
+    FFvaluestoreEntry* oldEntries = vs->entries;
+    uint32_t* oldStrings = vs->strings;
+    uint32_t oldCapacity = vs->capacity;
+
+    vs->capacity = oldCapacity == 0 ? FF_VALUESTORE_MIN_CAPACITY : oldCapacity * 2;
+    vs->entries = calloc(vs->capacity, sizeof(*vs->entries));
+    vs->strings = calloc(vs->capacity, sizeof(*vs->strings));
 
-    if(vs->size == vs->capacity)
+    for(uint32_t i = 0; i < oldCapacity; i++)
     {
-        vs->pairs = realloc(vs->pairs, vs->capacity * sizeof(FFvaluestorePair) * 2);
-        vs->capacity *= 2;
+        if(oldEntries[i].name != 0)
+            *findEntry(vs, vs->pool + oldEntries[i].name) = oldEntries[i];
+        if(oldStrings[i] != 0)
+            *findString(vs, vs->pool + oldStrings[i]) = oldStrings[i];
     }
 
-    strcpy(vs->pairs[vs->size].name, name);
-    strcpy(vs->pairs[vs->size].value, value);
+    free(oldEntries);
+    free(oldStrings);
+}
+
+//Returns the offset of the string in the pool, which it is only added to if it isn't there yet
+static uint32_t intern(FFvaluestore* vs, const char* string)
+{
+    if(*string == '\0')
+        return 0; //The pool starts with the empty string
+
+    uint32_t* slot = findString(vs, string);
+    if(*slot != 0)
+        return *slot;
 
-    ++vs->size;
+    uint32_t length = (uint32_t) strlen(string) + 1;
+    if(vs->poolLength + length > vs->poolCapacity)
+    {
+        while(vs->poolLength + length > vs->poolCapacity)
+            vs->poolCapacity *= 2;
+        vs->pool = realloc(vs->pool, vs->poolCapacity);
+    }
+
+    memcpy(vs->pool + vs->poolLength, string, length);
+    *slot = vs->poolLength;
+    vs->poolLength += length;
+    ++vs->numStrings;
+    return *slot;
 }
 
-const char* ffValuestoreGet(FFvaluestore* vs, const char* name)
+void ffValuestoreSet(FFvaluestore* vs, const char* name, const char* value)
 {
-    for(uint32_t i = 0; i < vs->size; i++)
+    //An empty name could never be found, as name 0 marks empty slots
+    if(*name == '\0')
+        return;
+
+    if(vs->pool == NULL)
+    {
+        vs->poolCapacity = FF_VALUESTORE_MIN_POOL;
+        vs->pool = malloc(vs->poolCapacity);
+        vs->pool[0] = '\0';
+        vs->poolLength = 1;
+    }
+
+    //A set adds at most one entry and two strings
+    if((vs->size + 1) * 4 > vs->capacity * 3 || (vs->numStrings + 2) * 4 > vs->capacity * 3)
+        grow(vs);
+
+    uint32_t valueOffset = intern(vs, value);
+
+    FFvaluestoreEntry* entry = findEntry(vs, name);
+    if(entry->name == 0)
     {
-        if(strcasecmp(vs->pairs[i].name, name) == 0)
-            return vs->pairs[i].value;
+        entry->name = intern(vs, name);
+        ++vs->size;
     }
+    entry->value = valueOffset;
+}
 
-    return NULL;
+//The returned string is valid until the next set
+const char* ffValuestoreGet(FFvaluestore* vs, const char* name)
+{
+    if(vs->size == 0)
+        return NULL;
+
+    const FFvaluestoreEntry* entry = findEntry(vs, name);
+    return entry->name == 0 ? NULL : vs->pool + entry->value;
 }
 
 bool ffValuestoreContains(FFvaluestore* vs, const char* name)
@@ -52,5 +145,11 @@ bool ffValuestoreContains(FFvaluestore* vs, const char* name)
 
 void ffValuestoreDelete(FFvaluestore* vs)
 {
-    free(vs->pairs);
+    free(vs->entries);
+    free(vs->strings);
+    free(vs->pool);
+    ffValuestoreInit(vs);
 }
+
+#undef FF_VALUESTORE_MIN_POOL
+#undef FF_VALUESTORE_MIN_CAPACITY
@@ -3,19 +3,29 @@
 #ifndef FASTFETCH_INCLUDED_FFVALUESTORE
 #define FASTFETCH_INCLUDED_FFVALUESTORE
 
+#include <stdint.h>
 #include <stdbool.h>
 
-typedef struct FFvaluestorePair
+typedef struct FFvaluestoreEntry
 {
-    char name[32];
-    char value[1024];
-} FFvaluestorePair;
+    uint32_t name; //Offsets into the pool, name 0 means the slot is empty
+    uint32_t value;
+} FFvaluestoreEntry;
 
+//Names are looked up case insensitive in an open addressing hash table.
+//Names and values live interned in a single pool, so equal strings are only stored once and there is no length limit.
 typedef struct FFvaluestore
 {
-    FFvaluestorePair* pairs;
+    FFvaluestoreEntry* entries;
     uint32_t size;
-    uint32_t capacity;
+    uint32_t capacity; //Of entries and strings, a power of 2 or 0 before the first set
+
+    uint32_t* strings; //Offsets into the pool, to find equal strings when interning. 0 means empty
+    uint32_t numStrings;
+
+    char* pool; //'\0' terminated strings, starting with an empty one at offset 0
+    uint32_t poolLength;
+    uint32_t poolCapacity;
 } FFvaluestore;
 
 void ffValuestoreInit(FFvaluestore* vs);
@@ -1,70 +1,713 @@
 #include "fastfetch.h"
 
 #include <time.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
-#define FASTFETCH_TEST_PERFORMANCE(func) \
-    { \
-        struct timespec start, end; \
-        clock_gettime(CLOCK_REALTIME, &start); \
-        func; \
-        clock_gettime(CLOCK_REALTIME, &end); \
-        long nanos = end.tv_nsec - start.tv_nsec; \
-        printf("\033[F"); \
-        for(uint8_t i = 0; i < 110; i++) printf("\033[C"); \
-        printf("%08ldns\n", nanos); \
-    } \
+#define FF_PERFORMANCE_DEFAULT_RUNS 20
+#define FF_PERFORMANCE_DEFAULT_THRESHOLD 25 //Percent the median may grow before it counts as regression
+#define FF_PERFORMANCE_MIN_DELTA_NS 100000 //Changes below 0.1ms are noise on every machine
+#define FF_PERFORMANCE_NUMBERS_COUNT 10000 //Values formatted per run of --numbers
 
-int main(int argc, char** argv)
+typedef void(*FFprintfunc)(FFinstance* instance);
+
+static const struct
+{
+    const char* name;
+    FFprintfunc func;
+} modules[] = {
+    {"title", ffPrintTitle},
+    {"separator", ffPrintSeparator},
+    {"os", ffPrintOS},
+    {"host", ffPrintHost},
+    {"kernel", ffPrintKernel},
+    {"uptime", ffPrintUptime},
+    {"packages", ffPrintPackages},
+    {"shell", ffPrintShell},
+    {"resolution", ffPrintResolution},
+    {"de", ffPrintDesktopEnvironment},
+    {"wm", ffPrintWM},
+    {"wmtheme", ffPrintWMTheme},
+    {"theme", ffPrintTheme},
+    {"icons", ffPrintIcons},
+    {"font", ffPrintFont},
+    {"cursor", ffPrintCursor},
+    {"terminal", ffPrintTerminal},
+    {"terminalfont", ffPrintTerminalFont},
+    {"cpu", ffPrintCPU},
+    {"gpu", ffPrintGPU},
+    {"memory", ffPrintMemory},
+    {"disk", ffPrintDisk},
+    {"battery", ffPrintBattery},
+    {"locale", ffPrintLocale},
+    {"break", ffPrintBreak},
+    {"colors", ffPrintColors}
+};
+
+#define FF_PERFORMANCE_NUM_MODULES (sizeof(modules) / sizeof(modules[0]))
+
+//Besides the modules, every run measures these phases of the pipeline
+enum
+{
+    FF_METRIC_INIT = FF_PERFORMANCE_NUM_MODULES,
+    FF_METRIC_PREFETCH,
+    FF_METRIC_FINISH,
+    FF_METRIC_TOTAL,
+    FF_METRIC_THREADS, //CPU time spent outside of the main thread, so mostly in the detection workers
+    FF_METRIC_ALLOCATIONS, //Not a time, but the number of malloc, calloc and realloc calls of a whole run
+    FF_METRIC_COUNT
+};
+
+static const char* metricNames[FF_METRIC_COUNT - FF_PERFORMANCE_NUM_MODULES] = {
+    "init",
+    "prefetch",
+    "finish",
+    "total",
+    "threads",
+    "allocations"
+};
+
+//recache detects everything and writes the cache, cached reads it and nocache detects everything without writing
+static const struct
+{
+    const char* name;
+    bool recache;
+    bool cacheSave;
+} modes[] = {
+    {"recache", true, true},
+    {"cached", false, true},
+    {"nocache", true, false}
+};
+
+#define FF_PERFORMANCE_NUM_MODES (sizeof(modes) / sizeof(modes[0]))
+
+typedef struct FFmetricstats
+{
+    uint64_t min;
+    uint64_t median;
+    uint64_t p95;
+    uint64_t p99;
+} FFmetricstats;
+
+static const char* getMetricName(uint32_t metric)
+{
+    if(metric < FF_PERFORMANCE_NUM_MODULES)
+        return modules[metric].name;
+    return metricNames[metric - FF_PERFORMANCE_NUM_MODULES];
+}
+
+//The test is linked with --wrap for these, so every call from fastfetch code lands here. Allocations inside libc aren't counted
+static uint64_t allocations;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t num, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t num, size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_calloc(num, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+static inline uint64_t getTimeNs(clockid_t clock)
+{
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return (uint64_t) time.tv_sec * 1000000000ULL + (uint64_t) time.tv_nsec;
+}
+
+//Detection results are static for the whole process, so every run must be a fresh one
+static void runChild(uint32_t mode, int resultFD)
 {
-    UNUSED(argc);
-    UNUSED(argv);
+    uint64_t samples[FF_METRIC_COUNT];
+
+    int devNull = open("/dev/null", O_WRONLY);
+    if(devNull != -1)
+    {
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+
+    __atomic_store_n(&allocations, 0, __ATOMIC_RELAXED);
+
+    uint64_t start = getTimeNs(CLOCK_MONOTONIC);
+    uint64_t processStart = getTimeNs(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t threadStart = getTimeNs(CLOCK_THREAD_CPUTIME_ID);
 
     FFinstance instance;
+    ffInitInstance(&instance);
+    ffLoadLogoSet(&instance, "arch");
+    ffStrbufSetS(&instance.config.color, instance.config.logo.colors[0]);
+    instance.config.showErrors = true;
+    instance.config.recache = modes[mode].recache;
+    instance.config.cacheSave = modes[mode].cacheSave;
+
+    uint64_t current = getTimeNs(CLOCK_MONOTONIC);
+    samples[FF_METRIC_INIT] = current - start;
+
+    ffStartDetectionThreads(&instance);
+    ffPrefetchStructure(&instance, FASTFETCH_DEFAULT_STRUCTURE);
+    ffStart(&instance);
+
+    uint64_t previous = current;
+    current = getTimeNs(CLOCK_MONOTONIC);
+    samples[FF_METRIC_PREFETCH] = current - previous;
+
+    for(uint32_t i = 0; i < FF_PERFORMANCE_NUM_MODULES; i++)
+    {
+        ffOutputAddSlot();
+        modules[i].func(&instance);
+
+        previous = current;
+        current = getTimeNs(CLOCK_MONOTONIC);
+        samples[i] = current - previous;
+    }
+
+    //Flushes the output, joins the workers and writes the cache
+    ffFinish(&instance);
+
+    uint64_t end = getTimeNs(CLOCK_MONOTONIC);
+    samples[FF_METRIC_FINISH] = end - current;
+    samples[FF_METRIC_TOTAL] = end - start;
 
-    FASTFETCH_TEST_PERFORMANCE(
-        puts("Initialization");
-        ffInitInstance(&instance);
-    )
-
-    FASTFETCH_TEST_PERFORMANCE(
-        puts("Configuration");
-        ffLoadLogoSet(&instance, "arch");
-        ffStrbufSetS(&instance.config.color, instance.config.logo.colors[0]);
-        instance.config.showErrors = true;
-        instance.config.recache = argc == 1;
-        instance.config.cacheSave = false;
-    )
-
-    FASTFETCH_TEST_PERFORMANCE(
-        puts("Thread starting");
-        ffStartDetectionThreads(&instance);
-    )
-
-    FASTFETCH_TEST_PERFORMANCE(ffPrintTitle(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintSeparator(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintOS(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintHost(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintKernel(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintUptime(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintPackages(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintShell(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintResolution(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintDesktopEnvironment(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintWM(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintWMTheme(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintTheme(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintIcons(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintFont(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintTerminal(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintTerminalFont(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintCPU(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintGPU(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintMemory(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintDisk(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintBattery(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintLocale(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintBreak(&instance))
-    FASTFETCH_TEST_PERFORMANCE(ffPrintColors(&instance))
-
-    return 0;
+    uint64_t processTime = getTimeNs(CLOCK_PROCESS_CPUTIME_ID) - processStart;
+    uint64_t mainThreadTime = getTimeNs(CLOCK_THREAD_CPUTIME_ID) - threadStart;
+    samples[FF_METRIC_THREADS] = processTime > mainThreadTime ? processTime - mainThreadTime : 0;
+    samples[FF_METRIC_ALLOCATIONS] = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+
+    bool written = write(resultFD, samples, sizeof(samples)) == (ssize_t) sizeof(samples);
+    _exit(written ? 0 : 1);
+}
+
+static bool runOnce(uint32_t mode, uint64_t* samples)
+{
+    int pipeFDs[2];
+    if(pipe(pipeFDs) != 0)
+        return false;
+
+    pid_t pid = fork();
+    if(pid == -1)
+    {
+        close(pipeFDs[0]);
+        close(pipeFDs[1]);
+        return false;
+    }
+
+    if(pid == 0)
+    {
+        close(pipeFDs[0]);
+        runChild(mode, pipeFDs[1]);
+    }
+
+    close(pipeFDs[1]);
+
+    //The samples are smaller than PIPE_BUF, so they arrive in a single write
+    ssize_t readed;
+    do
+        readed = read(pipeFDs[0], samples, sizeof(uint64_t) * FF_METRIC_COUNT);
+    while(readed < 0 && errno == EINTR);
+    close(pipeFDs[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    return readed == (ssize_t) (sizeof(uint64_t) * FF_METRIC_COUNT) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static int compareSamples(const void* a, const void* b)
+{
+    uint64_t left = *(const uint64_t*) a;
+    uint64_t right = *(const uint64_t*) b;
+    return left < right ? -1 : left > right;
+}
+
+//Nearest rank, samples must be sorted
+static uint64_t getPercentile(const uint64_t* samples, uint32_t numSamples, uint32_t percentile)
+{
+    uint32_t rank = (percentile * numSamples + 99) / 100;
+    return samples[rank == 0 ? 0 : rank - 1];
+}
+
+static FFmetricstats getStats(uint64_t* samples, uint32_t numSamples)
+{
+    qsort(samples, numSamples, sizeof(*samples), compareSamples);
+
+    FFmetricstats stats;
+    stats.min = samples[0];
+    stats.median = getPercentile(samples, numSamples, 50);
+    stats.p95 = getPercentile(samples, numSamples, 95);
+    stats.p99 = getPercentile(samples, numSamples, 99);
+    return stats;
 }
+
+//Reads a median from a file this program wrote, one metric per line inside of its mode object
+static bool getBaselineMedian(const FFstrbuf* baseline, const char* modeName, const char* metricName, uint64_t* median)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\": {", modeName);
+    const char* mode = strstr(baseline->chars, key);
+    if(mode == NULL)
+        return false;
+
+    //Metrics of the next mode must not be found, if this one doesn't have it
+    const char* modeEnd = strstr(mode, "\n    }");
+
+    snprintf(key, sizeof(key), "\"%s\": {", metricName);
+    const char* metric = strstr(mode, key);
+    if(metric == NULL || (modeEnd != NULL && metric > modeEnd))
+        return false;
+
+    const char* value = strstr(metric, "\"median\": ");
+    if(value == NULL)
+        return false;
+
+    *median = strtoull(value + strlen("\"median\": "), NULL, 10);
+    return true;
+}
+
+static void removeDirectory(const char* path)
+{
+    DIR* dir = opendir(path);
+    if(dir == NULL)
+        return;
+
+    FFstrbuf child;
+    ffStrbufInitA(&child, 128);
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        ffStrbufSetS(&child, path);
+        ffStrbufAppendC(&child, '/');
+        ffStrbufAppendS(&child, entry->d_name);
+
+        if(entry->d_type == DT_DIR)
+            removeDirectory(child.chars);
+        else
+            unlink(child.chars);
+    }
+
+    closedir(dir);
+    ffStrbufDestroy(&child);
+    rmdir(path);
+}
+
+//The values modules format: counts and sizes, resolutions, frequencies and everything else a double can be
+typedef enum FFnumberkind
+{
+    FF_NUMBER_KIND_UINT,
+    FF_NUMBER_KIND_INT,
+    FF_NUMBER_KIND_DOUBLE,
+    FF_NUMBER_KIND_DOUBLE_PRECISE,
+    FF_NUMBER_KIND_COUNT
+} FFnumberkind;
+
+static const char* numberKindNames[FF_NUMBER_KIND_COUNT] = {
+    "uint",
+    "int",
+    "double",
+    "double9"
+};
+
+typedef union FFnumber
+{
+    uint32_t uintValue;
+    int intValue;
+    double doubleValue;
+} FFnumber;
+
+//xorshift64, so every run formats the same values
+static uint64_t nextRandom(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void generateNumbers(FFnumberkind kind, FFnumber* numbers)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL + kind;
+
+    for(uint32_t i = 0; i < FF_PERFORMANCE_NUMBERS_COUNT; i++)
+    {
+        uint64_t random = nextRandom(&state);
+
+        if(kind == FF_NUMBER_KIND_UINT)
+            numbers[i].uintValue = (uint32_t) (random >> (random % 32));
+        else if(kind == FF_NUMBER_KIND_INT)
+            numbers[i].intValue = (int) (uint32_t) (random >> (random % 32));
+        else if(i % 2 == 0)
+            numbers[i].doubleValue = (double) (random % 100000) / 1000.0; //Like GHz and percentages
+        else
+        {
+            //Any bit pattern, with the exponent limited to finite values
+            uint64_t bits = (random & ~(0x7FFULL << 52)) | ((random >> 52) % 0x7FF) << 52;
+            memcpy(&numbers[i].doubleValue, &bits, sizeof(bits));
+        }
+    }
+}
+
+static void appendNumber(FFstrbuf* buffer, FFnumberkind kind, const FFnumber* number, bool usePrintf)
+{
+    if(kind == FF_NUMBER_KIND_UINT)
+    {
+        if(usePrintf)
+            ffStrbufAppendF(buffer, "%u", number->uintValue);
+        else
+            ffStrbufAppendUInt(buffer, number->uintValue);
+    }
+    else if(kind == FF_NUMBER_KIND_INT)
+    {
+        if(usePrintf)
+            ffStrbufAppendF(buffer, "%i", number->intValue);
+        else
+            ffStrbufAppendInt(buffer, number->intValue);
+    }
+    else
+    {
+        uint32_t precision = kind == FF_NUMBER_KIND_DOUBLE ? 6 : 9;
+        if(usePrintf)
+            ffStrbufAppendF(buffer, "%.*g", (int) precision, number->doubleValue);
+        else
+            ffStrbufAppendDouble(buffer, number->doubleValue, precision);
+    }
+
+    ffStrbufAppendC(buffer, '\n');
+}
+
+//Compares ffStrbufAppendUInt, ffStrbufAppendInt and ffStrbufAppendDouble with the printf path they replace.
+//Returns 1 if any value is formatted differently
+static int runNumbers(uint32_t numRuns)
+{
+    FFnumber* numbers = malloc(sizeof(FFnumber) * FF_PERFORMANCE_NUMBERS_COUNT);
+    uint64_t* samples = malloc(sizeof(uint64_t) * numRuns);
+
+    FFstrbuf formatted;
+    ffStrbufInitA(&formatted, FF_PERFORMANCE_NUMBERS_COUNT * 32);
+    FFstrbuf printed;
+    ffStrbufInitA(&printed, FF_PERFORMANCE_NUMBERS_COUNT * 32);
+
+    int result = 0;
+
+    printf("{\n");
+    printf("  \"runs\": %u,\n", numRuns);
+    printf("  \"values\": %u,\n", FF_PERFORMANCE_NUMBERS_COUNT);
+    printf("  \"unit\": \"ns\",\n");
+    printf("  \"numbers\": {\n");
+
+    for(uint32_t kind = 0; kind < FF_NUMBER_KIND_COUNT; kind++)
+    {
+        generateNumbers(kind, numbers);
+
+        for(uint32_t usePrintf = 0; usePrintf < 2; usePrintf++)
+        {
+            FFstrbuf* buffer = usePrintf ? &printed : &formatted;
+
+            for(uint32_t run = 0; run < numRuns; run++)
+            {
+                ffStrbufClear(buffer);
+
+                uint64_t start = getTimeNs(CLOCK_MONOTONIC);
+                for(uint32_t i = 0; i < FF_PERFORMANCE_NUMBERS_COUNT; i++)
+                    appendNumber(buffer, kind, &numbers[i], usePrintf);
+                samples[run] = getTimeNs(CLOCK_MONOTONIC) - start;
+            }
+
+            FFmetricstats stats = getStats(samples, numRuns);
+            printf("    \"%s%s\": {\"min\": %llu, \"median\": %llu, \"p95\": %llu, \"p99\": %llu}%s\n",
+                numberKindNames[kind],
+                usePrintf ? "-printf" : "",
+                (unsigned long long) stats.min,
+                (unsigned long long) stats.median,
+                (unsigned long long) stats.p95,
+                (unsigned long long) stats.p99,
+                kind + 1 < FF_NUMBER_KIND_COUNT || !usePrintf ? "," : ""
+            );
+        }
+
+        if(ffStrbufComp(&formatted, &printed) != 0)
+        {
+            fprintf(stderr, "Mismatch: %s values are formatted differently than by printf\n", numberKindNames[kind]);
+            result = 1;
+        }
+    }
+
+    printf("  }\n");
+    printf("}\n");
+
+    ffStrbufDestroy(&printed);
+    ffStrbufDestroy(&formatted);
+    free(samples);
+    free(numbers);
+
+    return result;
+}
+
+#define FF_PERFORMANCE_PROP_READ_SIZE 8191 //The buffer of parsePropFileValues in io.c, minus the terminator
+
+static void appendChars(FFstrbuf* buffer, uint32_t count, char c)
+{
+    for(uint32_t i = 0; i < count; i++)
+        ffStrbufAppendC(buffer, c);
+}
+
+static bool checkPropFile(const char* path, const char* name, const FFstrbuf* content)
+{
+    int fd = open(path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if(fd == -1 || !ffWriteFDContent(fd, content))
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        if(fd != -1)
+            close(fd);
+        return false;
+    }
+    close(fd);
+
+    FFstrbuf value;
+    ffStrbufInit(&value);
+    ffParsePropFileValuesFirst(path, 1, (FFpropquery[]) {{"KEY =", &value}});
+
+    bool matches = ffStrbufCompS(&value, "value") == 0;
+    if(!matches)
+        fprintf(stderr, "Mismatch: %s: expected \"value\", got \"%s\"\n", name, value.chars);
+
+    ffStrbufDestroy(&value);
+    return matches;
+}
+
+//Checks that keys are found no matter where the reads of a file split its lines.
+//Returns 1 if a key is parsed differently
+static int runProps()
+{
+    char path[] = "/tmp/fastfetch-props-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd == -1)
+    {
+        fputs("Failed to create a temporary file\n", stderr);
+        return 2;
+    }
+    close(fd);
+
+    FFstrbuf content;
+    ffStrbufInitA(&content, FF_PERFORMANCE_PROP_READ_SIZE * 3);
+
+    int result = 0;
+
+    //The key line starts 3 bytes before the end of the first read
+    appendChars(&content, FF_PERFORMANCE_PROP_READ_SIZE - 4, '#');
+    ffStrbufAppendS(&content, "\nKEY=value\n");
+    if(!checkPropFile(path, "key across a read", &content))
+        result = 1;
+
+    //The first read is all of a long line. The second ends with its rest and the first 5 bytes of the key line
+    ffStrbufClear(&content);
+    appendChars(&content, FF_PERFORMANCE_PROP_READ_SIZE * 2 - 6, 'x');
+    ffStrbufAppendS(&content, "\nKEY=value\n");
+    if(!checkPropFile(path, "key across a read after a long line", &content))
+        result = 1;
+
+    //The rest of a long line must not be parsed as a line of its own
+    ffStrbufClear(&content);
+    appendChars(&content, FF_PERFORMANCE_PROP_READ_SIZE, 'x');
+    ffStrbufAppendS(&content, "KEY=wrong\nKEY=value\n");
+    if(!checkPropFile(path, "rest of a long line", &content))
+        result = 1;
+
+    ffStrbufDestroy(&content);
+    unlink(path);
+
+    return result;
+}
+
+#undef FF_PERFORMANCE_PROP_READ_SIZE
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "Runs every module and the whole pipeline in fresh processes and prints statistics in nanoseconds as JSON.\n"
+        "The allocations metric is a count of malloc, calloc and realloc calls instead.\n"
+        "\n"
+        "   --runs <num>:              number of measured runs per mode. Default is %d\n"
+        "   --baseline <file>:         compare the medians against a JSON file written by this program\n"
+        "   --threshold <percent>:     how much a median may grow compared to the baseline. Default is %d\n"
+        "   --numbers:                 instead, time formatting %d numbers of each kind, compared to printf\n"
+        "   --props:                   instead, check that key files are parsed the same wherever reads split them\n"
+        "\n"
+        "Exits with 1 if a metric regressed past the threshold and with 2 if the benchmark couldn't run.\n"
+        "With --numbers, exits with 1 if a number is formatted differently than by printf.\n"
+        "With --props, exits with 1 if a key is parsed differently.\n",
+        program, FF_PERFORMANCE_DEFAULT_RUNS, FF_PERFORMANCE_DEFAULT_THRESHOLD, FF_PERFORMANCE_NUMBERS_COUNT
+    );
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t numRuns = FF_PERFORMANCE_DEFAULT_RUNS;
+    uint32_t threshold = FF_PERFORMANCE_DEFAULT_THRESHOLD;
+    const char* baselinePath = NULL;
+    bool numbers = false;
+    bool props = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            numRuns = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = (uint32_t) strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--numbers") == 0)
+            numbers = true;
+        else if(strcmp(argv[i], "--props") == 0)
+            props = true;
+        else
+        {
+            printUsage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    if(numRuns == 0)
+    {
+        fputs("--runs must be at least 1\n", stderr);
+        return 2;
+    }
+
+    if(numbers)
+        return runNumbers(numRuns);
+
+    if(props)
+        return runProps();
+
+    FFstrbuf baseline;
+    ffStrbufInit(&baseline);
+    if(baselinePath != NULL && !ffAppendFileContent(baselinePath, &baseline))
+    {
+        fprintf(stderr, "Failed to read baseline: %s\n", baselinePath);
+        return 2;
+    }
+
+    //Runs must neither use nor overwrite the cache of the user
+    char cacheHome[] = "/tmp/fastfetch-performance-XXXXXX";
+    if(mkdtemp(cacheHome) == NULL)
+    {
+        fputs("Failed to create a temporary cache directory\n", stderr);
+        return 2;
+    }
+    setenv("XDG_CACHE_HOME", cacheHome, 1);
+
+    uint64_t* samples = malloc(sizeof(uint64_t) * FF_METRIC_COUNT * numRuns);
+    uint64_t* metricSamples = malloc(sizeof(uint64_t) * numRuns);
+
+    int result = 0;
+
+    printf("{\n");
+    printf("  \"runs\": %u,\n", numRuns);
+    printf("  \"unit\": \"ns\",\n");
+    printf("  \"modes\": {\n");
+
+    for(uint32_t mode = 0; mode < FF_PERFORMANCE_NUM_MODES && result != 2; mode++)
+    {
+        //Not measured. Fills the page cache and, for the cached mode, the fastfetch cache
+        if(!runOnce(mode, samples))
+        {
+            result = 2;
+            break;
+        }
+
+        for(uint32_t run = 0; run < numRuns; run++)
+        {
+            if(!runOnce(mode, samples + run * FF_METRIC_COUNT))
+            {
+                result = 2;
+                break;
+            }
+        }
+
+        if(result == 2)
+            break;
+
+        //The separator goes before a mode, so a run failing in a later mode still leaves valid JSON
+        printf("%s    \"%s\": {\n", mode > 0 ? ",\n" : "", modes[mode].name);
+
+        for(uint32_t metric = 0; metric < FF_METRIC_COUNT; metric++)
+        {
+            for(uint32_t run = 0; run < numRuns; run++)
+                metricSamples[run] = samples[run * FF_METRIC_COUNT + metric];
+
+            FFmetricstats stats = getStats(metricSamples, numRuns);
+            const char* metricName = getMetricName(metric);
+
+            printf("      \"%s\": {\"min\": %llu, \"median\": %llu, \"p95\": %llu, \"p99\": %llu}%s\n",
+                metricName,
+                (unsigned long long) stats.min,
+                (unsigned long long) stats.median,
+                (unsigned long long) stats.p95,
+                (unsigned long long) stats.p99,
+                metric + 1 < FF_METRIC_COUNT ? "," : ""
+            );
+
+            //Allocation counts don't jitter like times do
+            uint64_t minDelta = metric == FF_METRIC_ALLOCATIONS ? 0 : FF_PERFORMANCE_MIN_DELTA_NS;
+
+            uint64_t baselineMedian;
+            if(
+                baseline.length > 0 &&
+                getBaselineMedian(&baseline, modes[mode].name, metricName, &baselineMedian) &&
+                stats.median > baselineMedian + minDelta &&
+                stats.median * 100 > baselineMedian * (100 + threshold)
+            ) {
+                fprintf(stderr, "Regression: %s %s median %llu, baseline %llu\n",
+                    modes[mode].name,
+                    metricName,
+                    (unsigned long long) stats.median,
+                    (unsigned long long) baselineMedian
+                );
+                result = 1;
+            }
+        }
+
+        printf("    }");
+    }
+
+    printf("\n  }\n");
+    printf("}\n");
+
+    if(result == 2)
+        fputs("A benchmark run failed\n", stderr);
+
+    free(metricSamples);
+    free(samples);
+    ffStrbufDestroy(&baseline);
+    removeDirectory(cacheHome);
+
+    return result;
+}
+
+#undef FF_PERFORMANCE_NUMBERS_COUNT
+#undef FF_PERFORMANCE_NUM_MODES
+#undef FF_PERFORMANCE_NUM_MODULES
+#undef FF_PERFORMANCE_MIN_DELTA_NS
+#undef FF_PERFORMANCE_DEFAULT_THRESHOLD
+#undef FF_PERFORMANCE_DEFAULT_RUNS